@@ -0,0 +1,378 @@
+// File: Aggregation.cpp
+#include "Aggregation.hpp"
+#include "TextFormat.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    void appendTimestamp(std::string &out, int64_t nanos)
+    {
+        char text[TextFormat::kMaxFieldLength];
+        out.append(text, TextFormat::formatTimestamp(nanos, text));
+    }
+
+    void appendPrice(std::string &out, int64_t price)
+    {
+        char text[TextFormat::kMaxFieldLength];
+        out.append(text, TextFormat::formatFixed(price, MarketDataEntry::kPriceDigits, text));
+    }
+
+    void appendInt(std::string &out, int64_t value)
+    {
+        char text[TextFormat::kMaxFieldLength];
+        out.append(text, TextFormat::formatInt(value, text));
+    }
+
+    // Notional over volume, rounded to the nearest price step; empty without volume
+    void appendAverage(std::string &out, __int128 notional, int64_t volume)
+    {
+        if (volume > 0)
+        {
+            const __int128 half = volume / 2;
+            appendPrice(out, static_cast<int64_t>((notional >= 0 ? notional + half : notional - half) / volume));
+        }
+    }
+
+    constexpr int64_t kNoBar = std::numeric_limits<int64_t>::min();
+
+    // Start of the interval holding a timestamp, rounding down before the epoch too
+    int64_t intervalStart(int64_t timestamp, int64_t interval)
+    {
+        int64_t start = timestamp / interval * interval;
+        return start > timestamp ? start - interval : start;
+    }
+}
+
+// Aggregator implementation
+std::unique_ptr<Aggregator> Aggregator::create(const std::string &spec, const std::string &outputBase)
+{
+    if (spec.rfind("bars:", 0) == 0)
+    {
+        const std::string interval = spec.substr(5);
+        return std::make_unique<BarAggregator>(outputBase + ".bars-" + interval + ".csv", parseInterval(interval));
+    }
+    if (spec == "vwap")
+    {
+        return std::make_unique<VwapAggregator>(outputBase + ".vwap.csv");
+    }
+    if (spec == "top-of-book")
+    {
+        return std::make_unique<TopOfBookAggregator>(outputBase + ".top-of-book.csv");
+    }
+    throw std::runtime_error("Unknown aggregation " + spec);
+}
+
+int64_t Aggregator::parseInterval(const std::string &text)
+{
+    size_t digits = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9')
+    {
+        ++digits;
+    }
+    const std::string unit = text.substr(digits);
+    int64_t scale = 0;
+    if (unit == "ms")
+    {
+        scale = 1000000;
+    }
+    else if (unit == "s")
+    {
+        scale = 1000000000;
+    }
+    else if (unit == "m")
+    {
+        scale = 60 * 1000000000ll;
+    }
+    else if (unit == "h")
+    {
+        scale = 3600 * 1000000000ll;
+    }
+    if (digits == 0 || digits > 9 || scale == 0 || std::stoll(text.substr(0, digits)) == 0)
+    {
+        throw std::runtime_error("Invalid interval " + text + " (expected e.g. 500ms, 1s, 5m, 1h)");
+    }
+    return std::stoll(text.substr(0, digits)) * scale;
+}
+
+// BarAggregator implementation
+BarAggregator::BarAggregator(const std::string &filename, int64_t intervalNanos)
+    : output_(filename), interval_(intervalNanos), symbols_(nullptr), barStart_(kNoBar)
+{
+    if (intervalNanos <= 0)
+    {
+        throw std::runtime_error("Bar interval must be positive");
+    }
+}
+
+void BarAggregator::begin(const SymbolTable &symbols)
+{
+    symbols_ = &symbols;
+    bars_.assign(symbols.size(), Bar{});
+    touched_.clear();
+    barStart_ = kNoBar;
+    output_.buffer() += "Symbol,BarStart,Open,High,Low,Close,Volume,VWAP,Trades\n";
+}
+
+void BarAggregator::add(const MarketDataEntry *entries, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const MarketDataEntry &entry = entries[i];
+        if (entry.side != Side::Trade)
+        {
+            continue;
+        }
+
+        // Rows arrive in time order, so a trade past the open interval closes every bar in it
+        if (barStart_ == kNoBar || entry.timestamp < barStart_ || entry.timestamp - barStart_ >= interval_)
+        {
+            flush();
+            barStart_ = intervalStart(entry.timestamp, interval_);
+        }
+
+        Bar &bar = bars_[entry.symbolId];
+        if (bar.trades == 0)
+        {
+            bar.open = bar.high = bar.low = entry.price;
+            touched_.push_back(entry.symbolId);
+        }
+        bar.high = std::max(bar.high, entry.price);
+        bar.low = std::min(bar.low, entry.price);
+        bar.close = entry.price;
+        bar.volume += entry.size;
+        bar.notional += static_cast<__int128>(entry.price) * entry.size;
+        ++bar.trades;
+    }
+}
+
+void BarAggregator::flush()
+{
+    std::sort(touched_.begin(), touched_.end());
+    for (uint32_t symbolId : touched_)
+    {
+        Bar &bar = bars_[symbolId];
+        std::string &out = output_.buffer();
+        out += symbols_->name(symbolId);
+        out += ',';
+        appendTimestamp(out, barStart_);
+        out += ',';
+        appendPrice(out, bar.open);
+        out += ',';
+        appendPrice(out, bar.high);
+        out += ',';
+        appendPrice(out, bar.low);
+        out += ',';
+        appendPrice(out, bar.close);
+        out += ',';
+        appendInt(out, bar.volume);
+        out += ',';
+        appendAverage(out, bar.notional, bar.volume);
+        out += ',';
+        appendInt(out, bar.trades);
+        out += '\n';
+        output_.commit();
+        bar = Bar{};
+    }
+    touched_.clear();
+}
+
+void BarAggregator::finish()
+{
+    flush();
+    output_.close();
+}
+
+// VwapAggregator implementation
+VwapAggregator::VwapAggregator(const std::string &filename)
+    : output_(filename), symbols_(nullptr)
+{
+}
+
+void VwapAggregator::begin(const SymbolTable &symbols)
+{
+    symbols_ = &symbols;
+    totals_.assign(symbols.size(), Totals{});
+}
+
+void VwapAggregator::add(const MarketDataEntry *entries, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const MarketDataEntry &entry = entries[i];
+        if (entry.side != Side::Trade)
+        {
+            continue;
+        }
+        Totals &totals = totals_[entry.symbolId];
+        if (totals.trades++ == 0)
+        {
+            totals.first = entry.timestamp;
+        }
+        totals.last = entry.timestamp;
+        totals.volume += entry.size;
+        totals.notional += static_cast<__int128>(entry.price) * entry.size;
+    }
+}
+
+void VwapAggregator::finish()
+{
+    std::string &out = output_.buffer();
+    out += "Symbol,Trades,Volume,VWAP,FirstTrade,LastTrade\n";
+    for (uint32_t symbolId = 0; symbolId < totals_.size(); ++symbolId)
+    {
+        const Totals &totals = totals_[symbolId];
+        if (totals.trades == 0)
+        {
+            continue;
+        }
+        out += symbols_->name(symbolId);
+        out += ',';
+        appendInt(out, static_cast<int64_t>(totals.trades));
+        out += ',';
+        appendInt(out, totals.volume);
+        out += ',';
+        appendAverage(out, totals.notional, totals.volume);
+        out += ',';
+        appendTimestamp(out, totals.first);
+        out += ',';
+        appendTimestamp(out, totals.last);
+        out += '\n';
+        output_.commit();
+    }
+    output_.close();
+}
+
+// TopOfBookAggregator implementation
+TopOfBookAggregator::TopOfBookAggregator(const std::string &filename)
+    : output_(filename), symbols_(nullptr), stride_(0)
+{
+}
+
+void TopOfBookAggregator::begin(const SymbolTable &symbols)
+{
+    symbols_ = &symbols;
+    stride_ = std::max<size_t>(ExchangeTable::size(), 1);
+    quotes_.assign(symbols.size() * stride_, Book{});
+    best_.assign(symbols.size(), Book{});
+    output_.buffer() += "Symbol,Timestamp,BidPrice,BidSize,AskPrice,AskSize\n";
+}
+
+void TopOfBookAggregator::widen(size_t exchanges)
+{
+    // Exchanges are all interned while parsing, so this only runs for rows that were
+    // not parsed in this process
+    std::vector<Book> widened(best_.size() * exchanges, Book{});
+    for (size_t symbol = 0; symbol < best_.size(); ++symbol)
+    {
+        std::copy(quotes_.begin() + symbol * stride_, quotes_.begin() + (symbol + 1) * stride_,
+                  widened.begin() + symbol * exchanges);
+    }
+    quotes_.swap(widened);
+    stride_ = exchanges;
+}
+
+void TopOfBookAggregator::add(const MarketDataEntry *entries, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const MarketDataEntry &entry = entries[i];
+        if (entry.side == Side::Trade)
+        {
+            continue;
+        }
+        if (entry.exchange >= stride_)
+        {
+            widen(std::max<size_t>(ExchangeTable::size(), entry.exchange + 1));
+        }
+
+        Book *books = &quotes_[entry.symbolId * stride_];
+        Quote &quote = entry.side == Side::Bid ? books[entry.exchange].bid : books[entry.exchange].ask;
+        quote.price = entry.price;
+        quote.size = entry.size;
+
+        // Best price on each side over the exchanges, with the size quoted at it
+        Book best{};
+        for (size_t exchange = 0; exchange < stride_; ++exchange)
+        {
+            const Book &book = books[exchange];
+            if (book.bid.size > 0 && (best.bid.size == 0 || book.bid.price >= best.bid.price))
+            {
+                best.bid.size = best.bid.size > 0 && book.bid.price == best.bid.price ? best.bid.size + book.bid.size : book.bid.size;
+                best.bid.price = book.bid.price;
+            }
+            if (book.ask.size > 0 && (best.ask.size == 0 || book.ask.price <= best.ask.price))
+            {
+                best.ask.size = best.ask.size > 0 && book.ask.price == best.ask.price ? best.ask.size + book.ask.size : book.ask.size;
+                best.ask.price = book.ask.price;
+            }
+        }
+
+        Book &current = best_[entry.symbolId];
+        if (best.bid.price == current.bid.price && best.bid.size == current.bid.size &&
+            best.ask.price == current.ask.price && best.ask.size == current.ask.size)
+        {
+            continue;
+        }
+        current = best;
+
+        std::string &out = output_.buffer();
+        out += symbols_->name(entry.symbolId);
+        out += ',';
+        appendTimestamp(out, entry.timestamp);
+        for (const Quote *side : {&best.bid, &best.ask})
+        {
+            out += ',';
+            if (side->size > 0)
+            {
+                appendPrice(out, side->price);
+            }
+            out += ',';
+            if (side->size > 0)
+            {
+                appendInt(out, side->size);
+            }
+        }
+        out += '\n';
+        output_.commit();
+    }
+}
+
+void TopOfBookAggregator::finish()
+{
+    output_.close();
+}
+
+// AggregatingSink implementation
+AggregatingSink::AggregatingSink(OutputSink &inner, std::vector<std::shared_ptr<Aggregator>> aggregators)
+    : inner_(inner), aggregators_(std::move(aggregators))
+{
+}
+
+void AggregatingSink::begin(const SymbolTable &symbols)
+{
+    inner_.begin(symbols);
+    for (auto &aggregator : aggregators_)
+    {
+        aggregator->begin(symbols);
+    }
+}
+
+void AggregatingSink::write(const MarketDataEntry *entries, size_t count)
+{
+    inner_.write(entries, count);
+    for (auto &aggregator : aggregators_)
+    {
+        aggregator->add(entries, count);
+    }
+}
+
+void AggregatingSink::finish()
+{
+    inner_.finish();
+    for (auto &aggregator : aggregators_)
+    {
+        aggregator->finish();
+    }
+}
@@ -0,0 +1,146 @@
+// File: Aggregation.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include "OutputSink.hpp"
+#include "OutputWriter.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streaming computation over the merged rows, fed in merge order as the output is
+// written, with a CSV side output of its own. State is kept per symbol in flat arrays
+// indexed by symbol id, so each row costs an index and a few compares.
+class Aggregator
+{
+public:
+    virtual ~Aggregator() = default;
+
+    // Start of the merge; an aggregator (and its side output) serves a single merge
+    virtual void begin(const SymbolTable &symbols) = 0;
+
+    virtual void add(const MarketDataEntry *entries, size_t count) = 0;
+
+    // Emit what is still open and complete the side output; throws if it could not be written
+    virtual void finish() = 0;
+
+    // Aggregator for a spec, writing "<outputBase>.<name>.csv":
+    //   bars:INTERVAL  OHLCV and VWAP bars of trades ("bars-1s", ...), INTERVAL as 500ms, 1s, 1m, 1h
+    //   vwap           Session VWAP and volume per symbol
+    //   top-of-book    Consolidated best bid and offer, one row per change
+    static std::unique_ptr<Aggregator> create(const std::string &spec, const std::string &outputBase);
+
+    // "500ms", "1s", "5m", "1h" in nanoseconds
+    static int64_t parseInterval(const std::string &text);
+};
+
+// Fixed-interval OHLCV bars of each symbol's trades, with the bar's VWAP. A bar is
+// written once the merge moves past its interval; bars of one interval come in
+// symbol order. Intervals without trades get no bar.
+class BarAggregator : public Aggregator
+{
+public:
+    BarAggregator(const std::string &filename, int64_t intervalNanos);
+
+    void begin(const SymbolTable &symbols) override;
+    void add(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    struct Bar
+    {
+        int64_t open;
+        int64_t high;
+        int64_t low;
+        int64_t close;
+        int64_t volume;
+        __int128 notional; // Sum of price * size
+        uint32_t trades;
+    };
+
+    void flush();
+
+    OutputWriter output_;
+    int64_t interval_;
+    const SymbolTable *symbols_;
+    std::vector<Bar> bars_;
+    std::vector<uint32_t> touched_; // Symbols with a trade in the open interval
+    int64_t barStart_;
+};
+
+// Volume-weighted average price of each symbol's trades over the whole merge
+class VwapAggregator : public Aggregator
+{
+public:
+    explicit VwapAggregator(const std::string &filename);
+
+    void begin(const SymbolTable &symbols) override;
+    void add(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    struct Totals
+    {
+        int64_t volume;
+        __int128 notional;
+        uint64_t trades;
+        int64_t first;
+        int64_t last;
+    };
+
+    OutputWriter output_;
+    const SymbolTable *symbols_;
+    std::vector<Totals> totals_;
+};
+
+// Consolidated top of book: the latest bid and ask of every exchange, reduced to the
+// best price on each side with the size quoted at it across exchanges. A row is
+// written whenever a symbol's best bid or offer changes. A quote of size 0 withdraws
+// that exchange's side.
+class TopOfBookAggregator : public Aggregator
+{
+public:
+    explicit TopOfBookAggregator(const std::string &filename);
+
+    void begin(const SymbolTable &symbols) override;
+    void add(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    struct Quote
+    {
+        int64_t price;
+        int64_t size; // 0 when the exchange has no quote on this side
+    };
+
+    struct Book
+    {
+        Quote bid;
+        Quote ask;
+    };
+
+    void widen(size_t exchanges);
+
+    OutputWriter output_;
+    const SymbolTable *symbols_;
+    size_t stride_;            // Exchanges per symbol in quotes_
+    std::vector<Book> quotes_; // [symbol * stride_ + exchange]
+    std::vector<Book> best_;   // [symbol]
+};
+
+// Passes rows to another sink and to a set of aggregators
+class AggregatingSink : public OutputSink
+{
+public:
+    AggregatingSink(OutputSink &inner, std::vector<std::shared_ptr<Aggregator>> aggregators);
+
+    void begin(const SymbolTable &symbols) override;
+    void write(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    OutputSink &inner_;
+    std::vector<std::shared_ptr<Aggregator>> aggregators_;
+};
@@ -0,0 +1,74 @@
+// File: Arena.cpp
+#include "Arena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+Arena::Arena(size_t chunkBytes)
+    : chunkBytes_(std::max<size_t>(chunkBytes, 4096)), current_(0), offset_(0)
+{
+}
+
+Arena::~Arena()
+{
+    for (const auto &chunk : chunks_)
+    {
+        ::operator delete(chunk.data);
+    }
+}
+
+void *Arena::allocate(size_t bytes, size_t alignment)
+{
+    // Current chunk first, then chunks kept from before the last rewind, then a new one
+    for (; current_ < chunks_.size(); ++current_, offset_ = 0)
+    {
+        const Chunk &chunk = chunks_[current_];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+        const size_t start = static_cast<size_t>((base + offset_ + alignment - 1) / alignment * alignment - base);
+        if (start + bytes <= chunk.size)
+        {
+            offset_ = start + bytes;
+            return chunk.data + start;
+        }
+    }
+
+    // Chunks come from operator new, so they are aligned for any fundamental type
+    const size_t size = std::max(chunkBytes_, bytes + alignment);
+    chunks_.push_back(Chunk{static_cast<char *>(::operator new(size)), size});
+    current_ = chunks_.size() - 1;
+    const uintptr_t base = reinterpret_cast<uintptr_t>(chunks_.back().data);
+    const size_t start = static_cast<size_t>((base + alignment - 1) / alignment * alignment - base);
+    offset_ = start + bytes;
+    return chunks_.back().data + start;
+}
+
+void Arena::rewind(const Mark &mark)
+{
+    current_ = mark.chunk;
+    offset_ = mark.offset;
+}
+
+size_t Arena::used() const
+{
+    size_t total = offset_;
+    for (size_t i = 0; i < current_ && i < chunks_.size(); ++i)
+    {
+        total += chunks_[i].size;
+    }
+    return total;
+}
+
+size_t Arena::reserved() const
+{
+    size_t total = 0;
+    for (const auto &chunk : chunks_)
+    {
+        total += chunk.size;
+    }
+    return total;
+}
+
+Arena &Arena::forThisThread()
+{
+    thread_local Arena arena;
+    return arena;
+}
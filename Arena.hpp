@@ -0,0 +1,143 @@
+// File: Arena.hpp
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic bump allocator. Memory is handed out from large chunks and never freed
+// one allocation at a time; rewinding to a mark releases everything allocated since
+// in one step and keeps the chunks for reuse, so a worker that rewinds after every
+// batch stops calling into the global allocator once its chunks are warm.
+// Not thread-safe: an arena belongs to one thread.
+class Arena
+{
+public:
+    static constexpr size_t kDefaultChunkBytes = 1024 * 1024;
+
+    // Position to rewind to
+    struct Mark
+    {
+        size_t chunk;
+        size_t offset;
+    };
+
+    // Rewinds the arena to where it was when the scope began; nests LIFO
+    class Scope
+    {
+    public:
+        explicit Scope(Arena &arena) : arena_(arena), mark_(arena.mark()) {}
+        ~Scope() { arena_.rewind(mark_); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Arena &arena_;
+        Mark mark_;
+    };
+
+    explicit Arena(size_t chunkBytes = kDefaultChunkBytes);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    Mark mark() const { return Mark{current_, offset_}; }
+
+    // Release everything allocated after the mark; objects in it must already be destroyed
+    void rewind(const Mark &mark);
+
+    // Bytes from the start to the current position (tails of skipped chunks included),
+    // and bytes held in chunks
+    size_t used() const;
+    size_t reserved() const;
+
+    // Arena of the calling thread, for per-batch scratch
+    static Arena &forThisThread();
+
+private:
+    struct Chunk
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t chunkBytes_;
+    size_t current_; // Chunk being allocated from
+    size_t offset_;  // Bytes used in it
+};
+
+// Destroys without freeing: the arena owns the memory
+struct ArenaDelete
+{
+    template <typename T>
+    void operator()(T *object) const
+    {
+        object->~T();
+    }
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDelete>;
+
+// Construct an object in the arena; it must be destroyed before the arena rewinds past it
+template <typename T, typename... Args>
+ArenaPtr<T> makeInArena(Arena &arena, Args &&...args)
+{
+    void *memory = arena.allocate(sizeof(T), alignof(T));
+    return ArenaPtr<T>(new (memory) T(std::forward<Args>(args)...));
+}
+
+// Standard allocator over an arena; without one it is plain new/delete, so a
+// container type can be used both ways
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator(Arena *arena = nullptr) noexcept : arena_(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena_(other.arena()) {}
+
+    T *allocate(size_t count)
+    {
+        if (arena_)
+        {
+            return static_cast<T *>(arena_->allocate(count * sizeof(T), alignof(T)));
+        }
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T *pointer, size_t count)
+    {
+        if (!arena_)
+        {
+            std::allocator<T>().deallocate(pointer, count);
+        }
+    }
+
+    Arena *arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena(); }
+
+private:
+    Arena *arena_;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,496 @@
+// File: AsyncIo.cpp
+#include "AsyncIo.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING 1
+#include <linux/io_uring.h>
+#endif
+
+namespace
+{
+    std::atomic<IoEngine::Kind> g_preferred{IoEngine::Kind::Auto};
+
+    // Positional read of the whole range, retrying short reads
+    int64_t preadFully(int fd, char *buffer, size_t length, uint64_t offset)
+    {
+        size_t done = 0;
+        while (done < length)
+        {
+            ssize_t count = ::pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return -errno;
+            }
+            if (count == 0)
+            {
+                break;
+            }
+            done += static_cast<size_t>(count);
+        }
+        return static_cast<int64_t>(done);
+    }
+}
+
+// IoEngine implementation
+IoEngine &IoEngine::forThisThread()
+{
+#ifdef ASYNC_IO_URING
+    thread_local std::unique_ptr<IoUringEngine> ring;
+    thread_local bool ringFailed = false;
+    if (preferred() != Kind::ThreadPool && !ringFailed)
+    {
+        if (!ring)
+        {
+            try
+            {
+                ring = std::make_unique<IoUringEngine>();
+            }
+            catch (const std::exception &)
+            {
+                if (preferred() == Kind::IoUring)
+                {
+                    throw;
+                }
+                ringFailed = true;
+            }
+        }
+        if (ring)
+        {
+            return *ring;
+        }
+    }
+#endif
+    if (preferred() == Kind::IoUring)
+    {
+        throw std::runtime_error("io_uring is not available");
+    }
+    return ThreadPoolEngine::shared();
+}
+
+void IoEngine::setPreferred(Kind kind)
+{
+    g_preferred.store(kind);
+}
+
+IoEngine::Kind IoEngine::preferred()
+{
+    return g_preferred.load();
+}
+
+// IoUringEngine implementation
+#ifdef ASYNC_IO_URING
+IoUringEngine::IoUringEngine(unsigned entries)
+    : fd_(-1), sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0),
+      sqes_(MAP_FAILED), sqesSize_(0), pending_(0), inFlight_(0)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+    }
+    // IORING_OP_READ needs Linux 5.6, which also introduced this feature bit
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        ::close(fd_);
+        throw std::runtime_error("io_uring lacks IORING_OP_READ");
+    }
+
+    sqEntries_ = params.sq_entries;
+    cqEntries_ = params.cq_entries;
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    cqRing_ = singleMmap ? sqRing_
+                         : ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    sqes_ = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED)
+    {
+        int error = errno;
+        release();
+        throw std::system_error(error, std::generic_category(), "io_uring mmap");
+    }
+
+    char *sq = static_cast<char *>(sqRing_);
+    char *cq = static_cast<char *>(cqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+}
+
+IoUringEngine::~IoUringEngine()
+{
+    release();
+}
+
+void IoUringEngine::release()
+{
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+    sqes_ = cqRing_ = sqRing_ = MAP_FAILED;
+    fd_ = -1;
+}
+
+bool IoUringEngine::available()
+{
+    static const bool usable = []()
+    {
+        try
+        {
+            IoUringEngine probe(8);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }();
+    return usable;
+}
+
+void IoUringEngine::enter(unsigned minComplete)
+{
+    for (;;)
+    {
+        unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        long submitted = ::syscall(__NR_io_uring_enter, fd_, pending_, minComplete, flags, nullptr, 0);
+        if (submitted >= 0)
+        {
+            pending_ -= static_cast<unsigned>(submitted);
+            inFlight_ += static_cast<unsigned>(submitted);
+            return;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            // Completion queue is backed up: make room and retry
+            reap();
+            continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+}
+
+void IoUringEngine::reap()
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    auto *cqes = static_cast<io_uring_cqe *>(cqes_);
+    while (head != tail)
+    {
+        const io_uring_cqe &cqe = cqes[head & *cqMask_];
+        auto *request = reinterpret_cast<ReadRequest *>(static_cast<uintptr_t>(cqe.user_data));
+        request->result = cqe.res;
+        request->done.store(true, std::memory_order_release);
+        ++head;
+        --inFlight_;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringEngine::submit(ReadRequest &request)
+{
+    if (pending_ == sqEntries_)
+    {
+        enter(0);
+    }
+    // Never have more requests outstanding than the completion ring holds
+    while (inFlight_ + pending_ >= cqEntries_)
+    {
+        enter(1);
+        reap();
+    }
+
+    unsigned tail = *sqTail_;
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe &sqe = static_cast<io_uring_sqe *>(sqes_)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = request.fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(request.buffer);
+    sqe.len = static_cast<unsigned>(request.length);
+    sqe.off = request.offset;
+    sqe.user_data = reinterpret_cast<uintptr_t>(&request);
+    sqArray_[index] = index;
+
+    request.done.store(false, std::memory_order_relaxed);
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++pending_;
+
+    // Without SQPOLL the kernel only sees queued entries on io_uring_enter; leaving
+    // them for wait() would start every read-ahead only once its data is needed
+    enter(0);
+}
+
+void IoUringEngine::poll()
+{
+    reap();
+}
+
+void IoUringEngine::wait(ReadRequest &request)
+{
+    reap();
+    while (!request.done.load(std::memory_order_acquire))
+    {
+        enter(1);
+        reap();
+    }
+}
+#else
+IoUringEngine::IoUringEngine(unsigned)
+{
+    throw std::runtime_error("io_uring is not supported on this platform");
+}
+
+IoUringEngine::~IoUringEngine() = default;
+
+void IoUringEngine::release() {}
+
+bool IoUringEngine::available()
+{
+    return false;
+}
+
+void IoUringEngine::submit(ReadRequest &) {}
+void IoUringEngine::wait(ReadRequest &) {}
+void IoUringEngine::poll() {}
+#endif
+
+// ThreadPoolEngine implementation
+ThreadPoolEngine::ThreadPoolEngine(size_t threads)
+    : stopping_(false)
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+    {
+        threads_.emplace_back(&ThreadPoolEngine::run, this);
+    }
+}
+
+ThreadPoolEngine::~ThreadPoolEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+ThreadPoolEngine &ThreadPoolEngine::shared()
+{
+    static ThreadPoolEngine engine(std::min<size_t>(8, std::max(2u, std::thread::hardware_concurrency())));
+    return engine;
+}
+
+void ThreadPoolEngine::submit(ReadRequest &request)
+{
+    request.done.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(&request);
+    }
+    queued_.notify_one();
+}
+
+void ThreadPoolEngine::wait(ReadRequest &request)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    completed_.wait(lock, [&request]()
+                    { return request.done.load(std::memory_order_acquire); });
+}
+
+void ThreadPoolEngine::run()
+{
+    for (;;)
+    {
+        ReadRequest *request = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this]()
+                         { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            request = queue_.front();
+            queue_.pop_front();
+        }
+
+        int64_t result = preadFully(request->fd, request->buffer, request->length, request->offset);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            request->result = result;
+            request->done.store(true, std::memory_order_release);
+        }
+        completed_.notify_all();
+    }
+}
+
+// AsyncSource implementation
+AsyncSource::AsyncSource(const std::string &filename, IoEngine &engine, size_t bufferSize, size_t buffersInFlight,
+                         uint64_t offset)
+    : engine_(engine), fd_(-1), bufferSize_(std::max<size_t>(bufferSize, 4096)),
+      buffers_(std::max<size_t>(buffersInFlight, 1) + 1), current_(0), begin_(0), end_(0),
+      nextOffset_(offset), endOfFile_(false)
+{
+    fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(fd_, static_cast<off_t>(offset), 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // All buffers but the last start in flight; the last stands in as the (empty)
+    // current buffer until the first fill() moves on to buffer 0
+    for (auto &buffer : buffers_)
+    {
+        buffer.headroom = 4096;
+        buffer.data.resize(buffer.headroom + bufferSize_);
+    }
+    for (size_t i = 0; i + 1 < buffers_.size(); ++i)
+    {
+        issue(buffers_[i]);
+    }
+    current_ = buffers_.size() - 1;
+    begin_ = end_ = buffers_[current_].headroom;
+}
+
+AsyncSource::~AsyncSource()
+{
+    // The engine may still be writing into our buffers
+    for (auto &buffer : buffers_)
+    {
+        if (!buffer.request.done.load(std::memory_order_acquire))
+        {
+            engine_.wait(buffer.request);
+        }
+    }
+    ::close(fd_);
+}
+
+void AsyncSource::issue(Buffer &buffer)
+{
+    buffer.request.fd = fd_;
+    buffer.request.buffer = buffer.data.data() + buffer.headroom;
+    buffer.request.length = bufferSize_;
+    buffer.request.offset = nextOffset_;
+    nextOffset_ += bufferSize_;
+    engine_.submit(buffer.request);
+}
+
+std::string_view AsyncSource::view() const
+{
+    return std::string_view(buffers_[current_].data.data() + begin_, end_ - begin_);
+}
+
+void AsyncSource::consume(size_t count)
+{
+    begin_ += count;
+}
+
+bool AsyncSource::fill()
+{
+    if (endOfFile_)
+    {
+        return false;
+    }
+
+    // Buffers are read round-robin, so the next one holds the following chunk
+    size_t next = (current_ + 1) % buffers_.size();
+    Buffer &incoming = buffers_[next];
+    if (!incoming.request.done.load(std::memory_order_acquire))
+    {
+        engine_.wait(incoming.request);
+    }
+    int64_t result = incoming.request.result;
+    if (result >= 0 && static_cast<size_t>(result) < bufferSize_ && result > 0)
+    {
+        // Short read before the end of file: complete it synchronously
+        int64_t rest = preadFully(fd_, incoming.request.buffer + result, bufferSize_ - static_cast<size_t>(result),
+                                  incoming.request.offset + static_cast<uint64_t>(result));
+        result = rest < 0 ? rest : result + rest;
+    }
+    if (result < 0)
+    {
+        throw std::system_error(static_cast<int>(-result), std::generic_category(), "Failed to read input file");
+    }
+    if (result == 0)
+    {
+        endOfFile_ = true;
+        return false;
+    }
+    Metrics::add(Metrics::Counter::BytesRead, static_cast<uint64_t>(result));
+    Metrics::record(Metrics::Histogram::ReadBytes, static_cast<uint64_t>(result));
+
+    // Carry the unconsumed tail of the current buffer in front of the new data
+    Buffer &outgoing = buffers_[current_];
+    size_t tail = end_ - begin_;
+    if (tail > incoming.headroom)
+    {
+        size_t headroom = std::max(tail, incoming.headroom * 2);
+        std::vector<char> grown(headroom + bufferSize_);
+        std::memcpy(grown.data() + headroom, incoming.data.data() + incoming.headroom, static_cast<size_t>(result));
+        incoming.data.swap(grown);
+        incoming.headroom = headroom;
+    }
+    std::memcpy(incoming.data.data() + incoming.headroom - tail, outgoing.data.data() + begin_, tail);
+    begin_ = incoming.headroom - tail;
+    end_ = incoming.headroom + static_cast<size_t>(result);
+
+    // The parsed buffer is free again: read ahead into it
+    issue(outgoing);
+    current_ = next;
+    return true;
+}
@@ -0,0 +1,163 @@
+// File: AsyncIo.hpp
+#pragma once
+
+#include "InputSource.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One positional read handed to an IoEngine
+struct ReadRequest
+{
+    int fd = -1;
+    char *buffer = nullptr;
+    size_t length = 0;
+    uint64_t offset = 0;
+    int64_t result = 0; // Bytes read, or -errno
+    std::atomic<bool> done{true};
+};
+
+// Asynchronous positional reads: io_uring where the kernel allows it, otherwise a
+// small pool of pread threads
+class IoEngine
+{
+public:
+    enum class Kind
+    {
+        Auto,
+        IoUring,
+        ThreadPool
+    };
+
+    virtual ~IoEngine() = default;
+
+    // Queue a read; the request must stay alive until wait() returns for it
+    virtual void submit(ReadRequest &request) = 0;
+
+    // Block until the request has completed
+    virtual void wait(ReadRequest &request) = 0;
+
+    virtual const char *name() const = 0;
+
+    // Engine for the calling thread, honouring the preferred kind
+    static IoEngine &forThisThread();
+
+    // Engine choice for threads that have not created theirs yet
+    static void setPreferred(Kind kind);
+    static Kind preferred();
+};
+
+// Raw-syscall io_uring, one ring per thread
+class IoUringEngine : public IoEngine
+{
+public:
+    explicit IoUringEngine(unsigned entries = 1024);
+    ~IoUringEngine() override;
+
+    IoUringEngine(const IoUringEngine &) = delete;
+    IoUringEngine &operator=(const IoUringEngine &) = delete;
+
+    // Hands the read to the kernel at once, so it proceeds while the caller works
+    void submit(ReadRequest &request) override;
+    void wait(ReadRequest &request) override;
+    const char *name() const override { return "io_uring"; }
+
+    // Mark reads that have completed as done, without blocking
+    void poll();
+
+    // Whether io_uring can be set up here (kernel support, seccomp, limits)
+    static bool available();
+
+private:
+    void enter(unsigned minComplete);
+    void reap();
+    void release();
+
+    int fd_;
+    unsigned sqEntries_;
+    unsigned cqEntries_;
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    void *sqes_;
+    size_t sqesSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    void *cqes_;
+    unsigned pending_;  // Queued but not yet submitted
+    unsigned inFlight_; // Submitted, completion not yet reaped
+};
+
+// pread on a shared pool of threads
+class ThreadPoolEngine : public IoEngine
+{
+public:
+    explicit ThreadPoolEngine(size_t threads = 4);
+    ~ThreadPoolEngine() override;
+
+    void submit(ReadRequest &request) override;
+    void wait(ReadRequest &request) override;
+    const char *name() const override { return "threads"; }
+
+    static ThreadPoolEngine &shared();
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable completed_;
+    std::deque<ReadRequest *> queue_;
+    std::vector<std::thread> threads_;
+    bool stopping_;
+};
+
+// Input read ahead of the parser: while one buffer is parsed, the following
+// buffers of the file are already being read by the engine
+class AsyncSource : public InputSource
+{
+public:
+    AsyncSource(const std::string &filename, IoEngine &engine,
+                size_t bufferSize = 64 * 1024, size_t buffersInFlight = 2, uint64_t offset = 0);
+    ~AsyncSource() override;
+
+    AsyncSource(const AsyncSource &) = delete;
+    AsyncSource &operator=(const AsyncSource &) = delete;
+
+    std::string_view view() const override;
+    void consume(size_t count) override;
+    bool fill() override;
+
+private:
+    // Read buffers keep headroom in front of the data for the previous buffer's partial line
+    struct Buffer
+    {
+        std::vector<char> data;
+        size_t headroom = 0;
+        ReadRequest request;
+    };
+
+    void issue(Buffer &buffer);
+
+    IoEngine &engine_;
+    int fd_;
+    size_t bufferSize_;
+    std::vector<Buffer> buffers_;
+    size_t current_;     // Buffer being parsed
+    size_t begin_;       // View bounds inside the current buffer
+    size_t end_;
+    uint64_t nextOffset_; // File offset of the next read to issue
+    bool endOfFile_;
+};
@@ -0,0 +1,134 @@
+// File: Checkpoint.cpp
+#include "Checkpoint.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace
+{
+    constexpr const char *kMagic = "mdf-checkpoint";
+    constexpr int kVersion = 1;
+    constexpr uint64_t kFingerprintBytes = 64;
+}
+
+std::string Checkpoint::pathFor(const std::string &outputFile)
+{
+    return outputFile + ".checkpoint";
+}
+
+// Layout, one record per line:
+//   mdf-checkpoint 1
+//   output <size> <fingerprint>
+//   last <timestamp> <symbol>        (absent while the output has no rows)
+//   input <offset> <fingerprint> <path>
+bool Checkpoint::load(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string magic;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != kMagic || version != kVersion)
+    {
+        return false;
+    }
+
+    Checkpoint loaded;
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "output")
+        {
+            if (!(fields >> loaded.outputSize >> loaded.outputFingerprint))
+            {
+                return false;
+            }
+        }
+        else if (kind == "last")
+        {
+            if (!(fields >> loaded.lastTimestamp) || !std::getline(fields >> std::ws, loaded.lastSymbol) ||
+                loaded.lastSymbol.empty())
+            {
+                return false;
+            }
+            loaded.hasLastRow = true;
+        }
+        else if (kind == "input")
+        {
+            Input input;
+            if (!(fields >> input.offset >> input.fingerprint) || !std::getline(fields >> std::ws, input.path) ||
+                input.path.empty())
+            {
+                return false;
+            }
+            loaded.inputs.push_back(std::move(input));
+        }
+        else if (!kind.empty())
+        {
+            return false;
+        }
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+void Checkpoint::save(const std::string &path) const
+{
+    const std::string temporary = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << kMagic << ' ' << kVersion << '\n';
+        out << "output " << outputSize << ' ' << outputFingerprint << '\n';
+        if (hasLastRow)
+        {
+            out << "last " << lastTimestamp << ' ' << lastSymbol << '\n';
+        }
+        for (const auto &input : inputs)
+        {
+            out << "input " << input.offset << ' ' << input.fingerprint << ' ' << input.path << '\n';
+        }
+        if (!out)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            throw std::runtime_error("Failed to write checkpoint: " + path);
+        }
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+std::unordered_map<std::string, const Checkpoint::Input *> Checkpoint::byPath() const
+{
+    std::unordered_map<std::string, const Input *> entries;
+    entries.reserve(inputs.size());
+    for (const auto &input : inputs)
+    {
+        entries.emplace(input.path, &input);
+    }
+    return entries;
+}
+
+uint64_t Checkpoint::fingerprint(const std::string &file, uint64_t offset)
+{
+    const uint64_t length = std::min(offset, kFingerprintBytes);
+    char bytes[kFingerprintBytes];
+    std::ifstream in(file, std::ios::binary);
+    if (!in.seekg(static_cast<std::streamoff>(offset - length)) ||
+        !in.read(bytes, static_cast<std::streamsize>(length)))
+    {
+        throw std::runtime_error("Failed to read " + file);
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t i = 0; i < length; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,44 @@
+// File: Checkpoint.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where an incremental merge left off: how far each input was read, the last row
+// written and the size of the output. It is kept in a text manifest next to the
+// output (see pathFor). Every offset comes with a fingerprint of the bytes just
+// before it, which tells a file that was appended to from one that was rewritten.
+class Checkpoint
+{
+public:
+    struct Input
+    {
+        std::string path;     // As passed to the merge
+        uint64_t offset;      // Bytes merged so far
+        uint64_t fingerprint; // Of the bytes before offset (see fingerprint())
+    };
+
+    uint64_t outputSize = 0;
+    uint64_t outputFingerprint = 0;
+    bool hasLastRow = false; // False while the output holds only its header
+    int64_t lastTimestamp = 0;
+    std::string lastSymbol;
+    std::vector<Input> inputs;
+
+    // "<output>.checkpoint"
+    static std::string pathFor(const std::string &outputFile);
+
+    // Read a manifest; false if it is missing or unreadable
+    bool load(const std::string &path);
+
+    // Write the manifest atomically (temporary file, then rename); throws on failure
+    void save(const std::string &path) const;
+
+    // Entries of the inputs by path, for lookups in constant time; valid until inputs changes
+    std::unordered_map<std::string, const Input *> byPath() const;
+
+    // FNV-1a over the (up to) 64 bytes of a file before offset; throws if unreadable
+    static uint64_t fingerprint(const std::string &file, uint64_t offset);
+};
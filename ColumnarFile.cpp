@@ -0,0 +1,256 @@
+// File: ColumnarFile.cpp
+#include "ColumnarFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char ColumnarHeader::kMagic[8];
+
+namespace
+{
+    void appendName(std::string &out, std::string_view name)
+    {
+        if (name.size() > UINT16_MAX)
+        {
+            throw std::runtime_error("Name too long for columnar dictionary: " + std::string(name));
+        }
+        uint16_t length = static_cast<uint16_t>(name.size());
+        out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out.append(name.data(), name.size());
+    }
+
+    // Reads a dictionary of count names at offset; throws if it runs past the file
+    std::vector<std::string> readNames(const char *data, size_t size, uint64_t offset, uint32_t count)
+    {
+        std::vector<std::string> names;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint16_t length = 0;
+            if (offset + sizeof(length) > size)
+            {
+                throw std::runtime_error("Corrupt columnar dictionary");
+            }
+            std::memcpy(&length, data + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > size)
+            {
+                throw std::runtime_error("Corrupt columnar dictionary");
+            }
+            names.emplace_back(data + offset, length);
+            offset += length;
+        }
+        return names;
+    }
+
+    uint64_t roundUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+// ColumnarSink implementation
+ColumnarSink::ColumnarSink(const std::string &filename, bool directIo, uint32_t blockRows)
+    : filename_(filename), output_(filename, directIo), header_(), block_(std::max<uint32_t>(blockRows, 1)),
+      symbolIds_(std::max<uint32_t>(blockRows, 1)), offset_(0)
+{
+    std::memcpy(header_.magic, ColumnarHeader::kMagic, sizeof(header_.magic));
+    header_.version = ColumnarHeader::kVersion;
+    header_.blockRows = std::max<uint32_t>(blockRows, 1);
+}
+
+void ColumnarSink::begin(const SymbolTable &symbols)
+{
+    // The header is rewritten with the final counts and offsets by finish()
+    header_.symbolCount = static_cast<uint32_t>(symbols.size());
+    std::string &out = output_.buffer();
+    out.append(reinterpret_cast<const char *>(&header_), sizeof(header_));
+    for (size_t id = 0; id < symbols.size(); ++id)
+    {
+        appendName(out, symbols.name(static_cast<uint32_t>(id)));
+    }
+    header_.dataOffset = roundUp(out.size(), 4096);
+    out.resize(header_.dataOffset, '\0');
+    offset_ = header_.dataOffset;
+}
+
+void ColumnarSink::write(const MarketDataEntry *entries, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const MarketDataEntry &entry = entries[i];
+        const size_t row = block_.count++;
+        block_.timestamps[row] = entry.timestamp;
+        block_.prices[row] = entry.price;
+        block_.sizes[row] = entry.size;
+        symbolIds_[row] = entry.symbolId;
+        block_.exchanges[row] = entry.exchange;
+        block_.sides[row] = entry.side;
+        if (block_.count == header_.blockRows)
+        {
+            flushBlock();
+        }
+    }
+}
+
+void ColumnarSink::flushBlock()
+{
+    const size_t rows = block_.count;
+    const size_t slots = header_.blockRows;
+    const size_t blockBytes = ColumnarLayout::blockBytes(slots);
+
+    ColumnarBlockIndex entry{};
+    entry.minTimestamp = block_.timestamps[0];
+    entry.maxTimestamp = block_.timestamps[rows - 1];
+    entry.offset = offset_;
+    entry.rows = static_cast<uint32_t>(rows);
+    index_.push_back(entry);
+
+    // Unused slots of a short last block are zero
+    std::string &out = output_.buffer();
+    const size_t start = out.size();
+    out.resize(start + blockBytes, '\0');
+    char *base = &out[start];
+    std::memcpy(base + ColumnarLayout::timestamps(slots), block_.timestamps.data(), rows * sizeof(int64_t));
+    std::memcpy(base + ColumnarLayout::prices(slots), block_.prices.data(), rows * sizeof(int64_t));
+    std::memcpy(base + ColumnarLayout::sizes(slots), block_.sizes.data(), rows * sizeof(int32_t));
+    std::memcpy(base + ColumnarLayout::symbolIds(slots), symbolIds_.data(), rows * sizeof(uint32_t));
+    std::memcpy(base + ColumnarLayout::exchanges(slots), block_.exchanges.data(), rows * sizeof(uint8_t));
+    std::memcpy(base + ColumnarLayout::sides(slots), block_.sides.data(), rows * sizeof(Side));
+    output_.commit();
+
+    offset_ += blockBytes;
+    header_.rows += rows;
+    block_.count = 0;
+}
+
+void ColumnarSink::finish()
+{
+    if (block_.count > 0)
+    {
+        flushBlock();
+    }
+    header_.blockCount = index_.size();
+
+    // Exchange ids are process-wide, so the dictionary is only complete at the end
+    std::string &out = output_.buffer();
+    const size_t start = out.size();
+    header_.exchangeOffset = offset_;
+    header_.exchangeCount = static_cast<uint32_t>(ExchangeTable::size());
+    for (uint32_t id = 0; id < header_.exchangeCount; ++id)
+    {
+        appendName(out, ExchangeTable::name(static_cast<uint8_t>(id)));
+    }
+    offset_ += out.size() - start;
+    header_.indexOffset = roundUp(offset_, 8);
+    out.resize(out.size() + (header_.indexOffset - offset_), '\0');
+    out.append(reinterpret_cast<const char *>(index_.data()), index_.size() * sizeof(ColumnarBlockIndex));
+    output_.close();
+
+    // Patch the header now that counts and offsets are known
+    int fd = ::open(filename_.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || ::pwrite(fd, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)))
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        throw std::runtime_error("Failed to write output file: " + filename_);
+    }
+    ::close(fd);
+}
+
+// ColumnarReader implementation
+ColumnarReader::ColumnarReader(const std::string &filename)
+    : data_(nullptr), size_(0), header_()
+{
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ColumnarHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a columnar file: " + filename);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    data_ = static_cast<const char *>(mapping);
+
+    try
+    {
+        std::memcpy(&header_, data_, sizeof(header_));
+        if (std::memcmp(header_.magic, ColumnarHeader::kMagic, sizeof(header_.magic)) != 0 ||
+            header_.version != ColumnarHeader::kVersion || header_.blockRows == 0)
+        {
+            throw std::runtime_error("Not a columnar file: " + filename);
+        }
+        const uint64_t indexBytes = header_.blockCount * sizeof(ColumnarBlockIndex);
+        if (header_.indexOffset + indexBytes > size_ ||
+            header_.dataOffset + header_.blockCount * ColumnarLayout::blockBytes(header_.blockRows) > size_)
+        {
+            throw std::runtime_error("Truncated columnar file: " + filename);
+        }
+
+        symbols_ = readNames(data_, size_, sizeof(ColumnarHeader), header_.symbolCount);
+        exchanges_ = readNames(data_, size_, header_.exchangeOffset, header_.exchangeCount);
+        index_.resize(header_.blockCount);
+        std::memcpy(index_.data(), data_ + header_.indexOffset, indexBytes);
+    }
+    catch (...)
+    {
+        ::munmap(const_cast<char *>(data_), size_);
+        throw;
+    }
+    ::madvise(const_cast<char *>(data_), size_, MADV_RANDOM);
+}
+
+ColumnarReader::~ColumnarReader()
+{
+    ::munmap(const_cast<char *>(data_), size_);
+}
+
+size_t ColumnarReader::findBlock(int64_t timestamp) const
+{
+    auto it = std::lower_bound(index_.begin(), index_.end(), timestamp,
+                               [](const ColumnarBlockIndex &block, int64_t value)
+                               { return block.maxTimestamp < value; });
+    return static_cast<size_t>(it - index_.begin());
+}
+
+uint64_t ColumnarReader::lowerBound(int64_t timestamp) const
+{
+    const size_t i = findBlock(timestamp);
+    if (i == index_.size())
+    {
+        return header_.rows;
+    }
+    const int64_t *times = timestamps(i);
+    const size_t row = static_cast<size_t>(std::lower_bound(times, times + index_[i].rows, timestamp) - times);
+    return static_cast<uint64_t>(i) * header_.blockRows + row;
+}
+
+MarketDataEntry ColumnarReader::entry(uint64_t row) const
+{
+    const size_t i = static_cast<size_t>(row / header_.blockRows);
+    const size_t slot = static_cast<size_t>(row % header_.blockRows);
+    MarketDataEntry result;
+    result.timestamp = timestamps(i)[slot];
+    result.price = prices(i)[slot];
+    result.size = sizes(i)[slot];
+    result.symbolId = symbolIds(i)[slot];
+    result.exchange = exchangeIds(i)[slot];
+    result.side = sides(i)[slot];
+    return result;
+}
@@ -0,0 +1,141 @@
+// File: ColumnarFile.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include "OutputSink.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary columnar layout of merged output, native byte order:
+//
+//   ColumnarHeader
+//   symbol dictionary      symbolCount x (uint16 length, bytes), in id order
+//   padding to 4096
+//   blocks                 blockCount x blockBytes(blockRows); each block holds blockRows
+//                          slots of every column back to back (timestamps, prices, sizes,
+//                          symbol ids, exchanges, sides); the last block is zero-padded
+//   exchange dictionary    exchangeCount x (uint16 length, bytes), in id order
+//   padding to 8
+//   block index            blockCount x ColumnarBlockIndex
+//
+// Rows are in merge order, so the index's time ranges are ascending and a reader can
+// binary-search it to reach any time range without touching the blocks before it.
+struct ColumnarHeader
+{
+    static constexpr char kMagic[8] = {'M', 'D', 'F', 'C', 'O', 'L', '0', '1'};
+    static constexpr uint32_t kVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t blockRows;
+    uint64_t rows;
+    uint64_t blockCount;
+    uint64_t dataOffset;     // First block
+    uint64_t exchangeOffset; // Exchange dictionary
+    uint64_t indexOffset;    // Block index
+    uint32_t symbolCount;
+    uint32_t exchangeCount;
+};
+
+struct ColumnarBlockIndex
+{
+    int64_t minTimestamp;
+    int64_t maxTimestamp;
+    uint64_t offset; // Of the block from the start of the file
+    uint32_t rows;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ColumnarHeader) == 64, "ColumnarHeader layout is part of the file format");
+static_assert(sizeof(ColumnarBlockIndex) == 32, "ColumnarBlockIndex layout is part of the file format");
+
+// Byte offsets of the columns inside a block of blockRows slots
+struct ColumnarLayout
+{
+    static constexpr size_t kRowBytes = 8 + 8 + 4 + 4 + 1 + 1;
+
+    static size_t timestamps(size_t) { return 0; }
+    static size_t prices(size_t blockRows) { return 8 * blockRows; }
+    static size_t sizes(size_t blockRows) { return 16 * blockRows; }
+    static size_t symbolIds(size_t blockRows) { return 20 * blockRows; }
+    static size_t exchanges(size_t blockRows) { return 24 * blockRows; }
+    static size_t sides(size_t blockRows) { return 25 * blockRows; }
+
+    // Rounded up so every block (and so every 8-byte column) stays 8-byte aligned
+    static size_t blockBytes(size_t blockRows) { return (kRowBytes * blockRows + 7) / 8 * 8; }
+};
+
+// Writes merged rows in the columnar layout
+class ColumnarSink : public OutputSink
+{
+public:
+    static constexpr uint32_t kDefaultBlockRows = 4096;
+
+    explicit ColumnarSink(const std::string &filename, bool directIo = false,
+                          uint32_t blockRows = kDefaultBlockRows);
+
+    void begin(const SymbolTable &symbols) override;
+    void write(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    void flushBlock();
+
+    std::string filename_;
+    OutputWriter output_;
+    ColumnarHeader header_;
+    EntryBlock block_;
+    std::vector<uint32_t> symbolIds_;
+    std::vector<ColumnarBlockIndex> index_;
+    uint64_t offset_; // Bytes handed to the writer so far
+};
+
+// Memory-mapped, read-only view of a columnar file
+class ColumnarReader
+{
+public:
+    explicit ColumnarReader(const std::string &filename);
+    ~ColumnarReader();
+
+    ColumnarReader(const ColumnarReader &) = delete;
+    ColumnarReader &operator=(const ColumnarReader &) = delete;
+
+    uint64_t rows() const { return header_.rows; }
+    size_t blockCount() const { return index_.size(); }
+    const ColumnarBlockIndex &block(size_t i) const { return index_[i]; }
+    const std::vector<std::string> &symbols() const { return symbols_; }
+    const std::vector<std::string> &exchanges() const { return exchanges_; }
+
+    // Columns of block i, each with block(i).rows valid values
+    const int64_t *timestamps(size_t i) const { return column<int64_t>(i, ColumnarLayout::timestamps(header_.blockRows)); }
+    const int64_t *prices(size_t i) const { return column<int64_t>(i, ColumnarLayout::prices(header_.blockRows)); }
+    const int32_t *sizes(size_t i) const { return column<int32_t>(i, ColumnarLayout::sizes(header_.blockRows)); }
+    const uint32_t *symbolIds(size_t i) const { return column<uint32_t>(i, ColumnarLayout::symbolIds(header_.blockRows)); }
+    const uint8_t *exchangeIds(size_t i) const { return column<uint8_t>(i, ColumnarLayout::exchanges(header_.blockRows)); }
+    const Side *sides(size_t i) const { return column<Side>(i, ColumnarLayout::sides(header_.blockRows)); }
+
+    // First block whose rows may reach timestamp (blockCount() if none), by binary search
+    size_t findBlock(int64_t timestamp) const;
+
+    // Global row number of the first row at or after timestamp (rows() if none)
+    uint64_t lowerBound(int64_t timestamp) const;
+
+    // Row by global number, with the symbol id of this file's dictionary
+    MarketDataEntry entry(uint64_t row) const;
+
+private:
+    template <typename T>
+    const T *column(size_t i, size_t offset) const
+    {
+        return reinterpret_cast<const T *>(data_ + index_[i].offset + offset);
+    }
+
+    const char *data_;
+    size_t size_;
+    ColumnarHeader header_;
+    std::vector<std::string> symbols_;
+    std::vector<std::string> exchanges_;
+    std::vector<ColumnarBlockIndex> index_;
+};
@@ -0,0 +1,619 @@
+// File: Compression.cpp
+#include "Compression.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+
+#if __has_include(<zlib.h>)
+#define COMPRESSION_ZLIB 1
+#include <zlib.h>
+#endif
+
+#if __has_include(<zstd.h>)
+#define COMPRESSION_ZSTD 1
+#include <zstd.h>
+#endif
+
+// One unit of work on the codec pool: a block to compress, a zstd frame to decode,
+// or the next chunk of a streamed decode
+struct CodecJob
+{
+    std::string input;
+    std::string output;
+    bool stream = false;
+    bool last = false; // Stream jobs: the compressed stream ended
+    std::atomic<bool> done{false};
+    std::exception_ptr error;
+};
+
+// Sequential decoder pulling compressed bytes from a raw source
+class StreamDecoder
+{
+public:
+    virtual ~StreamDecoder() = default;
+
+    // Append decoded bytes to out until it holds at least limit bytes; false once the
+    // compressed stream is exhausted
+    virtual bool decode(InputSource &raw, std::string &out, size_t limit) = 0;
+};
+
+namespace
+{
+    constexpr size_t kStreamChunkBytes = 256 * 1024; // Decoded bytes per stream job
+    constexpr size_t kDecodeStep = 64 * 1024;
+    constexpr size_t kMaxFrameBytes = 8 * 1024 * 1024; // Larger zstd frames are streamed
+
+    // Jobs a reader or writer keeps in flight
+    size_t jobsAhead()
+    {
+        return Codec::pool().size() + 1;
+    }
+
+    void runJob(const std::shared_ptr<CodecJob> &job, std::function<void(CodecJob &)> work)
+    {
+        Codec::pool().submit([job, work = std::move(work)]()
+                             {
+                                 try
+                                 {
+                                     work(*job);
+                                 }
+                                 catch (...)
+                                 {
+                                     job->error = std::current_exception();
+                                 }
+                                 job->done.store(true, std::memory_order_release);
+                                 Codec::pool().notifyAll(); });
+    }
+
+    void awaitJob(CodecJob &job)
+    {
+        Codec::pool().helpUntil([&job]()
+                                { return job.done.load(std::memory_order_acquire); });
+    }
+
+    [[noreturn]] void throwUnavailable(Compression compression)
+    {
+        throw std::runtime_error(std::string(Codec::name(compression)) + " support was not compiled in");
+    }
+
+    // Raw source that counts the compressed bytes a decoder took from it
+    class CountingSource : public InputSource
+    {
+    public:
+        explicit CountingSource(InputSource &inner) : inner_(inner), consumed_(0) {}
+
+        std::string_view view() const override { return inner_.view(); }
+
+        void consume(size_t count) override
+        {
+            inner_.consume(count);
+            consumed_ += count;
+        }
+
+        bool fill() override { return inner_.fill(); }
+
+        uint64_t consumed() const { return consumed_; }
+
+    private:
+        InputSource &inner_;
+        uint64_t consumed_;
+    };
+
+#ifdef COMPRESSION_ZLIB
+    class GzipDecoder : public StreamDecoder
+    {
+    public:
+        explicit GzipDecoder(const std::string &filename)
+            : filename_(filename), midMember_(false)
+        {
+            std::memset(&stream_, 0, sizeof(stream_));
+            // 15 + 32: full window, gzip or zlib header detected automatically
+            if (inflateInit2(&stream_, 15 + 32) != Z_OK)
+            {
+                throw std::runtime_error("Failed to initialise gzip decoder");
+            }
+        }
+
+        ~GzipDecoder() override
+        {
+            inflateEnd(&stream_);
+        }
+
+        bool decode(InputSource &raw, std::string &out, size_t limit) override
+        {
+            while (out.size() < limit)
+            {
+                std::string_view in = raw.view();
+                if (in.empty())
+                {
+                    if (!raw.fill())
+                    {
+                        if (midMember_)
+                        {
+                            throw std::runtime_error("Truncated gzip file: " + filename_);
+                        }
+                        return false;
+                    }
+                    continue;
+                }
+
+                const size_t old = out.size();
+                out.resize(old + kDecodeStep);
+                stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+                stream_.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT32_MAX));
+                stream_.next_out = reinterpret_cast<Bytef *>(&out[old]);
+                stream_.avail_out = static_cast<uInt>(kDecodeStep);
+                const uInt offered = stream_.avail_in;
+                int result = inflate(&stream_, Z_NO_FLUSH);
+                raw.consume(offered - stream_.avail_in);
+                out.resize(old + kDecodeStep - stream_.avail_out);
+
+                if (result == Z_STREAM_END)
+                {
+                    // Concatenated members continue the same file
+                    inflateReset(&stream_);
+                    midMember_ = false;
+                }
+                else if (result == Z_OK || result == Z_BUF_ERROR)
+                {
+                    midMember_ = true;
+                }
+                else
+                {
+                    throw std::runtime_error("Corrupt gzip file: " + filename_);
+                }
+            }
+            return true;
+        }
+
+    private:
+        std::string filename_;
+        z_stream stream_;
+        bool midMember_;
+    };
+#endif
+
+#ifdef COMPRESSION_ZSTD
+    class ZstdDecoder : public StreamDecoder
+    {
+    public:
+        explicit ZstdDecoder(const std::string &filename)
+            : filename_(filename), context_(ZSTD_createDCtx()), midFrame_(false)
+        {
+            if (!context_)
+            {
+                throw std::runtime_error("Failed to initialise zstd decoder");
+            }
+        }
+
+        ~ZstdDecoder() override
+        {
+            ZSTD_freeDCtx(context_);
+        }
+
+        bool decode(InputSource &raw, std::string &out, size_t limit) override
+        {
+            while (out.size() < limit)
+            {
+                std::string_view in = raw.view();
+                if (in.empty())
+                {
+                    if (!raw.fill())
+                    {
+                        if (midFrame_)
+                        {
+                            throw std::runtime_error("Truncated zstd file: " + filename_);
+                        }
+                        return false;
+                    }
+                    continue;
+                }
+
+                const size_t old = out.size();
+                out.resize(old + kDecodeStep);
+                ZSTD_inBuffer input = {in.data(), in.size(), 0};
+                ZSTD_outBuffer output = {&out[old], kDecodeStep, 0};
+                size_t result = ZSTD_decompressStream(context_, &output, &input);
+                raw.consume(input.pos);
+                out.resize(old + output.pos);
+                if (ZSTD_isError(result))
+                {
+                    throw std::runtime_error("Corrupt zstd file: " + filename_ + " (" + ZSTD_getErrorName(result) + ")");
+                }
+                midFrame_ = result != 0;
+            }
+            return true;
+        }
+
+    private:
+        std::string filename_;
+        ZSTD_DCtx *context_;
+        bool midFrame_;
+    };
+
+    // Decode one complete frame with this thread's context
+    void decodeFrame(CodecJob &job)
+    {
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        unsigned long long size = ZSTD_getFrameContentSize(job.input.data(), job.input.size());
+        if (size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR)
+        {
+            job.output.resize(size);
+            size_t result = ZSTD_decompressDCtx(context.get(), &job.output[0], job.output.size(),
+                                                job.input.data(), job.input.size());
+            if (ZSTD_isError(result))
+            {
+                throw std::runtime_error(std::string("Corrupt zstd frame: ") + ZSTD_getErrorName(result));
+            }
+            job.output.resize(result);
+            return;
+        }
+
+        // No size in the frame header: decode as a stream
+        ZSTD_DCtx_reset(context.get(), ZSTD_reset_session_only);
+        ZSTD_inBuffer input = {job.input.data(), job.input.size(), 0};
+        while (input.pos < input.size)
+        {
+            const size_t old = job.output.size();
+            job.output.resize(old + kDecodeStep);
+            ZSTD_outBuffer output = {&job.output[old], kDecodeStep, 0};
+            size_t result = ZSTD_decompressStream(context.get(), &output, &input);
+            job.output.resize(old + output.pos);
+            if (ZSTD_isError(result))
+            {
+                throw std::runtime_error(std::string("Corrupt zstd frame: ") + ZSTD_getErrorName(result));
+            }
+            if (result == 0 && input.pos == input.size)
+            {
+                break;
+            }
+        }
+    }
+#endif
+
+    std::unique_ptr<StreamDecoder> makeDecoder(Compression compression, const std::string &filename)
+    {
+        switch (compression)
+        {
+#ifdef COMPRESSION_ZLIB
+        case Compression::Gzip:
+            return std::make_unique<GzipDecoder>(filename);
+#endif
+#ifdef COMPRESSION_ZSTD
+        case Compression::Zstd:
+            return std::make_unique<ZstdDecoder>(filename);
+#endif
+        default:
+            throwUnavailable(compression);
+        }
+    }
+}
+
+// Codec implementation
+Compression Codec::fromFilename(const std::string &filename)
+{
+    const std::string extension = std::filesystem::path(filename).extension().string();
+    if (extension == ".gz")
+    {
+        return Compression::Gzip;
+    }
+    if (extension == ".zst")
+    {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+bool Codec::available(Compression compression)
+{
+    switch (compression)
+    {
+    case Compression::None:
+        return true;
+    case Compression::Gzip:
+#ifdef COMPRESSION_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Compression::Zstd:
+#ifdef COMPRESSION_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char *Codec::name(Compression compression)
+{
+    switch (compression)
+    {
+    case Compression::Gzip:
+        return "gzip";
+    case Compression::Zstd:
+        return "zstd";
+    default:
+        return "none";
+    }
+}
+
+void Codec::compress(Compression compression, std::string_view data, std::string &out, int level)
+{
+    const size_t old = out.size();
+    if (compression == Compression::Gzip)
+    {
+#ifdef COMPRESSION_ZLIB
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        // 15 + 16: full window with a gzip header
+        if (deflateInit2(&stream, level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("Failed to initialise gzip encoder");
+        }
+        out.resize(old + deflateBound(&stream, static_cast<uLong>(data.size())));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef *>(&out[old]);
+        stream.avail_out = static_cast<uInt>(out.size() - old);
+        int result = deflate(&stream, Z_FINISH);
+        out.resize(old + stream.total_out);
+        deflateEnd(&stream);
+        if (result != Z_STREAM_END)
+        {
+            throw std::runtime_error("gzip compression failed");
+        }
+        return;
+#else
+        throwUnavailable(compression);
+#endif
+    }
+    if (compression == Compression::Zstd)
+    {
+#ifdef COMPRESSION_ZSTD
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        out.resize(old + ZSTD_compressBound(data.size()));
+        size_t result = ZSTD_compressCCtx(context.get(), &out[old], out.size() - old, data.data(), data.size(),
+                                          level == 0 ? ZSTD_CLEVEL_DEFAULT : level);
+        if (ZSTD_isError(result))
+        {
+            throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(result));
+        }
+        out.resize(old + result);
+        return;
+#else
+        throwUnavailable(compression);
+#endif
+    }
+    out.append(data.data(), data.size());
+}
+
+uint64_t Codec::estimatedSize(const std::string &filename)
+{
+    constexpr size_t kSampleBytes = 64 * 1024; // Decoded bytes the ratio is taken over
+    const uint64_t stored = std::filesystem::file_size(filename);
+    const Compression compression = fromFilename(filename);
+    if (compression == Compression::None || !available(compression) || stored == 0)
+    {
+        return stored;
+    }
+
+    StreamSource file(filename);
+    CountingSource raw(file);
+    std::string sample;
+    makeDecoder(compression, filename)->decode(raw, sample, kSampleBytes);
+    if (raw.consumed() == 0)
+    {
+        return stored;
+    }
+    return static_cast<uint64_t>(static_cast<double>(stored) * static_cast<double>(sample.size()) /
+                                 static_cast<double>(raw.consumed()));
+}
+
+ThreadPool &Codec::pool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+// DecompressingSource implementation
+DecompressingSource::DecompressingSource(std::unique_ptr<InputSource> raw, Compression compression,
+                                         const std::string &filename)
+    : raw_(std::move(raw)), compression_(compression), filename_(filename),
+      framed_(compression == Compression::Zstd), streaming_(false), rawDone_(false),
+      data_(kStreamChunkBytes), begin_(0), end_(0)
+{
+    decoder_ = makeDecoder(compression, filename);
+    topUp();
+}
+
+DecompressingSource::~DecompressingSource()
+{
+    // Jobs may still be using the decoder and the raw source
+    for (auto &job : pending_)
+    {
+        awaitJob(*job);
+    }
+}
+
+std::string_view DecompressingSource::view() const
+{
+    return std::string_view(data_.data() + begin_, end_ - begin_);
+}
+
+void DecompressingSource::consume(size_t count)
+{
+    begin_ += count;
+}
+
+bool DecompressingSource::fill()
+{
+    while (!pending_.empty())
+    {
+        std::shared_ptr<CodecJob> job = pending_.front();
+        pending_.pop_front();
+        awaitJob(*job);
+        if (job->error)
+        {
+            std::rethrow_exception(job->error);
+        }
+        if (job->stream)
+        {
+            streaming_ = false;
+            rawDone_ = job->last;
+        }
+        topUp(); // Keep the pool busy while the parser works through this chunk
+        if (job->output.empty())
+        {
+            continue;
+        }
+
+        // Keep the unconsumed bytes in front of the new ones
+        const size_t kept = end_ - begin_;
+        if (kept + job->output.size() > data_.size())
+        {
+            data_.resize(kept + job->output.size());
+        }
+        std::memmove(data_.data(), data_.data() + begin_, kept);
+        std::memcpy(data_.data() + kept, job->output.data(), job->output.size());
+        begin_ = 0;
+        end_ = kept + job->output.size();
+        return true;
+    }
+    return false;
+}
+
+void DecompressingSource::topUp()
+{
+    // Independent frames first, as many as the pool can take
+    while (framed_ && !rawDone_ && pending_.size() < jobsAhead())
+    {
+        if (!nextFrame())
+        {
+            break;
+        }
+    }
+
+    // Then (or instead) a stream job, one at a time since they share the decoder
+    if (!framed_ && !rawDone_ && !streaming_)
+    {
+        submitStream();
+    }
+}
+
+bool DecompressingSource::nextFrame()
+{
+#ifdef COMPRESSION_ZSTD
+    for (;;)
+    {
+        std::string_view bytes = raw_->view();
+        if (!bytes.empty())
+        {
+            size_t size = ZSTD_findFrameCompressedSize(bytes.data(), bytes.size());
+            if (!ZSTD_isError(size))
+            {
+                auto job = std::make_shared<CodecJob>();
+                job->input.assign(bytes.data(), size);
+                raw_->consume(size);
+                pending_.push_back(job);
+                runJob(job, decodeFrame);
+                return true;
+            }
+            if (bytes.size() >= kMaxFrameBytes)
+            {
+                framed_ = false; // Too big to hold whole; the rest of the file is streamed
+                return false;
+            }
+        }
+        if (!raw_->fill())
+        {
+            if (bytes.empty())
+            {
+                rawDone_ = true;
+                return false;
+            }
+            framed_ = false; // Let the stream decoder report the damage
+            return false;
+        }
+    }
+#else
+    framed_ = false;
+    return false;
+#endif
+}
+
+void DecompressingSource::submitStream()
+{
+    auto job = std::make_shared<CodecJob>();
+    job->stream = true;
+    streaming_ = true;
+    pending_.push_back(job);
+    runJob(job, [this](CodecJob &work)
+           { work.last = !decoder_->decode(*raw_, work.output, kStreamChunkBytes); });
+}
+
+// BlockCompressor implementation
+BlockCompressor::BlockCompressor(OutputWriter &output, Compression compression, int level)
+    : output_(output), compression_(compression), level_(level)
+{
+    if (!Codec::available(compression))
+    {
+        throwUnavailable(compression);
+    }
+    block_.reserve(kBlockBytes + 4096);
+}
+
+BlockCompressor::~BlockCompressor()
+{
+    for (auto &job : pending_)
+    {
+        awaitJob(*job);
+    }
+}
+
+void BlockCompressor::close()
+{
+    if (!block_.empty())
+    {
+        submit();
+    }
+    drain(0);
+}
+
+void BlockCompressor::submit()
+{
+    auto job = std::make_shared<CodecJob>();
+    job->input.swap(block_);
+    block_.reserve(kBlockBytes + 4096);
+    pending_.push_back(job);
+    const Compression compression = compression_;
+    const int level = level_;
+    runJob(job, [compression, level](CodecJob &work)
+           {
+               Codec::compress(compression, work.input, work.output, level);
+               std::string().swap(work.input); });
+    drain(jobsAhead());
+}
+
+void BlockCompressor::drain(size_t keep)
+{
+    while (pending_.size() > keep)
+    {
+        std::shared_ptr<CodecJob> job = pending_.front();
+        pending_.pop_front();
+        awaitJob(*job);
+        if (job->error)
+        {
+            std::rethrow_exception(job->error);
+        }
+        output_.buffer() += job->output;
+        output_.commit();
+    }
+}
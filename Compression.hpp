@@ -0,0 +1,122 @@
+// File: Compression.hpp
+#pragma once
+
+#include "InputSource.hpp"
+#include "OutputWriter.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+struct CodecJob;
+class StreamDecoder;
+
+// Compression of an input or output file, chosen by its extension
+enum class Compression
+{
+    None,
+    Gzip, // .gz
+    Zstd  // .zst
+};
+
+// Whole-buffer codecs and the pool their jobs run on. Support for each format is
+// compiled in when its header (zlib.h, zstd.h) is found.
+class Codec
+{
+public:
+    static Compression fromFilename(const std::string &filename);
+
+    static bool available(Compression compression);
+    static const char *name(Compression compression);
+
+    // Append data as one self-contained gzip member or zstd frame; concatenations of
+    // these are still valid files, so blocks can be compressed independently.
+    // level 0 picks the format's default.
+    static void compress(Compression compression, std::string_view data, std::string &out, int level = 0);
+
+    // Bytes the file holds once decoded: its size, or for a compressed file its size
+    // scaled by the ratio of a sample decoded from its start
+    static uint64_t estimatedSize(const std::string &filename);
+
+    // Process-wide pool for (de)compression jobs, kept apart from the merge pool so
+    // that a reader waiting on its next chunk never runs another batch's merge
+    static ThreadPool &pool();
+};
+
+// Decoded bytes of a compressed file, over the raw source of the compressed bytes.
+// Zstd files made of independent frames (as BlockCompressor writes them) decode
+// several frames at once on the codec pool; gzip, and zstd frames too large to
+// buffer, decode as a stream one chunk ahead of the parser.
+class DecompressingSource : public InputSource
+{
+public:
+    DecompressingSource(std::unique_ptr<InputSource> raw, Compression compression, const std::string &filename);
+    ~DecompressingSource() override;
+
+    DecompressingSource(const DecompressingSource &) = delete;
+    DecompressingSource &operator=(const DecompressingSource &) = delete;
+
+    std::string_view view() const override;
+    void consume(size_t count) override;
+    bool fill() override;
+
+private:
+    void topUp();
+    bool nextFrame();
+    void submitStream();
+
+    std::unique_ptr<InputSource> raw_;
+    Compression compression_;
+    std::string filename_;
+    std::unique_ptr<StreamDecoder> decoder_; // Used by one stream job at a time
+    std::deque<std::shared_ptr<CodecJob>> pending_; // In file order
+    bool framed_;    // Still splitting zstd frames off the raw source
+    bool streaming_; // A stream job is in flight
+    bool rawDone_;   // Every compressed byte has been handed to a job
+    std::vector<char> data_;
+    size_t begin_;
+    size_t end_;
+};
+
+// Compresses text in fixed-size blocks on the codec pool and hands the results to
+// an OutputWriter in order
+class BlockCompressor
+{
+public:
+    static constexpr size_t kBlockBytes = 1024 * 1024;
+
+    BlockCompressor(OutputWriter &output, Compression compression, int level = 0);
+    ~BlockCompressor();
+
+    BlockCompressor(const BlockCompressor &) = delete;
+    BlockCompressor &operator=(const BlockCompressor &) = delete;
+
+    // Text of the current block; append, then call commit()
+    std::string &buffer() { return block_; }
+
+    // Start compressing the block once it is full
+    void commit()
+    {
+        if (block_.size() >= kBlockBytes)
+        {
+            submit();
+        }
+    }
+
+    // Compress what is left and pass every block to the writer (which stays open)
+    void close();
+
+private:
+    void submit();
+    void drain(size_t keep);
+
+    OutputWriter &output_;
+    Compression compression_;
+    int level_;
+    std::string block_;
+    std::deque<std::shared_ptr<CodecJob>> pending_;
+};
@@ -1,9 +0,0 @@
-// File: Entry.cpp
-#include "Entry.hpp"
-#include <algorithm>
-
-bool Entry::operator>(const Entry& other) const {
-    if (timestamp != other.timestamp)
-        return timestamp > other.timestamp;
-    return symbol > other.symbol;
-}
\ No newline at end of file
@@ -2,17 +2,9 @@
 #ifndef ENTRY_HPP
 #define ENTRY_HPP
 
-#include <string>
+#include "MarketDataEntry.hpp"
 
-struct Entry {
-    std::string symbol;
-    std::string timestamp;
-    double price;
-    int size;
-    std::string exchange;
-    std::string type;
+// The standalone reader shares the packed record used by FileMerger
+using Entry = MarketDataEntry;
 
-    bool operator>(const Entry& other) const;
-};
-
-#endif // ENTRY_HPP
\ No newline at end of file
+#endif // ENTRY_HPP
@@ -0,0 +1,192 @@
+// File: FeedMerger.hpp
+#pragma once
+
+#include "FeedSchema.hpp"
+#include "FileMerger.hpp"
+#include "KWayMerge.hpp"
+#include "OutputWriter.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Timestamp-ordered merge of feed files laid out by a schema (see FeedSchema.hpp).
+// Every schema gets its own reader and merge loop, with the column parsers and the
+// key comparison inlined: batches of files are merged into sorted runs on the
+// thread pool, then the runs are merged into a text file with a "Symbol" column
+// in front of the schema's own.
+template <typename Schema>
+class FeedMerger
+{
+public:
+    using Traits = SchemaTraits<Schema>;
+    using Record = typename Schema::Record;
+
+    struct Options
+    {
+        size_t batchSize = 500; // Input files merged into one run
+        size_t threads = 0;     // Worker threads; 0 shares a pool sized to the hardware
+        InputMode inputMode = InputMode::Stream;
+        bool directOutput = false;
+    };
+
+    // Rows of one file, after a header naming the schema's columns
+    struct Reader
+    {
+        FileMerger::LineBuffer input;
+        Record currentEntry;
+        bool hasMoreData;
+
+        Reader(uint32_t symbolId, const std::string &filename, InputMode mode)
+            : currentEntry(), hasMoreData(false)
+        {
+            currentEntry.symbolId = symbolId;
+            input.open(filename, mode);
+
+            std::string_view fields[Traits::kFields];
+            const size_t count = nextRow(fields);
+            if (count == 0)
+            {
+                return; // Empty file
+            }
+            if (!Traits::matchesHeader(fields, count))
+            {
+                throw std::runtime_error("Header of " + filename + " does not match the feed schema " +
+                                         Traits::header().substr(0, Traits::header().size() - 1));
+            }
+            hasMoreData = readNextEntry();
+        }
+
+        bool readNextEntry()
+        {
+            std::string_view fields[Traits::kFields];
+            const size_t count = nextRow(fields);
+            if (count > Traits::kFields)
+            {
+                throw std::runtime_error("Too many columns: " + std::string(fields[Traits::kFields - 1]));
+            }
+            hasMoreData = count == Traits::kFields;
+            if (hasMoreData)
+            {
+                Traits::parse(fields, currentEntry);
+            }
+            return hasMoreData;
+        }
+
+    private:
+        // Split the next line into up to kFields columns, the last one taking the rest of
+        // the line, and return how many columns it has (0 at the end of the file). Like
+        // the tick reader, a row with missing columns ends the file.
+        size_t nextRow(std::string_view *fields)
+        {
+            constexpr size_t kDelimiters = Traits::kFields - 1;
+            const char *delimiters[kDelimiters];
+            const char *begin, *end;
+            size_t count;
+            if (!input.nextLine(begin, end, delimiters, kDelimiters, count))
+            {
+                return 0;
+            }
+            const size_t columns = std::min(count, kDelimiters) + 1;
+            for (size_t i = 0; i < columns; ++i)
+            {
+                const char *first = i == 0 ? begin : delimiters[i - 1] + 1;
+                const char *last = i < count && i < kDelimiters ? delimiters[i] : end;
+                fields[i] = LineParser::trim(std::string_view(first, static_cast<size_t>(last - first)));
+            }
+            return count + 1;
+        }
+    };
+
+    // Reader over a sorted run held in memory
+    struct RunReader
+    {
+        const std::vector<Record> *run;
+        size_t position;
+        Record currentEntry;
+        bool hasMoreData;
+
+        explicit RunReader(const std::vector<Record> &run) : run(&run), position(0), currentEntry(), hasMoreData(false)
+        {
+            readNextEntry();
+        }
+
+        bool readNextEntry()
+        {
+            hasMoreData = position < run->size();
+            if (hasMoreData)
+            {
+                currentEntry = (*run)[position++];
+            }
+            return hasMoreData;
+        }
+    };
+
+    static void mergeFiles(const std::vector<std::string> &inputFiles, const std::string &outputFile,
+                           const Options &options)
+    {
+        if (inputFiles.empty())
+        {
+            throw std::runtime_error("No input files provided");
+        }
+        if (options.batchSize == 0)
+        {
+            throw std::runtime_error("Merge options require batchSize >= 1");
+        }
+
+        std::vector<std::string> names;
+        names.reserve(inputFiles.size());
+        for (const auto &file : inputFiles)
+        {
+            names.push_back(SymbolTable::symbolOf(file));
+        }
+        const SymbolTable symbols(std::move(names));
+
+        // Open (and truncate) the output up front so a bad path fails before any work
+        OutputWriter output(outputFile, options.directOutput);
+
+        std::vector<std::vector<Record>> runs((inputFiles.size() + options.batchSize - 1) / options.batchSize);
+        std::unique_ptr<ThreadPool> ownPool;
+        if (options.threads > 0)
+        {
+            ownPool = std::make_unique<ThreadPool>(options.threads);
+        }
+        {
+            TaskGroup group(ownPool ? *ownPool : ThreadPool::shared());
+            for (size_t i = 0; i < runs.size(); ++i)
+            {
+                group.run([&, i]()
+                          {
+                              const size_t first = i * options.batchSize;
+                              const size_t last = std::min(inputFiles.size(), first + options.batchSize);
+                              std::vector<std::unique_ptr<Reader>> readers;
+                              std::vector<Reader *> active;
+                              for (size_t f = first; f < last; ++f)
+                              {
+                                  const uint32_t symbolId = symbols.id(SymbolTable::symbolOf(inputFiles[f]));
+                                  readers.push_back(std::make_unique<Reader>(symbolId, inputFiles[f], options.inputMode));
+                                  active.push_back(readers.back().get());
+                              }
+                              kWayMerge(active, typename Traits::KeyFn(), [&](const Record &record)
+                                        { runs[i].push_back(record); }); });
+            }
+            group.wait();
+        }
+
+        output.buffer() += Traits::header();
+        std::vector<std::unique_ptr<RunReader>> readers;
+        std::vector<RunReader *> active;
+        for (const auto &run : runs)
+        {
+            readers.push_back(std::make_unique<RunReader>(run));
+            active.push_back(readers.back().get());
+        }
+        kWayMerge(active, typename Traits::KeyFn(), [&](const Record &record)
+                  {
+                      Traits::append(output.buffer(), record, symbols);
+                      output.commit(); });
+        output.close();
+    }
+};
@@ -0,0 +1,340 @@
+// File: FeedSchema.hpp
+#pragma once
+
+#include "LineParser.hpp"
+#include "MarketDataEntry.hpp"
+#include "TextFormat.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Compile-time description of a feed file layout. A schema is a struct naming its
+// record type, its columns in file order as a constexpr table of fields, and its
+// merge key as a table of record members:
+//
+//   struct TradeSchema
+//   {
+//       using Record = TradeRecord;
+//       static constexpr auto fields = std::make_tuple(
+//           field<&TradeRecord::timestamp>("Timestamp", FieldKind::Timestamp), ...);
+//       static constexpr auto key = std::make_tuple(&TradeRecord::timestamp, &TradeRecord::symbolId);
+//   };
+//
+// Records carry a symbolId, filled from the file name rather than a column.
+// SchemaTraits turns the tables into a parser, formatter and comparator with every
+// column unrolled at compile time, so no per-field dispatch remains at run time.
+
+// How a column's text maps to its record member
+enum class FieldKind
+{
+    Timestamp, // "YYYY-MM-DD HH:MM:SS[.fff]" (UTC) into int64_t nanoseconds
+    Fixed,     // Decimal into int64_t fixed point with `digits` decimals
+    Int,       // Integer into an integral member, range checked
+    Exchange,  // Name interned into a uint8_t ExchangeTable id
+    Side,      // Bid, Ask or TRADE into a Side
+    Code       // Short text into a char array, NUL padded
+};
+
+// One column: its header name, how it is parsed, and the record member it fills
+template <auto Member>
+struct Field
+{
+    std::string_view name;
+    FieldKind kind;
+    int digits; // Decimals of a Fixed column
+};
+
+template <auto Member>
+constexpr Field<Member> field(std::string_view name, FieldKind kind, int digits = 0)
+{
+    return Field<Member>{name, kind, digits};
+}
+
+namespace schema_detail
+{
+    template <typename Pointer>
+    struct MemberOf;
+
+    template <typename Class, typename Type>
+    struct MemberOf<Type Class::*>
+    {
+        using type = Type;
+    };
+
+    template <auto Member>
+    using MemberType = typename MemberOf<std::remove_cv_t<decltype(Member)>>::type;
+
+    template <typename Table>
+    struct KeyOf;
+
+    template <typename... Pointers>
+    struct KeyOf<std::tuple<Pointers...>>
+    {
+        using type = std::tuple<typename MemberOf<Pointers>::type...>;
+    };
+}
+
+// Parser, formatter and comparator generated from a schema's tables
+template <typename Schema>
+class SchemaTraits
+{
+public:
+    using Record = typename Schema::Record;
+    using Key = typename schema_detail::KeyOf<std::decay_t<decltype(Schema::key)>>::type;
+
+    static constexpr size_t kFields = std::tuple_size<std::decay_t<decltype(Schema::fields)>>::value;
+
+    static_assert(std::is_trivially_copyable<Record>::value, "Schema records are copied raw");
+    static_assert(std::is_same<decltype(Record::symbolId), uint32_t>::value, "Schema records need a uint32_t symbolId");
+
+    static constexpr std::string_view name(size_t i) { return nameAt(i, std::make_index_sequence<kFields>()); }
+
+    // Merge key, compared lexicographically in table order
+    static Key key(const Record &record)
+    {
+        return keyOf(record, std::make_index_sequence<std::tuple_size<Key>::value>());
+    }
+
+    struct KeyFn
+    {
+        Key operator()(const Record &record) const { return SchemaTraits::key(record); }
+    };
+
+    static bool less(const Record &a, const Record &b) { return key(a) < key(b); }
+
+    // Whether a split header line names the schema's columns in order
+    static bool matchesHeader(const std::string_view *fields, size_t count)
+    {
+        if (count != kFields)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < kFields; ++i)
+        {
+            if (fields[i] != name(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Parse kFields trimmed column texts into a record (symbolId is left alone);
+    // throws naming the first column that does not parse
+    static void parse(const std::string_view *fields, Record &record)
+    {
+        parseAll(fields, record, std::make_index_sequence<kFields>());
+    }
+
+    // "Symbol,<columns>\n"
+    static std::string header()
+    {
+        std::string out = "Symbol";
+        for (size_t i = 0; i < kFields; ++i)
+        {
+            out += ',';
+            out += name(i);
+        }
+        out += '\n';
+        return out;
+    }
+
+    // Append a record as "Symbol,<columns>\n"
+    static void append(std::string &out, const Record &record, const SymbolTable &symbols)
+    {
+        out += symbols.name(record.symbolId);
+        appendAll(out, record, std::make_index_sequence<kFields>());
+        out += '\n';
+    }
+
+private:
+    template <size_t... I>
+    static constexpr std::string_view nameAt(size_t i, std::index_sequence<I...>)
+    {
+        std::string_view result;
+        ((i == I ? (result = std::get<I>(Schema::fields).name, 0) : 0), ...);
+        return result;
+    }
+
+    template <size_t... I>
+    static Key keyOf(const Record &record, std::index_sequence<I...>)
+    {
+        return Key(record.*std::get<I>(Schema::key)...);
+    }
+
+    template <size_t... I>
+    static void parseAll(const std::string_view *fields, Record &record, std::index_sequence<I...>)
+    {
+        (parseField<I>(fields[I], record), ...);
+    }
+
+    template <size_t I>
+    static void parseField(std::string_view text, Record &record)
+    {
+        constexpr auto column = std::get<I>(Schema::fields);
+        constexpr auto member = memberOf(column);
+        using Type = schema_detail::MemberType<member>;
+        Type &value = record.*member;
+
+        bool ok = true;
+        if constexpr (column.kind == FieldKind::Timestamp)
+        {
+            static_assert(std::is_same<Type, int64_t>::value, "Timestamp columns fill int64_t members");
+            ok = LineParser::parseTimestamp(text, value);
+        }
+        else if constexpr (column.kind == FieldKind::Fixed)
+        {
+            static_assert(std::is_same<Type, int64_t>::value, "Fixed columns fill int64_t members");
+            ok = LineParser::parseFixed(text, column.digits, value);
+        }
+        else if constexpr (column.kind == FieldKind::Int)
+        {
+            static_assert(std::is_integral<Type>::value && (std::is_signed<Type>::value || sizeof(Type) < 8),
+                          "Int columns fill integral members that int64_t covers");
+            int64_t parsed = 0;
+            ok = LineParser::parseInt(text, parsed) &&
+                 parsed >= static_cast<int64_t>(std::numeric_limits<Type>::min()) &&
+                 parsed <= static_cast<int64_t>(std::numeric_limits<Type>::max());
+            value = static_cast<Type>(parsed);
+        }
+        else if constexpr (column.kind == FieldKind::Exchange)
+        {
+            static_assert(std::is_same<Type, uint8_t>::value, "Exchange columns fill uint8_t members");
+            value = ExchangeTable::intern(text);
+        }
+        else if constexpr (column.kind == FieldKind::Side)
+        {
+            static_assert(std::is_same<Type, Side>::value, "Side columns fill Side members");
+            ok = parseSide(text, value);
+        }
+        else
+        {
+            static_assert(std::is_array<Type>::value, "Code columns fill char arrays");
+            constexpr size_t capacity = std::extent<Type>::value;
+            ok = text.size() <= capacity;
+            std::memset(value, 0, capacity);
+            std::memcpy(value, text.data(), std::min(text.size(), capacity));
+        }
+        if (!ok)
+        {
+            throw std::runtime_error("Invalid " + std::string(column.name) + ": " + std::string(text));
+        }
+    }
+
+    template <size_t... I>
+    static void appendAll(std::string &out, const Record &record, std::index_sequence<I...>)
+    {
+        (appendField<I>(out, record), ...);
+    }
+
+    template <size_t I>
+    static void appendField(std::string &out, const Record &record)
+    {
+        constexpr auto column = std::get<I>(Schema::fields);
+        const auto &value = record.*memberOf(column);
+        char text[TextFormat::kMaxFieldLength];
+
+        out += ',';
+        if constexpr (column.kind == FieldKind::Timestamp)
+        {
+            out.append(text, TextFormat::formatTimestamp(value, text));
+        }
+        else if constexpr (column.kind == FieldKind::Fixed)
+        {
+            out.append(text, TextFormat::formatFixed(value, column.digits, text));
+        }
+        else if constexpr (column.kind == FieldKind::Int)
+        {
+            out.append(text, TextFormat::formatInt(static_cast<int64_t>(value), text));
+        }
+        else if constexpr (column.kind == FieldKind::Exchange)
+        {
+            out += ExchangeTable::name(value);
+        }
+        else if constexpr (column.kind == FieldKind::Side)
+        {
+            out += sideName(value);
+        }
+        else
+        {
+            out.append(value, strnlen(value, sizeof(value)));
+        }
+    }
+
+    template <auto Member>
+    static constexpr auto memberOf(const Field<Member> &)
+    {
+        return Member;
+    }
+};
+
+// Top-of-book quote of one exchange
+struct QuoteRecord
+{
+    int64_t timestamp; // Nanoseconds since the Unix epoch (UTC)
+    int64_t bidPrice;  // Fixed point with MarketDataEntry::kPriceDigits decimals
+    int64_t askPrice;
+    int32_t bidSize;
+    int32_t askSize;
+    uint32_t symbolId;
+    uint8_t exchange;
+};
+
+// Trade print with its sale condition codes
+struct TradeRecord
+{
+    int64_t timestamp;
+    int64_t price;
+    int32_t size;
+    uint32_t symbolId;
+    uint8_t exchange;
+    char conditions[4]; // Up to four one-letter codes, NUL padded
+};
+
+// Timestamp,Price,Size,Exchange,Type: the layout FileMerger reads
+struct TickSchema
+{
+    using Record = MarketDataEntry;
+    static constexpr auto fields = std::make_tuple(
+        field<&MarketDataEntry::timestamp>("Timestamp", FieldKind::Timestamp),
+        field<&MarketDataEntry::price>("Price", FieldKind::Fixed, MarketDataEntry::kPriceDigits),
+        field<&MarketDataEntry::size>("Size", FieldKind::Int),
+        field<&MarketDataEntry::exchange>("Exchange", FieldKind::Exchange),
+        field<&MarketDataEntry::side>("Type", FieldKind::Side));
+    static constexpr auto key = std::make_tuple(&MarketDataEntry::timestamp, &MarketDataEntry::symbolId);
+};
+
+// Timestamp,BidPrice,BidSize,AskPrice,AskSize,Exchange
+struct QuoteSchema
+{
+    using Record = QuoteRecord;
+    static constexpr auto fields = std::make_tuple(
+        field<&QuoteRecord::timestamp>("Timestamp", FieldKind::Timestamp),
+        field<&QuoteRecord::bidPrice>("BidPrice", FieldKind::Fixed, MarketDataEntry::kPriceDigits),
+        field<&QuoteRecord::bidSize>("BidSize", FieldKind::Int),
+        field<&QuoteRecord::askPrice>("AskPrice", FieldKind::Fixed, MarketDataEntry::kPriceDigits),
+        field<&QuoteRecord::askSize>("AskSize", FieldKind::Int),
+        field<&QuoteRecord::exchange>("Exchange", FieldKind::Exchange));
+    static constexpr auto key = std::make_tuple(&QuoteRecord::timestamp, &QuoteRecord::symbolId);
+};
+
+// Timestamp,Price,Size,Exchange,Conditions
+struct TradeSchema
+{
+    using Record = TradeRecord;
+    static constexpr auto fields = std::make_tuple(
+        field<&TradeRecord::timestamp>("Timestamp", FieldKind::Timestamp),
+        field<&TradeRecord::price>("Price", FieldKind::Fixed, MarketDataEntry::kPriceDigits),
+        field<&TradeRecord::size>("Size", FieldKind::Int),
+        field<&TradeRecord::exchange>("Exchange", FieldKind::Exchange),
+        field<&TradeRecord::conditions>("Conditions", FieldKind::Code));
+    static constexpr auto key = std::make_tuple(&TradeRecord::timestamp, &TradeRecord::symbolId);
+};
@@ -0,0 +1,258 @@
+// File: FileDiscovery.cpp
+#include "FileDiscovery.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(SYS_getdents64)
+#define DISCOVERY_GETDENTS 1
+#include <dirent.h>
+#else
+#include <filesystem>
+#endif
+
+namespace
+{
+    enum class EntryKind
+    {
+        File,
+        Directory,
+        Other
+    };
+
+    std::string join(const std::string &directory, const std::string &name)
+    {
+        return directory.empty() || directory.back() == '/' ? directory + name : directory + "/" + name;
+    }
+
+    // One listing: the filters, and the files found so far by every scanning task
+    struct Scan
+    {
+        const FileDiscovery::Options &options;
+        std::unordered_set<std::string> manifest;
+        TaskGroup &group;
+        std::mutex mutex;
+        std::vector<std::string> files;
+
+        Scan(const FileDiscovery::Options &options, TaskGroup &group)
+            : options(options), group(group)
+        {
+        }
+
+        bool wanted(const std::string &name, const std::string &relative) const
+        {
+            if (!options.patterns.empty() &&
+                std::none_of(options.patterns.begin(), options.patterns.end(), [&](const std::string &pattern)
+                             { return ::fnmatch(pattern.c_str(), name.c_str(), 0) == 0; }))
+            {
+                return false;
+            }
+            return options.manifest.empty() || manifest.count(relative) != 0;
+        }
+
+        void add(const std::string &path, const std::string &relative, const std::string &name, EntryKind kind,
+                 std::vector<std::string> &found)
+        {
+            const std::string relativeName = relative.empty() ? name : relative + "/" + name;
+            if (kind == EntryKind::Directory && options.recursive)
+            {
+                group.run([this, directory = join(path, name), relativeName]()
+                          { scan(directory, relativeName); });
+            }
+            else if (kind == EntryKind::File && wanted(name, relativeName))
+            {
+                found.push_back(join(path, name));
+            }
+        }
+
+        // Take a buffer's files, prefetching them as soon as they are parsed
+        void flush(std::vector<std::string> &found)
+        {
+            if (found.empty())
+            {
+                return;
+            }
+            if (options.prefetchBytes > 0)
+            {
+                group.run([chunk = found, bytes = options.prefetchBytes]()
+                          { FileDiscovery::prefetch(chunk, bytes); });
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            files.insert(files.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+            found.clear();
+        }
+
+        void scan(const std::string &path, const std::string &relative);
+    };
+
+#ifdef DISCOVERY_GETDENTS
+    struct DirectoryFd
+    {
+        int fd;
+        ~DirectoryFd() { ::close(fd); }
+    };
+
+    // Kind of an entry whose d_type does not settle it; symlinked directories are not
+    // followed, so a recursive scan cannot loop
+    EntryKind statKind(int directoryFd, const char *name, unsigned char type)
+    {
+        struct stat status;
+        if (type == DT_UNKNOWN)
+        {
+            if (::fstatat(directoryFd, name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                return EntryKind::Other;
+            }
+            if (S_ISDIR(status.st_mode))
+            {
+                return EntryKind::Directory;
+            }
+            if (!S_ISLNK(status.st_mode))
+            {
+                return S_ISREG(status.st_mode) ? EntryKind::File : EntryKind::Other;
+            }
+        }
+        return ::fstatat(directoryFd, name, &status, 0) == 0 && S_ISREG(status.st_mode) ? EntryKind::File
+                                                                                        : EntryKind::Other;
+    }
+
+    void Scan::scan(const std::string &path, const std::string &relative)
+    {
+        const DirectoryFd directory{::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        const int fd = directory.fd;
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Failed to open directory " + path);
+        }
+
+        // linux_dirent64: d_ino (8 bytes), d_off (8), d_reclen (2), d_type (1), d_name
+        constexpr size_t kLengthOffset = 16;
+        constexpr size_t kTypeOffset = 18;
+        constexpr size_t kNameOffset = 19;
+        std::vector<char> buffer(64 * 1024);
+        std::vector<std::string> found;
+        for (;;)
+        {
+            const long bytes = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (bytes < 0)
+            {
+                const int error = errno;
+                if (error == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(error, std::generic_category(), "Failed to read directory " + path);
+            }
+            if (bytes == 0)
+            {
+                break;
+            }
+            for (long position = 0; position < bytes;)
+            {
+                const char *record = buffer.data() + position;
+                unsigned short length;
+                std::memcpy(&length, record + kLengthOffset, sizeof(length));
+                position += length;
+
+                const unsigned char type = static_cast<unsigned char>(record[kTypeOffset]);
+                const char *name = record + kNameOffset;
+                // Hidden entries, "." and ".." included, are never inputs: they hold
+                // sidecars such as the time indexes in .mdf-index
+                if (name[0] == '.')
+                {
+                    continue;
+                }
+                const EntryKind kind = type == DT_REG   ? EntryKind::File
+                                       : type == DT_DIR ? EntryKind::Directory
+                                       : type == DT_LNK || type == DT_UNKNOWN ? statKind(fd, name, type)
+                                                                               : EntryKind::Other;
+                add(path, relative, name, kind, found);
+            }
+            flush(found);
+        }
+    }
+#else
+    void Scan::scan(const std::string &path, const std::string &relative)
+    {
+        std::vector<std::string> found;
+        for (const auto &entry : std::filesystem::directory_iterator(path))
+        {
+            const std::string name = entry.path().filename().string();
+            if (name[0] == '.')
+            {
+                continue;
+            }
+            const EntryKind kind = entry.is_symlink() ? (entry.is_regular_file() ? EntryKind::File : EntryKind::Other)
+                                   : entry.is_directory() ? EntryKind::Directory
+                                   : entry.is_regular_file() ? EntryKind::File
+                                                             : EntryKind::Other;
+            add(path, relative, name, kind, found);
+        }
+        flush(found);
+    }
+#endif
+}
+
+std::vector<std::string> FileDiscovery::list(const std::string &directory)
+{
+    return list(directory, Options(), ThreadPool::shared());
+}
+
+std::vector<std::string> FileDiscovery::list(const std::string &directory, const Options &options, ThreadPool &pool)
+{
+    TaskGroup group(pool);
+    Scan scan(options, group);
+    if (!options.manifest.empty())
+    {
+        std::ifstream in(options.manifest);
+        if (!in)
+        {
+            throw std::runtime_error("Failed to open manifest: " + options.manifest);
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            line.erase(0, std::min(line.find_first_not_of(" \t"), line.size()));
+            if (line.rfind("./", 0) == 0)
+            {
+                line.erase(0, 2);
+            }
+            if (!line.empty() && line[0] != '#')
+            {
+                scan.manifest.insert(line);
+            }
+        }
+    }
+
+    group.run([&]()
+              { scan.scan(directory, ""); });
+    group.wait();
+    std::sort(scan.files.begin(), scan.files.end());
+    return std::move(scan.files);
+}
+
+void FileDiscovery::prefetch(const std::vector<std::string> &files, size_t bytes)
+{
+    for (const auto &file : files)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            ::posix_fadvise(fd, 0, static_cast<off_t>(bytes), POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+    }
+}
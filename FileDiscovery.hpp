@@ -0,0 +1,34 @@
+// File: FileDiscovery.hpp
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Input listing for very large directories. Entries are read in bulk with getdents64,
+// whose d_type tells files from directories without a stat per entry (only symlinks
+// and filesystems that leave d_type unset are stat'ed). Subdirectories are scanned in
+// parallel on the caller's thread pool, and each buffer of files found can be
+// prefetched while the listing goes on.
+class FileDiscovery
+{
+public:
+    struct Options
+    {
+        std::vector<std::string> patterns; // Glob patterns (fnmatch) a file name must match one of; empty takes all
+        std::string manifest;              // File of paths relative to the directory, one per line, to take; empty takes all
+        bool recursive = false;            // Descend into subdirectories (symlinked ones are not followed)
+        size_t prefetchBytes = 0;          // Ask the kernel to read ahead this much of each file as it is found
+    };
+
+    // Regular files under directory (symlinks to files included) as "directory/name"
+    // paths, sorted; hidden files and directories are skipped. Throws if the directory
+    // cannot be read. Without a pool the shared one scans.
+    static std::vector<std::string> list(const std::string &directory);
+    static std::vector<std::string> list(const std::string &directory, const Options &options, ThreadPool &pool);
+
+    // Start reading the first bytes of files into the page cache without waiting
+    static void prefetch(const std::vector<std::string> &files, size_t bytes);
+};
@@ -1,4 +1,13 @@
 #include "FileMerger.hpp" // Include the correct header file
+#include "Aggregation.hpp"
+#include "Checkpoint.hpp"
+#include "Compression.hpp"
+#include "FeedSchema.hpp"
+#include "FileDiscovery.hpp"
+#include "LineParser.hpp"
+#include "Metrics.hpp"
+#include "KWayMerge.hpp"
+#include "ThreadPool.hpp"
 #include <fstream>
 #include <iostream>
 #include <filesystem>
@@ -6,154 +15,842 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
-#include <queue>
+#include <string_view>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <exception>
+#include <atomic>
+#include <iterator>
+#include <tuple>
+#include <numeric>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
 
-// FileReader implementation
-FileMerger::FileReader::FileReader(const std::string &symbol, const std::string &filename)
-    : symbol(symbol), file(filename), hasMoreData(true)
+namespace
+{
+    // Trimmed field i of a line split at the given comma positions
+    std::string_view fieldAt(const char *lineBegin, const char *lineEnd,
+                             const char *const *delimiters, size_t delimiterCount, size_t i)
+    {
+        const char *begin = i == 0 ? lineBegin : delimiters[i - 1] + 1;
+        const char *end = i < delimiterCount ? delimiters[i] : lineEnd;
+        return LineParser::trim(std::string_view(begin, end - begin));
+    }
+
+    [[noreturn]] void throwInvalidField(const char *field, std::string_view text)
+    {
+        throw std::runtime_error(std::string("Invalid ") + field + ": " + std::string(text));
+    }
+}
+
+// LineBuffer implementation
+void FileMerger::LineBuffer::open(const std::string &filename, InputMode mode, size_t mapBudget, uint64_t offset,
+                                  Arena *arena)
+{
+    source = InputSource::open(filename, mode, mapBudget, offset, arena);
+}
+
+bool FileMerger::LineBuffer::nextLine(const char *&lineBegin, const char *&lineEnd,
+                                      const char **delimiters, size_t maxDelimiters, size_t &delimiterCount)
 {
-    if (!file.is_open())
+    for (;;)
     {
-        throw std::runtime_error("Failed to open file: " + filename);
+        std::string_view bytes = source->view();
+        const char *newline = LineParser::scanLine(bytes.data(), bytes.data() + bytes.size(),
+                                                   delimiters, maxDelimiters, delimiterCount);
+        if (newline)
+        {
+            lineBegin = bytes.data();
+            lineEnd = newline;
+            source->consume(static_cast<size_t>(newline + 1 - bytes.data()));
+            return true;
+        }
+
+        if (!source->fill())
+        {
+            // Last line without a trailing newline
+            if (bytes.empty())
+            {
+                return false;
+            }
+            lineBegin = bytes.data();
+            lineEnd = bytes.data() + bytes.size();
+            source->consume(bytes.size());
+            return true;
+        }
     }
+}
+
+// FileReader implementation
+FileMerger::FileReader::FileReader(uint32_t symbolId, const std::string &filename,
+                                   InputMode mode, size_t mapBudget, size_t blockRows,
+                                   const TimeRange &range, uint64_t startOffset, Arena *arena)
+    : symbolId(symbolId), block(std::max<size_t>(blockRows, 1), arena), range(range), position(0), endOfData(false),
+      currentEntry(), hasMoreData(true)
+{
+    input.open(filename, mode, mapBudget, startOffset, arena);
+
     // Skip header line
-    std::string header;
-    std::getline(file, header);
-    hasMoreData = readNextEntry();
+    const char *lineBegin, *lineEnd;
+    size_t delimiterCount;
+    if (startOffset == 0 && !input.nextLine(lineBegin, lineEnd, nullptr, 0, delimiterCount))
+    {
+        endOfData = true;
+    }
+
+    hasMoreData = readBlock();
+    if (hasMoreData)
+    {
+        currentEntry = block.entry(0, symbolId);
+    }
 }
 
-bool FileMerger::FileReader::readNextEntry()
+bool FileMerger::FileReader::readBlock()
 {
-    if (!file.is_open() || file.eof())
+    // Rows are split in groups of complete lines from the current view, then each
+    // column of the group is converted in its own tight loop. The columns are those of
+    // TickSchema; this reader keeps them in a columnar block rather than going through
+    // SchemaTraits, so it can filter on timestamps before converting the rest.
+    constexpr size_t kGroupRows = 64;
+    constexpr size_t kColumns = SchemaTraits<TickSchema>::kFields;
+    std::string_view fields[kGroupRows][kColumns];
+    Metrics::Timer timer(Metrics::Histogram::ParseTime);
+
+    block.count = 0;
+    position = 0;
+    bool exhausted = false;
+    while (!endOfData && block.count < block.capacity())
     {
-        hasMoreData = false;
-        return false;
+        std::string_view bytes = input.source->view();
+        const char *p = bytes.data();
+        const char *end = p + bytes.size();
+        const size_t limit = std::min(kGroupRows, block.capacity() - block.count);
+
+        // Pass 1: split complete lines (Timestamp,Price,Size,Exchange,Type)
+        size_t rows = 0;
+        while (rows < limit && p != end)
+        {
+            const char *delimiters[kColumns - 1];
+            size_t delimiterCount;
+            const char *newline = LineParser::scanLine(p, end, delimiters, kColumns - 1, delimiterCount);
+            if (!newline && !exhausted)
+            {
+                break; // Partial line: needs more input
+            }
+            const char *lineEnd = newline ? newline : end;
+            if (delimiterCount < kColumns - 1)
+            {
+                endOfData = true; // Like before, a short line ends the file
+                break;
+            }
+            for (size_t f = 0; f < kColumns; ++f)
+            {
+                fields[rows][f] = fieldAt(p, lineEnd, delimiters, kColumns - 1, f);
+            }
+            ++rows;
+            p = newline ? newline + 1 : end;
+            __builtin_prefetch(p + 256);
+        }
+
+        // Pass 2: convert column by column into the block
+        const size_t base = block.count;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            if (!LineParser::parseTimestamp(fields[i][0], block.timestamps[base + i]))
+            {
+                throwInvalidField("timestamp", fields[i][0]);
+            }
+        }
+
+        // Rows are in time order, so rows before the range are a prefix of the file
+        // and the first row past it ends it; only [first, last) is kept
+        size_t first = 0;
+        size_t last = rows;
+        if (range.bounded())
+        {
+            while (first < rows && block.timestamps[base + first] < range.from)
+            {
+                ++first;
+            }
+            last = first;
+            while (last < rows && block.timestamps[base + last] < range.to)
+            {
+                ++last;
+            }
+            if (last < rows)
+            {
+                endOfData = true;
+            }
+            std::copy(block.timestamps.begin() + base + first, block.timestamps.begin() + base + last,
+                      block.timestamps.begin() + base);
+        }
+        const size_t kept = last - first;
+        const std::string_view(*rowFields)[kColumns] = fields + first;
+
+        for (size_t i = 0; i < kept; ++i)
+        {
+            if (!LineParser::parseFixed(rowFields[i][1], MarketDataEntry::kPriceDigits, block.prices[base + i]))
+            {
+                throwInvalidField("price", rowFields[i][1]);
+            }
+        }
+        for (size_t i = 0; i < kept; ++i)
+        {
+            int64_t size = 0;
+            if (!LineParser::parseInt(rowFields[i][2], size) || size < INT32_MIN || size > INT32_MAX)
+            {
+                throwInvalidField("size", rowFields[i][2]);
+            }
+            block.sizes[base + i] = static_cast<int32_t>(size);
+        }
+        for (size_t i = 0; i < kept; ++i)
+        {
+            block.exchanges[base + i] = ExchangeTable::intern(rowFields[i][3]);
+        }
+        for (size_t i = 0; i < kept; ++i)
+        {
+            if (!parseSide(rowFields[i][4], block.sides[base + i]))
+            {
+                throwInvalidField("type", rowFields[i][4]);
+            }
+        }
+        block.count += kept;
+        input.source->consume(static_cast<size_t>(p - bytes.data()));
+
+        // Out of complete lines in this view: pull in more input
+        if (rows < limit && !endOfData)
+        {
+            if (exhausted)
+            {
+                endOfData = true;
+            }
+            else if (!input.source->fill())
+            {
+                exhausted = true;
+            }
+        }
     }
+    Metrics::add(Metrics::Counter::RowsParsed, block.count);
+    Metrics::record(Metrics::Histogram::BlockRows, block.count);
+    return block.count > 0;
+}
 
-    std::string line;
-    if (std::getline(file, line))
+// Deal input files into leaf batches, by count or balanced by estimated bytes
+std::vector<FileMerger::Batch> FileMerger::planBatches(const std::vector<std::string> &inputFiles,
+                                                      const MergeOptions &options,
+                                                      ThreadPool &pool)
+{
+    const size_t perBatch = std::max<size_t>(options.batchSize, 1);
+    size_t count = (inputFiles.size() + perBatch - 1) / perBatch;
+    std::vector<Batch> batches;
+    if (options.batching == Batching::Count || inputFiles.size() <= 1)
     {
-        std::istringstream iss(line);
-        std::string timestamp, priceStr, sizeStr, exchange, type;
+        for (size_t i = 0; i < inputFiles.size(); i += perBatch)
+        {
+            const size_t end = std::min(inputFiles.size(), i + perBatch);
+            batches.push_back(Batch{std::vector<std::string>(inputFiles.begin() + i, inputFiles.begin() + end), 0});
+        }
+        return batches;
+    }
 
-        if (std::getline(iss, timestamp, ',') &&
-            std::getline(iss, priceStr, ',') &&
-            std::getline(iss, sizeStr, ',') &&
-            std::getline(iss, exchange, ',') &&
-            std::getline(iss, type))
+    // Spare batches let idle workers take over from one that falls behind; past fanIn
+    // they would add a merge level
+    constexpr size_t kBatchesPerWorker = 4;
+    count = std::max(count, std::min({inputFiles.size(), std::max<size_t>(pool.size(), 1) * kBatchesPerWorker,
+                                      options.fanIn}));
+
+    // Sizes come from stat, and from decoding a sample of each compressed file
+    std::vector<uint64_t> bytes(inputFiles.size());
+    constexpr size_t kFilesPerTask = 64;
+    TaskGroup sizes(pool);
+    for (size_t first = 0; first < inputFiles.size(); first += kFilesPerTask)
+    {
+        sizes.run([&, first]()
+                  {
+                      const size_t last = std::min(inputFiles.size(), first + kFilesPerTask);
+                      for (size_t i = first; i < last; ++i)
+                      {
+                          bytes[i] = Codec::estimatedSize(inputFiles[i]);
+                      } });
+    }
+    sizes.wait();
+
+    std::vector<size_t> order(inputFiles.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return bytes[a] > bytes[b]; });
+
+    // Lightest batch on top, the one with fewer files among equals (so files of no size
+    // still spread out); a full batch leaves the heap for good
+    using Load = std::tuple<uint64_t, size_t, size_t>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> lightest;
+    batches.resize(count);
+    for (size_t batch = 0; batch < count; ++batch)
+    {
+        lightest.emplace(0, 0, batch);
+    }
+    for (size_t i : order)
+    {
+        const size_t batch = std::get<2>(lightest.top());
+        lightest.pop();
+        batches[batch].files.push_back(inputFiles[i]);
+        batches[batch].bytes += bytes[i];
+        if (batches[batch].files.size() < perBatch)
         {
-            currentEntry = {
-                symbol,
-                timestamp,
-                std::stod(priceStr),
-                std::stoi(sizeStr),
-                exchange,
-                type};
-            return true;
+            lightest.emplace(batches[batch].bytes, batches[batch].files.size(), batch);
         }
     }
-    hasMoreData = false;
-    return false;
+    for (auto &batch : batches)
+    {
+        std::sort(batch.files.begin(), batch.files.end());
+    }
+    return batches;
 }
 
 // List all files in a directory
 std::vector<std::string> FileMerger::listFiles(const std::string &directory)
 {
-    std::vector<std::string> files;
-    std::filesystem::path dir(directory);
+    return FileDiscovery::list(directory);
+}
+
+namespace
+{
+    // Rows handed to the output sink per write() call
+    constexpr size_t kSinkBatchRows = 1024;
+
+    // Merge the readers into the sink, kSinkBatchRows rows per write() call
+    template <typename Reader>
+    void drainToSink(const std::vector<Reader *> &active, OutputSink &sink)
+    {
+        std::vector<MarketDataEntry> pending;
+        pending.reserve(kSinkBatchRows);
+        kWayMerge(active, [&](const MarketDataEntry &entry)
+                  {
+                      pending.push_back(entry);
+                      if (pending.size() == kSinkBatchRows)
+                      {
+                          sink.write(pending.data(), pending.size());
+                          pending.clear();
+                      } });
+        sink.write(pending.data(), pending.size());
+    }
+
+    void checkMergeInputs(const std::vector<std::string> &inputFiles, const FileMerger::MergeOptions &options)
+    {
+        if (inputFiles.empty())
+        {
+            throw std::runtime_error("No input files provided");
+        }
+        if (options.batchSize == 0 || options.fanIn < 2)
+        {
+            throw std::runtime_error("Merge options require batchSize >= 1 and fanIn >= 2");
+        }
+        if (options.openFileBudget != 0 && options.openFileBudget < 4)
+        {
+            // The output, a task's spill file and two inputs
+            throw std::runtime_error("Merge options require openFileBudget >= 4");
+        }
+    }
+
+    std::string readBytes(const std::string &file, uint64_t offset, uint64_t end)
+    {
+        std::string bytes(end - offset, '\0');
+        std::ifstream in(file, std::ios::binary);
+        if (!in.seekg(static_cast<std::streamoff>(offset)) ||
+            !in.read(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+        {
+            throw std::runtime_error("Failed to read " + file);
+        }
+        return bytes;
+    }
+
+    // Rows in [offset, end) of a tick file, or of merged output (with its Symbol column)
+    // when withSymbol is set. Reading from the start skips the header; blank lines are
+    // skipped and, as in FileReader, a short line ends the data.
+    std::vector<MarketDataEntry> readRows(const std::string &file, uint64_t offset, uint64_t end,
+                                          const SymbolTable &symbols, uint32_t symbolId, bool withSymbol)
+    {
+        constexpr size_t kColumns = SchemaTraits<TickSchema>::kFields;
+        const size_t columns = kColumns + (withSymbol ? 1 : 0);
+        const std::string bytes = readBytes(file, offset, end);
+
+        std::vector<MarketDataEntry> rows;
+        const char *p = bytes.data();
+        const char *stop = p + bytes.size();
+        bool header = offset == 0;
+        while (p != stop)
+        {
+            const char *delimiters[kColumns];
+            size_t delimiterCount;
+            const char *newline = LineParser::scanLine(p, stop, delimiters, columns - 1, delimiterCount);
+            const char *line = p;
+            const char *lineEnd = newline ? newline : stop;
+            p = newline ? newline + 1 : stop;
+            if (header || LineParser::trim(std::string_view(line, static_cast<size_t>(lineEnd - line))).empty())
+            {
+                header = false;
+                continue;
+            }
+            if (delimiterCount < columns - 1)
+            {
+                break;
+            }
+
+            std::string_view fields[kColumns + 1];
+            for (size_t i = 0; i < columns; ++i)
+            {
+                const char *first = i == 0 ? line : delimiters[i - 1] + 1;
+                const char *last = i + 1 < columns ? delimiters[i] : lineEnd;
+                fields[i] = LineParser::trim(std::string_view(first, static_cast<size_t>(last - first)));
+            }
+            MarketDataEntry entry{};
+            SchemaTraits<TickSchema>::parse(withSymbol ? fields + 1 : fields, entry);
+            entry.symbolId = withSymbol ? symbols.id(fields[0]) : symbolId;
+            rows.push_back(entry);
+        }
+        return rows;
+    }
+
+    // Timestamp of the merged-output row starting at position
+    int64_t rowTimestamp(const std::string &bytes, size_t position)
+    {
+        const size_t first = bytes.find(',', position);
+        const size_t last = first == std::string::npos ? first : bytes.find(',', first + 1);
+        int64_t timestamp = 0;
+        if (last == std::string::npos ||
+            !LineParser::parseTimestamp(std::string_view(bytes).substr(first + 1, last - first - 1), timestamp))
+        {
+            throw std::runtime_error("Corrupt output row: " + bytes.substr(position, bytes.find('\n', position) - position));
+        }
+        return timestamp;
+    }
+
+    // Offset of the first merged-output row at or after timestamp. The search runs back
+    // from the end in doubling steps, so it reads about as much as the tail it finds.
+    uint64_t tailOffset(const std::string &outputFile, uint64_t dataStart, uint64_t size, int64_t timestamp)
+    {
+        for (uint64_t step = 64 * 1024;; step *= 2)
+        {
+            const uint64_t start = size - std::min(size - dataStart, step);
+            const std::string bytes = readBytes(outputFile, start, size);
 
-    for (const auto &entry : std::filesystem::directory_iterator(dir))
+            // The chunk's first line is cut off unless the chunk starts at the data
+            size_t position = 0;
+            if (start != dataStart)
+            {
+                position = bytes.find('\n');
+                if (position == std::string::npos)
+                {
+                    continue;
+                }
+                ++position;
+            }
+            if (start != dataStart && (position == bytes.size() || rowTimestamp(bytes, position) >= timestamp))
+            {
+                continue;
+            }
+            while (position < bytes.size())
+            {
+                if (rowTimestamp(bytes, position) >= timestamp)
+                {
+                    return start + position;
+                }
+                const size_t newline = bytes.find('\n', position);
+                if (newline == std::string::npos)
+                {
+                    break;
+                }
+                position = newline + 1;
+            }
+            return size;
+        }
+    }
+
+    // Offset of the output's first row (past its header), and its last row's timestamp
+    // and symbol when it has one
+    uint64_t outputRows(const std::string &outputFile, uint64_t size, Checkpoint &checkpoint)
     {
-        if (entry.is_regular_file())
+        const std::string head = readBytes(outputFile, 0, std::min<uint64_t>(size, 4096));
+        const size_t headerEnd = head.find('\n');
+        if (headerEnd == std::string::npos)
         {
-            // Convert path to string using generic_string() for consistent path separators
-            files.push_back(entry.path().generic_string());
+            throw std::runtime_error("Output has no header: " + outputFile);
         }
+        const uint64_t dataStart = headerEnd + 1;
+        checkpoint.hasLastRow = dataStart < size;
+        if (checkpoint.hasLastRow)
+        {
+            const std::string tail = readBytes(outputFile, size - std::min<uint64_t>(size - dataStart, 4096), size);
+            const size_t newline = tail.size() >= 2 ? tail.rfind('\n', tail.size() - 2) : std::string::npos;
+            const size_t position = newline == std::string::npos ? 0 : newline + 1;
+            checkpoint.lastTimestamp = rowTimestamp(tail, position);
+            checkpoint.lastSymbol = tail.substr(position, tail.find(',', position) - position);
+        }
+        return dataStart;
     }
 
-    // Sort files to ensure consistent ordering
-    std::sort(files.begin(), files.end());
-    return files;
+    // Removes every spill file of a merge when it goes out of scope
+    struct SpillFiles
+    {
+        std::string directory;
+        std::string prefix;
+        std::vector<std::string> paths;
+
+        SpillFiles(const std::string &directory)
+            : directory(directory),
+              prefix("mdf-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()))
+        {
+        }
+
+        ~SpillFiles()
+        {
+            for (const auto &path : paths)
+            {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+            }
+        }
+
+        // Path for the run at (level, index); empty when runs stay in memory
+        std::string next(size_t level, size_t index)
+        {
+            if (directory.empty())
+            {
+                return {};
+            }
+            paths.push_back(std::filesystem::path(directory)
+                                .append(prefix + "-L" + std::to_string(level) + "-" + std::to_string(index) + ".run")
+                                .generic_string());
+            return paths.back();
+        }
+    };
 }
 
-// Process a batch of files
-void FileMerger::processBatch(const std::vector<std::string> &batchFiles,
-                              const std::string &outputFile,
-                              std::mutex &outputMutex)
+// Budgets and counters shared by the tasks of one merge
+struct FileMerger::SpillState
 {
-    // Create file readers for each file
-    std::vector<std::unique_ptr<FileReader>> readers;
-    for (const auto &file : batchFiles)
+    static constexpr size_t kMinClaimBytes = 64 * 1024; // Smallest claim on the memory budget
+
+    const size_t memoryBudget; // 0 is unlimited
+    const size_t fileBudget;   // Input and run files open at once; 0 is unlimited
+    const bool spillAlways;    // Every run goes to disk
+
+    std::atomic<size_t> memoryUsed{0};
+    std::atomic<size_t> spilledRuns{0};
+    std::atomic<uint64_t> spillBytes{0};
+
+    std::mutex fileMutex;
+    std::condition_variable filesReleased;
+    size_t filesOpen = 0;
+    size_t peakFiles = 0;
+
+    // Open-file slots held for the lifetime of a task
+    class FileClaim
+    {
+    public:
+        FileClaim(SpillState &state, size_t count) : state_(state), count_(count) { state_.acquireFiles(count_); }
+        ~FileClaim() { state_.releaseFiles(count_); }
+
+        FileClaim(const FileClaim &) = delete;
+        FileClaim &operator=(const FileClaim &) = delete;
+
+    private:
+        SpillState &state_;
+        size_t count_;
+    };
+
+    SpillState(size_t memoryBudget, size_t fileBudget, bool spillAlways)
+        : memoryBudget(memoryBudget), fileBudget(fileBudget), spillAlways(spillAlways)
     {
-        std::string symbol = std::filesystem::path(file).stem().string();
-        readers.push_back(std::make_unique<FileReader>(symbol, file));
     }
 
-    // Priority queue to merge entries - use greater<> to get ascending order
-    auto compare = [](const FileReader *a, const FileReader *b)
+    bool reserve(size_t bytes)
     {
-        const auto &entry_a = a->currentEntry;
-        const auto &entry_b = b->currentEntry;
+        size_t used = memoryUsed.load(std::memory_order_relaxed);
+        do
+        {
+            if (memoryBudget != 0 && used + bytes > memoryBudget)
+            {
+                return false;
+            }
+        } while (!memoryUsed.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+        return true;
+    }
 
-        if (entry_a.timestamp != entry_b.timestamp)
+    void release(size_t bytes)
+    {
+        memoryUsed.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    // Blocks while other tasks hold the budget; the merge shape keeps every claim within it
+    void acquireFiles(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(fileMutex);
+        if (fileBudget != 0)
         {
-            return entry_a.timestamp < entry_b.timestamp; // Reverse comparison for ascending order
+            if (count > fileBudget)
+            {
+                throw std::logic_error("Merge task needs more files than the open-file budget");
+            }
+            filesReleased.wait(lock, [&]()
+                               { return filesOpen + count <= fileBudget; });
         }
-        return entry_a.symbol < entry_b.symbol; // Reverse comparison for ascending order
-    };
-    std::priority_queue<FileReader *, std::vector<FileReader *>, decltype(compare)> pq(compare);
+        filesOpen += count;
+        peakFiles = std::max(peakFiles, filesOpen);
+    }
 
-    // Initialize priority queue
-    for (auto &reader : readers)
+    void releaseFiles(size_t count)
     {
-        if (reader->hasMoreData)
         {
-            pq.push(reader.get());
+            std::lock_guard<std::mutex> lock(fileMutex);
+            filesOpen -= count;
         }
+        filesReleased.notify_all();
     }
 
-    // Open output file
-    std::ofstream outFile(outputFile, std::ios::app);
-    if (!outFile.is_open())
+    // Merge readers into a run held in memory or spilled to disk. An in-memory run claims
+    // budget as it grows; once a claim is refused, what it holds is written to the spill
+    // file and the rest of the merge streams there.
+    template <typename Reader, typename Allocator>
+    SortedRun collect(const std::vector<Reader *, Allocator> &readers, const std::string &spillFile)
     {
-        throw std::runtime_error("Failed to open output file: " + outputFile);
+        SortedRun run;
+        std::ofstream out;
+        auto spill = [&]()
+        {
+            out.open(spillFile, std::ios::binary | std::ios::trunc);
+            if (!out.is_open())
+            {
+                throw std::runtime_error("Failed to open spill file: " + spillFile);
+            }
+            // Records are spilled raw; they are only read back by this process
+            out.write(reinterpret_cast<const char *>(run.entries.data()),
+                      static_cast<std::streamsize>(run.entries.size() * sizeof(MarketDataEntry)));
+            std::vector<MarketDataEntry>().swap(run.entries);
+            release(run.budgetBytes);
+            run.budgetBytes = 0;
+            run.spillFile = spillFile;
+        };
+
+        if (spillAlways)
+        {
+            spill();
+        }
+        kWayMerge(readers, [&](const MarketDataEntry &entry)
+                  {
+                      if (run.spillFile.empty())
+                      {
+                          // Claims double, so each one covers the vector's next capacity
+                          if (run.entries.size() == run.entries.capacity())
+                          {
+                              const size_t claim = std::max(kMinClaimBytes, run.budgetBytes);
+                              if (reserve(claim))
+                              {
+                                  run.budgetBytes += claim;
+                                  run.entries.reserve(run.budgetBytes / sizeof(MarketDataEntry));
+                              }
+                              else
+                              {
+                                  spill();
+                              }
+                          }
+                          if (run.spillFile.empty())
+                          {
+                              run.entries.push_back(entry);
+                              return;
+                          }
+                      }
+                      out.write(reinterpret_cast<const char *>(&entry), sizeof(entry)); });
+
+        if (!run.spillFile.empty())
+        {
+            out.flush();
+            if (!out)
+            {
+                throw std::runtime_error("Failed to write spill file: " + spillFile);
+            }
+            spillBytes.fetch_add(static_cast<uint64_t>(out.tellp()), std::memory_order_relaxed);
+            spilledRuns.fetch_add(1, std::memory_order_relaxed);
+        }
+        return run;
     }
+};
 
-    // Write header if file is empty
+// RunReader implementation
+FileMerger::RunReader::RunReader(const SortedRun &run, InputMode mode, Arena *arena)
+    : run(&run), position(0), hasMoreData(true)
+{
+    if (!run.spillFile.empty())
     {
-        std::lock_guard<std::mutex> lock(outputMutex);
-        if (outFile.tellp() == 0)
+        input.open(run.spillFile, mode, kDefaultMapBudget, 0, arena);
+    }
+    hasMoreData = readNextEntry();
+}
+
+bool FileMerger::RunReader::readNextEntry()
+{
+    if (run->spillFile.empty())
+    {
+        if (position < run->entries.size())
         {
-            outFile << "Symbol,Timestamp,Price,Size,Exchange,Type\n";
+            currentEntry = run->entries[position++];
+            return true;
         }
+        hasMoreData = false;
+        return false;
     }
 
-    // Merge entries
-    while (!pq.empty())
+    // Spill files hold raw records
+    std::string_view bytes = input.source->view();
+    while (bytes.size() < sizeof(MarketDataEntry))
     {
-        FileReader *reader = pq.top();
-        pq.pop();
+        if (!input.source->fill())
+        {
+            if (!bytes.empty())
+            {
+                throw std::runtime_error("Corrupt spill file: " + run->spillFile);
+            }
+            hasMoreData = false;
+            return false;
+        }
+        bytes = input.source->view();
+    }
+    std::memcpy(&currentEntry, bytes.data(), sizeof(MarketDataEntry));
+    input.source->consume(sizeof(MarketDataEntry));
+    return true;
+}
+
+// PartialReader implementation
+FileMerger::PartialReader::PartialReader(const std::string &filename, const SymbolTable &symbols,
+                                         InputMode mode, size_t mapBudget)
+    : symbols(&symbols), filename(filename), currentEntry(), hasMoreData(true), lastSymbolId(0)
+{
+    input.open(filename, mode, mapBudget);
+
+    // Skip header line
+    const char *lineBegin, *lineEnd;
+    size_t delimiterCount;
+    hasMoreData = input.nextLine(lineBegin, lineEnd, nullptr, 0, delimiterCount) && readNextEntry();
+}
 
-        // Write the current entry
+bool FileMerger::PartialReader::readNextEntry()
+{
+    constexpr size_t kColumns = SchemaTraits<TickSchema>::kFields + 1;
+    const char *delimiters[kColumns - 1];
+    const char *lineBegin, *lineEnd;
+    size_t delimiterCount;
+    do
+    {
+        if (!input.nextLine(lineBegin, lineEnd, delimiters, kColumns - 1, delimiterCount))
         {
-            std::lock_guard<std::mutex> lock(outputMutex);
-            const auto &entry = reader->currentEntry;
-            outFile << entry.symbol << ","
-                    << entry.timestamp << ","
-                    << entry.price << ","
-                    << entry.size << ","
-                    << entry.exchange << ","
-                    << entry.type << "\n";
+            hasMoreData = false;
+            return false;
         }
+    } while (LineParser::trim(std::string_view(lineBegin, static_cast<size_t>(lineEnd - lineBegin))).empty());
+
+    // Partials are this tool's own output, so a short row means a damaged file
+    if (delimiterCount < kColumns - 1)
+    {
+        throw std::runtime_error("Corrupt partial row in " + filename + ": " +
+                                 std::string(lineBegin, static_cast<size_t>(lineEnd - lineBegin)));
+    }
+    std::string_view fields[kColumns];
+    for (size_t i = 0; i < kColumns; ++i)
+    {
+        fields[i] = fieldAt(lineBegin, lineEnd, delimiters, kColumns - 1, i);
+    }
+    SchemaTraits<TickSchema>::parse(fields + 1, currentEntry);
+    if (fields[0] != lastSymbol || lastSymbol.empty())
+    {
+        lastSymbolId = symbols->id(fields[0]);
+        lastSymbol.assign(fields[0]);
+    }
+    currentEntry.symbolId = lastSymbolId;
+    return true;
+}
 
-        // Read next entry and push back to queue if available
-        if (reader->readNextEntry())
+// Merge a batch of files into a sorted run
+FileMerger::SortedRun FileMerger::processBatch(const std::vector<std::string> &batchFiles,
+                                               const std::string &spillFile,
+                                               const MergeOptions &options,
+                                               const SymbolTable &symbols,
+                                               SpillState &state)
+{
+    SpillState::FileClaim files(state, batchFiles.size() + (spillFile.empty() ? 0 : 1));
+    Metrics::Timer timer(Metrics::Histogram::BatchTime);
+    Metrics::add(Metrics::Counter::BatchesMerged);
+
+    // Readers with their columns and read buffers live in this worker's arena and are
+    // released together once the batch is done; after the first few batches the arena's
+    // chunks are warm and building a batch no longer touches the global allocator
+    Arena &arena = Arena::forThisThread();
+    Arena::Scope scope(arena);
+    ArenaVector<ArenaPtr<FileReader>> readers{ArenaAllocator<ArenaPtr<FileReader>>(&arena)};
+    ArenaVector<FileReader *> active{ArenaAllocator<FileReader *>(&arena)};
+    readers.reserve(batchFiles.size());
+    active.reserve(batchFiles.size());
+    for (const auto &file : batchFiles)
+    {
+        // With a time range, the file's index skips files outside it and the rows before it;
+        // compressed files cannot be sought into and are only filtered
+        uint64_t startOffset = 0;
+        if (options.range.bounded() && options.indexStride > 0 && Codec::fromFilename(file) == Compression::None)
         {
-            pq.push(reader);
+            TimeIndex index = TimeIndex::forFile(file, options.indexStride);
+            if (!index.overlaps(options.range))
+            {
+                continue;
+            }
+            startOffset = index.seek(options.range.from);
         }
+
+        uint32_t symbolId = symbols.id(SymbolTable::symbolOf(file));
+        readers.push_back(makeInArena<FileReader>(arena, symbolId, file, options.inputMode, options.mapBudget,
+                                                  options.blockRows, options.range, startOffset, &arena));
+        active.push_back(readers.back().get());
     }
+
+    return state.collect(active, spillFile);
+}
+
+// Merge a group of runs into a single sorted run
+FileMerger::SortedRun FileMerger::mergeRuns(const std::vector<SortedRun> &runs,
+                                            const std::string &spillFile,
+                                            const MergeOptions &options,
+                                            SpillState &state)
+{
+    size_t spilledInputs = 0;
+    for (const auto &run : runs)
+    {
+        spilledInputs += run.spillFile.empty() ? 0 : 1;
+    }
+    SpillState::FileClaim files(state, spilledInputs + (spillFile.empty() ? 0 : 1));
+    Metrics::Timer timer(Metrics::Histogram::NodeTime);
+    Metrics::add(Metrics::Counter::NodesMerged);
+
+    Arena &arena = Arena::forThisThread();
+    Arena::Scope scope(arena);
+    ArenaVector<ArenaPtr<RunReader>> readers{ArenaAllocator<ArenaPtr<RunReader>>(&arena)};
+    ArenaVector<RunReader *> active{ArenaAllocator<RunReader *>(&arena)};
+    readers.reserve(runs.size());
+    active.reserve(runs.size());
+    for (const auto &run : runs)
+    {
+        readers.push_back(makeInArena<RunReader>(arena, run, options.inputMode, &arena));
+        active.push_back(readers.back().get());
+    }
+
+    SortedRun merged = state.collect(active, spillFile);
+    for (const auto &run : runs)
+    {
+        state.release(run.budgetBytes);
+    }
+    return merged;
 }
 
 // Main merge function
@@ -161,33 +858,617 @@ void FileMerger::mergeFiles(const std::vector<std::string> &inputFiles,
                             const std::string &outputFile,
                             size_t batchSize)
 {
-    if (inputFiles.empty())
+    MergeOptions options;
+    options.batchSize = batchSize;
+    mergeFiles(inputFiles, outputFile, options);
+}
+
+// Merge tree: batch workers build sorted runs, intermediate levels combine up to
+// fanIn runs per node in parallel, and a final k-way merge writes the output.
+FileMerger::MergeStats FileMerger::mergeFiles(const std::vector<std::string> &inputFiles,
+                            const std::string &outputFile,
+                            const MergeOptions &options)
+{
+    checkMergeInputs(inputFiles, options);
+    if (options.incremental)
     {
-        throw std::runtime_error("No input files provided");
+        if (!options.aggregators.empty())
+        {
+            throw std::runtime_error("Aggregations need a full merge, not an incremental one");
+        }
+        return mergeIncremental(inputFiles, outputFile, options);
     }
 
-    // Clear output file
-    std::ofstream(outputFile, std::ios::trunc).close();
+    // Open (and truncate) the output up front so a bad path fails before any work
+    std::unique_ptr<OutputSink> sink = OutputSink::open(outputFile, options.outputFormat, options.directOutput);
+    return mergeFiles(inputFiles, *sink, options);
+}
 
-    // Process files in batches
-    std::mutex outputMutex;
-    std::vector<std::thread> threads;
-    std::vector<std::string> currentBatch;
+// With budgets the merge runs externally: batches and fan-in shrink so that every
+// task's files fit the open-file budget, extra levels are added until the final
+// merge can open every run at once, and runs past the memory budget go to scratch.
+FileMerger::MergeStats FileMerger::mergeFiles(const std::vector<std::string> &inputFiles,
+                            OutputSink &sink,
+                            const MergeOptions &options)
+{
+    checkMergeInputs(inputFiles, options);
+    if (options.incremental)
+    {
+        throw std::runtime_error("Incremental merges need an output file to resume");
+    }
+    if (!options.aggregators.empty())
+    {
+        AggregatingSink aggregating(sink, options.aggregators);
+        MergeOptions plain = options;
+        plain.aggregators.clear();
+        return mergeFiles(inputFiles, aggregating, plain);
+    }
 
+    // Files of symbols outside the filter are never opened
+    std::vector<std::string> selected;
+    for (const auto &file : inputFiles)
+    {
+        if (options.symbols.empty() ||
+            std::find(options.symbols.begin(), options.symbols.end(), SymbolTable::symbolOf(file)) != options.symbols.end())
+        {
+            selected.push_back(file);
+        }
+    }
+    if (selected.empty())
+    {
+        throw std::runtime_error("No input files match the symbol filter");
+    }
+
+    // The output stays open throughout; the rest of the file budget is shared by tasks
+    MergeOptions plan = options;
+    const size_t taskFiles = options.openFileBudget != 0 ? options.openFileBudget - 1 : 0;
+    if (taskFiles != 0)
+    {
+        plan.batchSize = std::min(plan.batchSize, taskFiles - 1);
+        plan.fanIn = std::min(plan.fanIn, taskFiles - 1);
+    }
+
+    // A memory budget without a spill directory spills to the system scratch directory
+    std::string spillDirectory = options.spillDirectory;
+    if (spillDirectory.empty() && options.memoryBudget != 0)
+    {
+        spillDirectory = std::filesystem::temp_directory_path().generic_string();
+    }
+    SpillFiles spills(spillDirectory);
+    SpillState state(options.memoryBudget, taskFiles,
+                     !options.spillDirectory.empty() && options.memoryBudget == 0);
+
+    // Symbol ids follow name order, so the merge never compares names
+    std::vector<std::string> names;
+    names.reserve(selected.size());
+    for (const auto &file : selected)
+    {
+        names.push_back(SymbolTable::symbolOf(file));
+    }
+    const SymbolTable symbols(std::move(names));
+
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!options.numa.empty())
+    {
+        ownPool = std::make_unique<ThreadPool>(options.numa, options.threads);
+    }
+    else if (options.threads > 0)
+    {
+        ownPool = std::make_unique<ThreadPool>(options.threads);
+    }
+    ThreadPool &pool = ownPool ? *ownPool : ThreadPool::shared();
+
+    // Leaf level: one sorted run per batch
+    const std::vector<Batch> batches = planBatches(selected, plan, pool);
+
+    // With a NUMA topology, batches are dealt to nodes in contiguous blocks; their runs
+    // are allocated by workers pinned to that node
+    const size_t numaNodes = options.numa.empty() ? 1 : options.numa.size();
+    std::vector<std::vector<size_t>> placement = {std::vector<size_t>(batches.size())};
+    for (size_t i = 0; i < batches.size(); ++i)
+    {
+        placement[0][i] = i * numaNodes / batches.size();
+    }
+
+    // Merge-tree shape, leaves first: intermediate levels combine groups of up to fanIn
+    // runs of one NUMA node until the final merge can take them all, and past maxDepth
+    // while the final merge would not fit the open-file budget. Only the final merge
+    // then reads across nodes.
+    std::vector<std::vector<size_t>> firstInput; // Per level above the leaves: each node's first input
+    size_t crossNodeMerges = 0;
+    while (placement.back().size() > plan.fanIn &&
+           (placement.size() <= plan.maxDepth || (taskFiles != 0 && placement.back().size() > taskFiles)))
+    {
+        const std::vector<size_t> &below = placement.back();
+        std::vector<size_t> first;
+        std::vector<size_t> nodes;
+        auto group = [&](bool byNode)
+        {
+            first.clear();
+            nodes.clear();
+            for (size_t i = 0; i < below.size(); ++i)
+            {
+                if (first.empty() || i - first.back() == plan.fanIn || (byNode && below[i] != below[i - 1]))
+                {
+                    first.push_back(i);
+                    nodes.push_back(below[i]);
+                }
+            }
+        };
+        group(true);
+        if (first.size() == below.size())
+        {
+            // One run per node would never shrink the level: group across nodes instead
+            group(false);
+            for (size_t node = 0; node < first.size(); ++node)
+            {
+                const size_t end = node + 1 < first.size() ? first[node + 1] : below.size();
+                crossNodeMerges += std::any_of(below.begin() + first[node], below.begin() + end, [&](size_t n)
+                                               { return n != nodes[node]; });
+            }
+        }
+        firstInput.push_back(std::move(first));
+        placement.push_back(std::move(nodes));
+    }
+
+    const size_t depth = placement.size();
+    std::vector<std::vector<SortedRun>> levels(depth);
+    std::vector<std::vector<std::string>> spillPaths(depth);
+    std::vector<std::vector<size_t>> parents(depth); // Node of the next level each run feeds
+    std::vector<std::unique_ptr<std::atomic<size_t>[]>> waiting(depth); // Unfinished inputs per node
+    auto inputEnd = [&](size_t level, size_t node)
+    {
+        return node + 1 < placement[level].size() ? firstInput[level - 1][node + 1] : placement[level - 1].size();
+    };
+    for (size_t level = 0; level < depth; ++level)
+    {
+        levels[level].resize(placement[level].size());
+        for (size_t i = 0; i < placement[level].size(); ++i)
+        {
+            spillPaths[level].push_back(spills.next(level, i));
+        }
+        if (level > 0)
+        {
+            waiting[level] = std::make_unique<std::atomic<size_t>[]>(placement[level].size());
+            parents[level - 1].resize(placement[level - 1].size());
+            for (size_t node = 0; node < placement[level].size(); ++node)
+            {
+                const size_t first = firstInput[level - 1][node];
+                waiting[level][node] = inputEnd(level, node) - first;
+                std::fill(parents[level - 1].begin() + first, parents[level - 1].begin() + inputEnd(level, node), node);
+            }
+        }
+    }
+    auto numaNode = [&](size_t level, size_t index)
+    {
+        return options.numa.empty() ? ThreadPool::kAnyNode : placement[level][index];
+    };
+
+    // Every node is a pool task; a node is queued as soon as its last input run
+    // is done, so deeper levels overlap with stragglers instead of waiting per level
+    std::function<void(size_t, size_t)> finished; // Outlives the group, whose tasks call it
+    TaskGroup group(pool);
+
+    finished = [&](size_t level, size_t index)
+    {
+        if (level + 1 == levels.size())
+        {
+            return;
+        }
+        const size_t parent = parents[level][index];
+        if (--waiting[level + 1][parent] > 0 || group.failed())
+        {
+            return;
+        }
+        group.run([&, level, parent]()
+                  {
+                      const size_t first = firstInput[level][parent];
+                      const size_t last = inputEnd(level + 1, parent);
+                      std::vector<SortedRun> inputs(std::make_move_iterator(levels[level].begin() + first),
+                                                    std::make_move_iterator(levels[level].begin() + last));
+                      levels[level + 1][parent] = mergeRuns(inputs, spillPaths[level + 1][parent], plan, state);
+                      finished(level + 1, parent); },
+                  numaNode(level + 1, parent));
+    };
+
+    // Leaves are queued lightest first. A worker runs its newest task first, so each
+    // starts on its heaviest batch, and one that runs dry steals the lightest left
+    // elsewhere: a worker that falls behind ends up with fewer batches.
+    std::vector<size_t> dispatch(batches.size());
+    std::iota(dispatch.begin(), dispatch.end(), 0);
+    std::stable_sort(dispatch.begin(), dispatch.end(), [&](size_t a, size_t b)
+                     { return batches[a].bytes < batches[b].bytes; });
+    for (size_t i : dispatch)
+    {
+        group.run([&, i]()
+                  {
+                      levels[0][i] = processBatch(batches[i].files, spillPaths[0][i], plan, symbols, state);
+                      finished(0, i); },
+                  numaNode(0, i));
+    }
+    group.wait();
+    std::vector<SortedRun> runs = std::move(levels.back());
+
+    // Final k-way merge, handed to the sink in batches
+    sink.begin(symbols);
+
+    size_t spilledRuns = 0;
+    for (const auto &run : runs)
+    {
+        spilledRuns += run.spillFile.empty() ? 0 : 1;
+    }
+    SpillState::FileClaim files(state, spilledRuns);
+    Metrics::Timer timer(Metrics::Histogram::FinalMergeTime);
+
+    std::vector<std::unique_ptr<RunReader>> readers;
+    std::vector<RunReader *> active;
+    for (const auto &run : runs)
+    {
+        readers.push_back(std::make_unique<RunReader>(run, options.inputMode));
+        active.push_back(readers.back().get());
+    }
+    drainToSink(active, sink);
+    sink.finish();
+
+    MergeStats stats;
+    stats.passes = depth + 1;
+    stats.spilledRuns = state.spilledRuns.load();
+    stats.spillBytes = state.spillBytes.load();
+    stats.peakOpenFiles = state.peakFiles;
+    stats.crossNodeMerges = crossNodeMerges;
+    return stats;
+}
+
+// Incremental merge: the checkpoint says how far each input was merged; only the bytes
+// after that are read. Anything the checkpoint cannot vouch for means a full merge.
+FileMerger::MergeStats FileMerger::mergeIncremental(const std::vector<std::string> &inputFiles,
+                                                    const std::string &outputFile,
+                                                    const MergeOptions &options)
+{
+    if (options.outputFormat != OutputFormat::Text || Codec::fromFilename(outputFile) != Compression::None ||
+        options.range.bounded() || !options.symbols.empty())
+    {
+        throw std::runtime_error("Incremental merges write uncompressed text and take no filters");
+    }
+    const std::string manifest = Checkpoint::pathFor(outputFile);
+
+    // Rows appended after these sizes are taken are left for the next run
+    std::vector<uint64_t> sizes;
+    for (const auto &file : inputFiles)
+    {
+        sizes.push_back(std::filesystem::file_size(file));
+    }
+
+    Checkpoint previous;
+    std::error_code missing;
+    const uint64_t outputSize = std::filesystem::file_size(outputFile, missing);
+    bool resume = !missing && previous.load(manifest) && previous.outputSize == outputSize &&
+                  Checkpoint::fingerprint(outputFile, outputSize) == previous.outputFingerprint;
+    const std::unordered_set<std::string> listed(inputFiles.begin(), inputFiles.end());
+    for (const auto &input : previous.inputs)
+    {
+        // A removed input's rows would have to leave the output
+        resume = resume && listed.count(input.path) != 0;
+    }
+    const std::unordered_map<std::string, const Checkpoint::Input *> seenInputs = previous.byPath();
+    std::vector<uint64_t> offsets(inputFiles.size(), 0);
+    for (size_t i = 0; i < inputFiles.size() && resume; ++i)
+    {
+        auto it = seenInputs.find(inputFiles[i]);
+        if (it != seenInputs.end())
+        {
+            const Checkpoint::Input *seen = it->second;
+            offsets[i] = seen->offset;
+            resume = sizes[i] >= seen->offset && Checkpoint::fingerprint(inputFiles[i], seen->offset) == seen->fingerprint;
+        }
+        // Compressed inputs cannot be read from an offset
+        resume = resume && (offsets[i] == sizes[i] || Codec::fromFilename(inputFiles[i]) == Compression::None);
+    }
+
+    Checkpoint next;
     for (size_t i = 0; i < inputFiles.size(); ++i)
     {
-        currentBatch.push_back(inputFiles[i]);
+        next.inputs.push_back(Checkpoint::Input{inputFiles[i], sizes[i], Checkpoint::fingerprint(inputFiles[i], sizes[i])});
+    }
+    auto save = [&]()
+    {
+        next.outputSize = std::filesystem::file_size(outputFile);
+        next.outputFingerprint = Checkpoint::fingerprint(outputFile, next.outputSize);
+        outputRows(outputFile, next.outputSize, next);
+        next.save(manifest);
+    };
+
+    if (!resume)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(manifest, ignored);
+        MergeOptions full = options;
+        full.incremental = false;
+        MergeStats stats = mergeFiles(inputFiles, outputFile, full);
+
+        // An input that grew during the merge may be partly in the output: without a
+        // checkpoint the next run starts over
+        for (size_t i = 0; i < inputFiles.size(); ++i)
+        {
+            if (std::filesystem::file_size(inputFiles[i]) != sizes[i])
+            {
+                return stats;
+            }
+        }
+        save();
+        return stats;
+    }
+
+    std::vector<std::string> names;
+    for (const auto &file : inputFiles)
+    {
+        names.push_back(SymbolTable::symbolOf(file));
+    }
+    const SymbolTable symbols(std::move(names));
+
+    // New rows of each input, and whether any sorts before the output's last row
+    MarketDataEntry last{};
+    last.timestamp = previous.lastTimestamp;
+    last.symbolId = previous.hasLastRow ? symbols.id(previous.lastSymbol) : 0;
+    std::vector<SortedRun> runs;
+    MergeStats stats;
+    stats.update = IncrementalUpdate::Append;
+    int64_t earliest = std::numeric_limits<int64_t>::max();
+    bool late = false;
+    for (size_t i = 0; i < inputFiles.size(); ++i)
+    {
+        if (offsets[i] == sizes[i])
+        {
+            continue;
+        }
+        SortedRun run;
+        run.entries = readRows(inputFiles[i], offsets[i], sizes[i], symbols,
+                               symbols.id(SymbolTable::symbolOf(inputFiles[i])), false);
+        for (const auto &entry : run.entries)
+        {
+            earliest = std::min(earliest, entry.timestamp);
+            late = late || (previous.hasLastRow && entry.key() < last.key());
+        }
+        stats.deltaRows += run.entries.size();
+        runs.push_back(std::move(run));
+    }
+
+    // Late rows: the output from the earliest of them on is merged again with them
+    Checkpoint current;
+    const uint64_t dataStart = outputRows(outputFile, outputSize, current);
+    uint64_t keep = outputSize;
+    if (late)
+    {
+        stats.update = IncrementalUpdate::Tail;
+        keep = tailOffset(outputFile, dataStart, outputSize, earliest);
+        SortedRun tail;
+        tail.entries = readRows(outputFile, keep, outputSize, symbols, 0, true);
+        stats.rewrittenRows = tail.entries.size();
+
+        // Ties go to the first reader: rows already written stay ahead of new rows
+        // with the same key, as they come first in their input file
+        runs.insert(runs.begin(), std::move(tail));
+    }
+
+    if (stats.deltaRows > 0)
+    {
+        std::filesystem::resize_file(outputFile, keep);
+        TextSink sink(outputFile, false, Compression::None, true);
+        sink.begin(symbols);
+
+        std::vector<std::unique_ptr<RunReader>> readers;
+        std::vector<RunReader *> active;
+        for (const auto &run : runs)
+        {
+            readers.push_back(std::make_unique<RunReader>(run));
+            active.push_back(readers.back().get());
+        }
+        drainToSink(active, sink);
+        sink.finish();
+    }
+    stats.passes = 1;
+    save();
+    return stats;
+}
+
+// Shards and partials
+std::string FileMerger::symbolsPathFor(const std::string &partialFile)
+{
+    return partialFile + ".symbols";
+}
+
+std::vector<std::string> FileMerger::shardFiles(const std::vector<std::string> &inputFiles, const Shard &shard)
+{
+    if (shard.count == 0 || shard.index >= shard.count)
+    {
+        throw std::runtime_error("Shard index must be below the shard count");
+    }
+
+    std::unordered_map<std::string, size_t> assigned;
+    if (!shard.manifest.empty())
+    {
+        std::ifstream in(shard.manifest);
+        if (!in)
+        {
+            throw std::runtime_error("Failed to open shard manifest: " + shard.manifest);
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string symbol;
+            size_t index = 0;
+            if (!(fields >> symbol) || symbol[0] == '#')
+            {
+                continue;
+            }
+            if (!(fields >> index) || index >= shard.count)
+            {
+                throw std::runtime_error("Invalid shard manifest line: " + line);
+            }
+            assigned[symbol] = index;
+        }
+    }
+
+    std::vector<std::string> selected;
+    for (const auto &file : inputFiles)
+    {
+        const std::string symbol = SymbolTable::symbolOf(file);
+        auto it = assigned.find(symbol);
+        size_t index = 0;
+        if (it != assigned.end())
+        {
+            index = it->second;
+        }
+        else
+        {
+            // FNV-1a rather than std::hash, which may differ between builds and hosts, then
+            // murmur3's fmix64 so that the low bits the modulo keeps depend on every byte
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : symbol)
+            {
+                hash = (hash ^ c) * 1099511628211ull;
+            }
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ull;
+            hash ^= hash >> 33;
+            index = static_cast<size_t>(hash % shard.count);
+        }
+        if (index == shard.index)
+        {
+            selected.push_back(file);
+        }
+    }
+    return selected;
+}
+
+FileMerger::MergeStats FileMerger::mergeShard(const std::vector<std::string> &inputFiles,
+                                              const std::string &partialFile,
+                                              const Shard &shard,
+                                              const MergeOptions &options)
+{
+    if (options.incremental || options.outputFormat != OutputFormat::Text)
+    {
+        throw std::runtime_error("Shards are merged in full to text partials");
+    }
+
+    const std::vector<std::string> selected = shardFiles(inputFiles, shard);
+    std::vector<std::string> names;
+    for (const auto &file : selected)
+    {
+        const std::string symbol = SymbolTable::symbolOf(file);
+        if (options.symbols.empty() || std::find(options.symbols.begin(), options.symbols.end(), symbol) != options.symbols.end())
+        {
+            names.push_back(symbol);
+        }
+    }
+
+    MergeStats stats;
+    if (names.empty())
+    {
+        std::unique_ptr<OutputSink> sink = OutputSink::open(partialFile, OutputFormat::Text, options.directOutput);
+        SymbolTable none;
+        sink->begin(none);
+        sink->finish();
+    }
+    else
+    {
+        stats = mergeFiles(selected, partialFile, options);
+    }
+
+    // The symbol list goes last, so a partial that has one is complete
+    const SymbolTable symbols(std::move(names));
+    const std::string listFile = symbolsPathFor(partialFile);
+    std::ofstream out(listFile, std::ios::trunc);
+    for (size_t id = 0; id < symbols.size(); ++id)
+    {
+        out << symbols.name(static_cast<uint32_t>(id)) << '\n';
+    }
+    if (!out.flush())
+    {
+        throw std::runtime_error("Failed to write " + listFile);
+    }
+    return stats;
+}
 
-        if (currentBatch.size() >= batchSize || i == inputFiles.size() - 1)
+FileMerger::MergeStats FileMerger::mergePartials(const std::vector<std::string> &partialFiles,
+                                                 const std::string &outputFile,
+                                                 const MergeOptions &options)
+{
+    if (partialFiles.empty())
+    {
+        throw std::runtime_error("No partial files provided");
+    }
+    if (options.incremental)
+    {
+        throw std::runtime_error("Partials are merged in full, not incrementally");
+    }
+
+    // Ids follow name order across every partial, which is the order a single merge of
+    // all the inputs would have given them
+    std::vector<std::string> names;
+    for (const auto &partial : partialFiles)
+    {
+        std::ifstream list(symbolsPathFor(partial));
+        std::string line;
+        if (list)
+        {
+            while (std::getline(list, line))
+            {
+                if (!line.empty())
+                {
+                    names.push_back(line);
+                }
+            }
+            continue;
+        }
+
+        LineBuffer input;
+        input.open(partial, options.inputMode, options.mapBudget);
+        const char *lineBegin, *lineEnd;
+        const char *comma[1];
+        size_t delimiterCount;
+        bool header = true;
+        while (input.nextLine(lineBegin, lineEnd, comma, 1, delimiterCount))
         {
-            threads.emplace_back(processBatch, currentBatch, outputFile, std::ref(outputMutex));
-            currentBatch.clear();
+            if (!header && delimiterCount >= 1)
+            {
+                std::string_view symbol = LineParser::trim(std::string_view(lineBegin, static_cast<size_t>(comma[0] - lineBegin)));
+                if (names.empty() || names.back() != symbol)
+                {
+                    names.emplace_back(symbol);
+                }
+            }
+            header = false;
         }
     }
+    const SymbolTable symbols(std::move(names));
 
-    // Wait for all threads to complete
-    for (auto &thread : threads)
+    std::unique_ptr<OutputSink> output = OutputSink::open(outputFile, options.outputFormat, options.directOutput);
+    std::unique_ptr<AggregatingSink> aggregating;
+    if (!options.aggregators.empty())
     {
-        thread.join();
+        aggregating = std::make_unique<AggregatingSink>(*output, options.aggregators);
     }
-}
\ No newline at end of file
+    OutputSink &sink = aggregating ? static_cast<OutputSink &>(*aggregating) : *output;
+
+    std::vector<std::unique_ptr<PartialReader>> readers;
+    std::vector<PartialReader *> active;
+    for (const auto &partial : partialFiles)
+    {
+        readers.push_back(std::make_unique<PartialReader>(partial, symbols, options.inputMode, options.mapBudget));
+        active.push_back(readers.back().get());
+    }
+
+    Metrics::Timer timer(Metrics::Histogram::FinalMergeTime);
+    sink.begin(symbols);
+    drainToSink(active, sink);
+    sink.finish();
+
+    MergeStats stats;
+    stats.passes = 1;
+    stats.peakOpenFiles = partialFiles.size();
+    return stats;
+}
@@ -1,6 +1,11 @@
 // File: FileMerger.hpp
 #pragma once
 
+#include "InputSource.hpp"
+#include "MarketDataEntry.hpp"
+#include "Numa.hpp"
+#include "OutputSink.hpp"
+#include "TimeIndex.hpp"
 #include <string>
 #include <vector>
 #include <queue>
@@ -8,63 +13,248 @@
 #include <memory>
 #include <fstream>
 #include <thread>
+#include <functional>
 #include <condition_variable>
 
+class Aggregator;
+class ThreadPool;
+
 class FileMerger
 {
 public:
-    // Structure to hold a single market data entry
-    struct MarketDataEntry
+    static constexpr size_t kDefaultMapBudget = 256 * 1024 * 1024;
+    static constexpr size_t kDefaultBlockRows = 1024;
+
+    // Packed market data entry (see MarketDataEntry.hpp)
+    using MarketDataEntry = ::MarketDataEntry;
+
+    // Line access over an input source, parsed in place without per-row allocation
+    struct LineBuffer
     {
-        std::string symbol;
-        std::string timestamp;
-        double price;
-        int size;
-        std::string exchange;
-        std::string type;
-
-        bool operator>(const MarketDataEntry &other) const
-        {
-            if (timestamp != other.timestamp)
-            {
-                return timestamp > other.timestamp;
-            }
-            return symbol > other.symbol;
-        }
+        std::unique_ptr<InputSource> source;
+
+        void open(const std::string &filename, InputMode mode = InputMode::Stream,
+                  size_t mapBudget = kDefaultMapBudget, uint64_t offset = 0, Arena *arena = nullptr);
+
+        // Next line without its newline, with its comma positions found in the same pass.
+        // The line stays valid until the following call.
+        bool nextLine(const char *&lineBegin, const char *&lineEnd,
+                      const char **delimiters, size_t maxDelimiters, size_t &delimiterCount);
+    };
+
+    // Structure to manage a single input file. Rows are parsed a block at a time into
+    // columns, so advancing is an index bump over arrays that are already in cache.
+    // Given an arena, the columns and the read buffer are allocated from it.
+    struct FileReader
+    {
+        uint32_t symbolId;
+        LineBuffer input;
+        EntryBlock block;
+        TimeRange range; // Rows before it are skipped; the first row past it ends the file
+        size_t position;
+        bool endOfData;
+        MarketDataEntry currentEntry;
+        bool hasMoreData;
 
-        bool operator<(const MarketDataEntry &other) const
+        // A nonzero startOffset must be the start of a data line (see TimeIndex::seek)
+        FileReader(uint32_t symbolId, const std::string &filename,
+                   InputMode mode = InputMode::Stream, size_t mapBudget = kDefaultMapBudget,
+                   size_t blockRows = kDefaultBlockRows, const TimeRange &range = TimeRange(),
+                   uint64_t startOffset = 0, Arena *arena = nullptr);
+
+        bool readNextEntry()
         {
-            if (timestamp != other.timestamp)
+            if (++position >= block.count && !readBlock())
             {
-                return timestamp < other.timestamp;
+                hasMoreData = false;
+                return false;
             }
-            return symbol < other.symbol;
+            currentEntry = block.entry(position, symbolId);
+            return true;
         }
+
+        // Parse the next block of rows; false once the file is exhausted
+        bool readBlock();
     };
 
-    // Structure to manage a single input file
-    struct FileReader
+    // Sorted intermediate output of a batch or of a merge-tree node
+    struct SortedRun
+    {
+        std::vector<MarketDataEntry> entries; // In-memory run
+        std::string spillFile;                // On-disk run of raw records when non-empty
+        size_t budgetBytes = 0;               // Share of the memory budget held by entries
+    };
+
+    // Sequential reader over a SortedRun, shaped like FileReader for the k-way merge
+    struct RunReader
+    {
+        const SortedRun *run;
+        LineBuffer input;
+        size_t position;
+        MarketDataEntry currentEntry;
+        bool hasMoreData;
+
+        explicit RunReader(const SortedRun &run, InputMode mode = InputMode::Stream, Arena *arena = nullptr);
+        bool readNextEntry();
+    };
+
+    // How input files are dealt into leaf batches
+    enum class Batching
+    {
+        Count, // Consecutive runs of batchSize files
+        Size   // Balanced by estimated bytes (see planBatches)
+    };
+
+    // Shape of the merge tree built over the batch runs
+    struct MergeOptions
+    {
+        size_t batchSize = 500;     // Input files merged by one leaf worker, at most
+        Batching batching = Batching::Size;
+        size_t fanIn = 16;          // Maximum runs combined by one merge-tree node
+        size_t maxDepth = 1;        // Intermediate levels allowed before the final merge
+        std::string spillDirectory; // Spill intermediate runs here; empty keeps them in memory
+        size_t memoryBudget = 0;    // Bytes of runs kept in memory before the rest spill; 0 is unlimited
+        size_t openFileBudget = 0;  // Files open at once, output included; 0 is unlimited
+        InputMode inputMode = InputMode::Stream;
+        size_t mapBudget = kDefaultMapBudget; // Largest mapping per file before sliding windows
+        size_t blockRows = kDefaultBlockRows; // Rows parsed per reader refill
+        bool directOutput = false;            // Write the output with O_DIRECT where supported
+        OutputFormat outputFormat = OutputFormat::Text;
+        size_t threads = 0;                   // Worker threads; 0 shares a pool sized to the hardware
+        TimeRange range;                      // Only rows in [from, to) are merged
+        std::vector<std::string> symbols;     // Only these symbols' files are read; empty reads all
+        uint32_t indexStride = TimeIndex::kDefaultStride; // Rows per time-index sample; 0 never uses indexes
+        NumaTopology numa;                    // Place batches and merge-tree nodes on these nodes; empty is off
+        bool incremental = false;             // Bring the output up to date from its checkpoint (see mergeFiles)
+        std::vector<std::shared_ptr<Aggregator>> aggregators; // Fed every output row in merge order (Aggregation.hpp)
+    };
+
+    // How an incremental merge brought the output up to date
+    enum class IncrementalUpdate
+    {
+        Full,   // No usable checkpoint, or inputs were rewritten: merged from scratch
+        Append, // New rows all sort after the output's last row and were appended
+        Tail    // Late rows: the output's tail from the earliest of them was merged again
+    };
+
+    // What an external merge did
+    struct MergeStats
     {
-        std::string symbol;
-        std::ifstream file;
+        size_t passes = 0;        // Merges over the data: leaf batches, each intermediate level, the final merge
+        size_t spilledRuns = 0;   // Runs written to scratch files
+        uint64_t spillBytes = 0;  // Bytes written to them
+        size_t peakOpenFiles = 0; // Most input and run files claimed at once
+        size_t crossNodeMerges = 0; // Merge-tree nodes below the final merge reading runs of several NUMA nodes
+        IncrementalUpdate update = IncrementalUpdate::Full;
+        uint64_t deltaRows = 0;     // New input rows an incremental merge read
+        uint64_t rewrittenRows = 0; // Output rows it merged again behind late rows
+    };
+
+    // Sequential reader over merged text output (with its Symbol column), such as a
+    // shard's partial, shaped like FileReader for the k-way merge
+    struct PartialReader
+    {
+        const SymbolTable *symbols;
+        std::string filename;
+        LineBuffer input;
         MarketDataEntry currentEntry;
         bool hasMoreData;
+        std::string lastSymbol; // Consecutive rows of one symbol skip the table lookup
+        uint32_t lastSymbolId;
+
+        PartialReader(const std::string &filename, const SymbolTable &symbols,
+                      InputMode mode = InputMode::Stream, size_t mapBudget = kDefaultMapBudget);
 
-        FileReader(const std::string &symbol, const std::string &filename);
         bool readNextEntry();
     };
 
+    // Input files of one leaf batch, with their estimated decoded bytes (0 when dealt by count)
+    struct Batch
+    {
+        std::vector<std::string> files;
+        uint64_t bytes = 0;
+    };
+
+    // One of several processes splitting a merge between them
+    struct Shard
+    {
+        size_t index = 0;
+        size_t count = 1;
+        std::string manifest; // "SYMBOL SHARD" lines; symbols it does not list go by hash
+    };
+
     // Merge files from input directory to output file
     static void mergeFiles(const std::vector<std::string> &inputFiles,
                            const std::string &outputFile,
                            size_t batchSize = 500);
 
+    // Merge files through a configurable merge tree. An incremental merge reads only
+    // the bytes appended to each input since the output's checkpoint: rows that sort
+    // after the output's last row are appended to it, and earlier rows re-merge the
+    // output from the first of them on. Inputs must only grow between runs, by whole
+    // rows; anything else (a rewritten or removed input, an edited output) falls back
+    // to a full merge. Incremental merges write uncompressed text and take no filters.
+    static MergeStats mergeFiles(const std::vector<std::string> &inputFiles,
+                           const std::string &outputFile,
+                           const MergeOptions &options);
+
+    // Merge files into a caller-provided sink, which is finished on success. Aggregators
+    // see the rows on the final merge's thread as they are handed to the sink.
+    static MergeStats mergeFiles(const std::vector<std::string> &inputFiles,
+                           OutputSink &sink,
+                           const MergeOptions &options);
+
+    // A shard's inputs. A symbol's files go to the shard the manifest names, or else to
+    // fmix64(FNV-1a(symbol)) % count, so every process derives the same split from the same
+    // listing. The mapping is shared between hosts: changing it reshuffles every shard.
+    static std::vector<std::string> shardFiles(const std::vector<std::string> &inputFiles, const Shard &shard);
+
+    // Merge a shard's inputs into a partial: plain merged output plus its symbol list in
+    // symbolsPathFor(partialFile). A shard without inputs gets a partial without rows.
+    static MergeStats mergeShard(const std::vector<std::string> &inputFiles,
+                                 const std::string &partialFile,
+                                 const Shard &shard,
+                                 const MergeOptions &options);
+
+    // K-way merge of partials into the final output, which comes out as a single merge
+    // of all their inputs would write it. A partial without a symbol list is scanned for
+    // its symbols first. Filters and incremental updates are not applied here.
+    static MergeStats mergePartials(const std::vector<std::string> &partialFiles,
+                                    const std::string &outputFile,
+                                    const MergeOptions &options);
+
+    // "<partial>.symbols"
+    static std::string symbolsPathFor(const std::string &partialFile);
+
+    // Leaf batches of a merge on this pool, whose workers also estimate the sizes. By
+    // count, files are cut into consecutive batches of batchSize. By size, there are at
+    // least as many batches, and more (up to fanIn) so that each worker gets a few, and
+    // files are dealt largest first to the lightest batch with room
+    // (longest-processing-time packing).
+    static std::vector<Batch> planBatches(const std::vector<std::string> &inputFiles,
+                                          const MergeOptions &options,
+                                          ThreadPool &pool);
+
     // List all files in a directory
     static std::vector<std::string> listFiles(const std::string &directory);
 
 private:
-    // Process a batch of files
-    static void processBatch(const std::vector<std::string> &batchFiles,
-                             const std::string &outputFile,
-                             std::mutex &outputMutex);
+    struct SpillState;
+
+    static MergeStats mergeIncremental(const std::vector<std::string> &inputFiles,
+                                       const std::string &outputFile,
+                                       const MergeOptions &options);
+
+    // Merge a batch of files into a sorted run
+    static SortedRun processBatch(const std::vector<std::string> &batchFiles,
+                                  const std::string &spillFile,
+                                  const MergeOptions &options,
+                                  const SymbolTable &symbols,
+                                  SpillState &state);
+
+    // Merge a group of runs into a single sorted run
+    static SortedRun mergeRuns(const std::vector<SortedRun> &runs,
+                               const std::string &spillFile,
+                               const MergeOptions &options,
+                               SpillState &state);
 };
@@ -1,12 +1,11 @@
 // File: FileReader.cpp
 #include "FileReader.hpp" // Add this include directive
 #include "Entry.hpp" // ✅ Needed for Entry type
-#include <sstream>
-#include <vector>
-#include <cctype> // For std::isspace
+#include "LineParser.hpp"
+#include <stdexcept>
 
-FileReader::FileReader(const std::string &filepath, const std::string &symbol)
-    : symbol_(symbol), stream_(filepath)
+FileReader::FileReader(const std::string &filepath, uint32_t symbolId)
+    : symbolId_(symbolId), stream_(filepath), currentEntry_(), hasNext_(false)
 {
     std::string header;
     std::getline(stream_, header);
@@ -15,7 +14,7 @@ FileReader::FileReader(const std::string &filepath, const std::string &symbol)
 
 bool FileReader::hasNext() const
 {
-    return !currentEntry_.timestamp.empty();
+    return hasNext_;
 }
 
 Entry FileReader::currentEntry() const
@@ -25,53 +24,27 @@ Entry FileReader::currentEntry() const
 
 void FileReader::advance()
 {
-    std::string line;
-    if (std::getline(stream_, line))
+    // line_ keeps its capacity across rows, so steady-state reads do not allocate
+    hasNext_ = std::getline(stream_, line_) && parseLine(line_, currentEntry_);
+    if (hasNext_)
     {
-        currentEntry_ = parseLine(line);
-        currentEntry_.symbol = symbol_;
-    }
-    else
-    {
-        currentEntry_ = Entry{};
+        currentEntry_.symbolId = symbolId_;
     }
 }
 
-Entry FileReader::parseLine(const std::string &line)
+bool FileReader::parseLine(std::string_view line, Entry &entry)
 {
-    auto parts = split(line, ',');
-    if (parts.size() < 5)
-        return Entry{};
-    Entry entry;
-    entry.timestamp = trim(parts[0]);
-    entry.price = std::stod(trim(parts[1]));
-    entry.size = std::stoi(trim(parts[2]));
-    entry.exchange = trim(parts[3]);
-    entry.type = trim(parts[4]);
-    return entry;
-}
+    std::string_view parts[5];
+    if (LineParser::splitFields(line.data(), line.data() + line.size(), parts, 5) < 5)
+        return false;
 
-std::vector<std::string> FileReader::split(const std::string &s, char delimiter)
-{
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter))
-    {
-        tokens.push_back(token);
-    }
-    return tokens;
+    int64_t size = 0;
+    if (!LineParser::parseTimestamp(parts[0], entry.timestamp) ||
+        !LineParser::parseFixed(parts[1], Entry::kPriceDigits, entry.price) ||
+        !LineParser::parseInt(parts[2], size) ||
+        !parseSide(parts[4], entry.side))
+        throw std::runtime_error("Invalid market data line: " + std::string(line));
+    entry.size = static_cast<int32_t>(size);
+    entry.exchange = ExchangeTable::intern(parts[3]);
+    return true;
 }
-
-std::string FileReader::trim(const std::string &s)
-{
-    auto start = s.begin();
-    while (start != s.end() && std::isspace(*start))
-        start++;
-    auto end = s.end();
-    do
-    {
-        end--;
-    } while (std::distance(start, end) > 0 && std::isspace(*end));
-    return std::string(start, end + 1);
-}
\ No newline at end of file
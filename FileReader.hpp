@@ -1,27 +1,28 @@
 #ifndef FILE_READER_HPP
 #define FILE_READER_HPP
 
+#include <cstdint>
 #include <string>
-#include <vector>
+#include <string_view>
 #include <fstream>
 #include "Entry.hpp"
 
 class FileReader
 {
 public:
-    FileReader(const std::string &filepath, const std::string &symbol);
+    FileReader(const std::string &filepath, uint32_t symbolId);
     bool hasNext() const;
     Entry currentEntry() const;
     void advance();
 
 private:
-    Entry parseLine(const std::string &line);
-    std::vector<std::string> split(const std::string &s, char delimiter);
-    std::string trim(const std::string &s);
+    bool parseLine(std::string_view line, Entry &entry);
 
-    std::string symbol_;
+    uint32_t symbolId_;
     std::ifstream stream_;
+    std::string line_;
     Entry currentEntry_;
+    bool hasNext_;
 };
 
 #endif // FILE_READER_HPP
@@ -0,0 +1,231 @@
+// File: InputSource.cpp
+#include "InputSource.hpp"
+#include "AsyncIo.hpp"
+#include "Compression.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INPUT_SOURCE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Source of a file's bytes as stored
+    std::unique_ptr<InputSource> openRaw(const std::string &filename, InputMode mode, size_t mapBudget,
+                                         uint64_t offset, IoEngine *engine, Arena *arena)
+    {
+#ifdef INPUT_SOURCE_MMAP
+        if (mode == InputMode::Mmap)
+        {
+            return std::make_unique<MappedSource>(filename, mapBudget, offset);
+        }
+        if (mode == InputMode::Async)
+        {
+            return std::make_unique<AsyncSource>(filename, engine ? *engine : IoEngine::forThisThread(),
+                                                 64 * 1024, 2, offset);
+        }
+#else
+        (void)mode;
+        (void)mapBudget;
+        (void)engine;
+#endif
+        return std::make_unique<StreamSource>(filename, 16 * 1024, offset, arena);
+    }
+}
+
+std::unique_ptr<InputSource> InputSource::open(const std::string &filename, InputMode mode, size_t mapBudget,
+                                               uint64_t offset, Arena *arena)
+{
+    Compression compression = Codec::fromFilename(filename);
+    if (compression == Compression::None)
+    {
+        return openRaw(filename, mode, mapBudget, offset, nullptr, arena);
+    }
+
+    // Compressed files are decoded over a source of the compressed bytes. That source is
+    // driven from codec pool threads, so async reads go through the shared pread pool
+    // rather than the opening thread's io_uring, and its buffers stay off the caller's arena.
+    if (offset > 0)
+    {
+        throw std::runtime_error("Cannot seek into compressed file: " + filename);
+    }
+    std::unique_ptr<InputSource> raw = openRaw(filename, mode, mapBudget, 0, &ThreadPoolEngine::shared(), nullptr);
+    return std::make_unique<DecompressingSource>(std::move(raw), compression, filename);
+}
+
+// StreamSource implementation
+StreamSource::StreamSource(const std::string &filename, size_t capacity, uint64_t offset, Arena *arena)
+    : data_(capacity, ArenaAllocator<char>(arena)), begin_(0), end_(0)
+{
+    // Reads land directly in our buffer instead of going through the filebuf's own
+    file_.rdbuf()->pubsetbuf(nullptr, 0);
+    file_.open(filename, std::ios::binary);
+    if (!file_.is_open())
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    if (offset > 0)
+    {
+        file_.seekg(static_cast<std::streamoff>(offset));
+    }
+}
+
+std::string_view StreamSource::view() const
+{
+    return std::string_view(data_.data() + begin_, end_ - begin_);
+}
+
+void StreamSource::consume(size_t count)
+{
+    begin_ += count;
+}
+
+bool StreamSource::fill()
+{
+    // Move the partial line to the front, growing the buffer for oversized lines
+    if (begin_ > 0)
+    {
+        std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == data_.size())
+    {
+        data_.resize(data_.size() * 2);
+    }
+
+    file_.read(data_.data() + end_, static_cast<std::streamsize>(data_.size() - end_));
+    std::streamsize count = file_.gcount();
+    end_ += static_cast<size_t>(count);
+    Metrics::add(Metrics::Counter::BytesRead, static_cast<uint64_t>(count));
+    Metrics::record(Metrics::Histogram::ReadBytes, static_cast<uint64_t>(count));
+    return count > 0;
+}
+
+#ifdef INPUT_SOURCE_MMAP
+// MappedSource implementation
+MappedSource::MappedSource(const std::string &filename, size_t mapBudget, uint64_t offset)
+    : fd_(-1), fileSize_(0), windowSize_(0), windowOffset_(0), windowLength_(0), position_(0), mapping_(nullptr)
+{
+    fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    struct stat info;
+    if (::fstat(fd_, &info) != 0)
+    {
+        ::close(fd_);
+        throw std::runtime_error("Failed to stat file: " + filename);
+    }
+    fileSize_ = static_cast<size_t>(info.st_size);
+    position_ = std::min<size_t>(offset, fileSize_);
+
+    // Whole-file mapping when it fits the budget, otherwise page-aligned windows
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    windowSize_ = fileSize_ <= mapBudget ? fileSize_ : std::max(mapBudget / pageSize, size_t(1)) * pageSize;
+
+    try
+    {
+        mapWindow(position_);
+    }
+    catch (...)
+    {
+        ::close(fd_);
+        throw;
+    }
+
+    // A whole-file mapping outlives its descriptor, which keeps open-file counts down
+    if (!windowed())
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+MappedSource::~MappedSource()
+{
+    unmap();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void MappedSource::mapWindow(size_t offset)
+{
+    unmap();
+
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    windowOffset_ = offset - offset % pageSize;
+    windowLength_ = std::min(windowSize_, fileSize_ - windowOffset_);
+    if (windowLength_ == 0)
+    {
+        return;
+    }
+
+    void *address = ::mmap(nullptr, windowLength_, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(windowOffset_));
+    if (address == MAP_FAILED)
+    {
+        windowLength_ = 0;
+        throw std::runtime_error("Failed to map input file");
+    }
+    mapping_ = static_cast<char *>(address);
+    Metrics::add(Metrics::Counter::BytesRead, windowLength_);
+    Metrics::record(Metrics::Histogram::ReadBytes, windowLength_);
+
+    // Readahead hints only; failures are harmless
+    ::madvise(mapping_, windowLength_, MADV_SEQUENTIAL);
+    ::madvise(mapping_, windowLength_, MADV_WILLNEED);
+}
+
+void MappedSource::unmap()
+{
+    if (mapping_)
+    {
+        ::munmap(mapping_, windowLength_);
+        mapping_ = nullptr;
+    }
+}
+
+std::string_view MappedSource::view() const
+{
+    if (!mapping_)
+    {
+        return {};
+    }
+    return std::string_view(mapping_ + (position_ - windowOffset_), windowOffset_ + windowLength_ - position_);
+}
+
+void MappedSource::consume(size_t count)
+{
+    position_ += count;
+}
+
+bool MappedSource::fill()
+{
+    const size_t windowEnd = windowOffset_ + windowLength_;
+    if (windowEnd >= fileSize_)
+    {
+        return false;
+    }
+
+    // Slide the window to the first unconsumed byte; a line longer than the
+    // window doubles it so the next mapping reaches past the current end
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    while (position_ - position_ % pageSize + windowSize_ <= windowEnd)
+    {
+        windowSize_ *= 2;
+    }
+    mapWindow(position_);
+    return true;
+}
+#endif
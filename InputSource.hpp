@@ -0,0 +1,90 @@
+// File: InputSource.hpp
+#pragma once
+
+#include "Arena.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// How input files are brought into memory
+enum class InputMode
+{
+    Stream, // Unbuffered ifstream reads into a reader-owned buffer
+    Mmap,   // Memory-mapped with sequential readahead hints
+    Async   // Double-buffered reads ahead of the parser (io_uring or pread threads)
+};
+
+// Contiguous bytes of an input file, consumed front to back by the line parser
+class InputSource
+{
+public:
+    virtual ~InputSource() = default;
+
+    // Unconsumed bytes currently available
+    virtual std::string_view view() const = 0;
+
+    // Drop bytes from the front of view()
+    virtual void consume(size_t count) = 0;
+
+    // Make more bytes available after view(), keeping the unconsumed ones contiguous.
+    // Returns false at end of file.
+    virtual bool fill() = 0;
+
+    // Open a file in the given mode, positioned at offset; mmap falls back to streaming
+    // where unsupported. Read buffers come from the arena when one is given.
+    static std::unique_ptr<InputSource> open(const std::string &filename, InputMode mode,
+                                             size_t mapBudget = 256 * 1024 * 1024, uint64_t offset = 0,
+                                             Arena *arena = nullptr);
+};
+
+// Reads through an unbuffered ifstream into an owned buffer
+class StreamSource : public InputSource
+{
+public:
+    explicit StreamSource(const std::string &filename, size_t capacity = 16 * 1024, uint64_t offset = 0,
+                          Arena *arena = nullptr);
+
+    std::string_view view() const override;
+    void consume(size_t count) override;
+    bool fill() override;
+
+private:
+    std::ifstream file_;
+    ArenaVector<char> data_;
+    size_t begin_;
+    size_t end_;
+};
+
+// Maps the file (or a sliding window of it when larger than the budget) read-only
+class MappedSource : public InputSource
+{
+public:
+    MappedSource(const std::string &filename, size_t mapBudget, uint64_t offset = 0);
+    ~MappedSource() override;
+
+    MappedSource(const MappedSource &) = delete;
+    MappedSource &operator=(const MappedSource &) = delete;
+
+    std::string_view view() const override;
+    void consume(size_t count) override;
+    bool fill() override;
+
+    // Whether the file exceeded the budget and is mapped window by window
+    bool windowed() const { return windowSize_ < fileSize_; }
+
+private:
+    void mapWindow(size_t offset);
+    void unmap();
+
+    int fd_;
+    size_t fileSize_;
+    size_t windowSize_;
+    size_t windowOffset_; // File offset of the mapping
+    size_t windowLength_; // Bytes mapped
+    size_t position_;     // File offset of the first unconsumed byte
+    char *mapping_;
+};
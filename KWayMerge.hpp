@@ -0,0 +1,87 @@
+// File: KWayMerge.hpp
+#pragma once
+
+#include "LoserTree.hpp"
+#include "Metrics.hpp"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Merge key of a record that carries its own key()
+struct RecordKey
+{
+    template <typename Record>
+    auto operator()(const Record &record) const
+    {
+        return record.key();
+    }
+};
+
+// K-way merge of readers exposing currentEntry/hasMoreData/readNextEntry() through a
+// loser tree over keyOf(currentEntry); emit is called with every record in key order.
+// Rows and heap operations are counted locally and reported to Metrics once.
+template <typename Reader, typename Allocator, typename KeyOf, typename Emit>
+void kWayMerge(const std::vector<Reader *, Allocator> &readers, KeyOf keyOf, Emit &&emit)
+{
+    using Key = std::decay_t<decltype(keyOf(readers[0]->currentEntry))>;
+    LoserTree<Key> tree(readers.size());
+    for (size_t i = 0; i < readers.size(); ++i)
+    {
+        if (readers[i]->hasMoreData)
+        {
+            tree.set(i, keyOf(readers[i]->currentEntry));
+        }
+    }
+    tree.build();
+
+    const size_t none = readers.size();
+    size_t lastWinner = none;
+    uint64_t rows = 0;
+    uint64_t operations = 1;
+    while (!tree.empty())
+    {
+        size_t winner = tree.winner();
+        Reader *reader = readers[winner];
+        emit(reader->currentEntry);
+        ++rows;
+        bool more = reader->readNextEntry();
+
+        // A reader that wins twice in a row is likely mid-burst: keep draining it
+        // while it still beats the runner-up, without replaying the tree
+        if (more && winner == lastWinner)
+        {
+            size_t runnerUp = none;
+            bool contested = tree.runnerUp(runnerUp);
+            while (more && (!contested || tree.beats(keyOf(reader->currentEntry), runnerUp)))
+            {
+                emit(reader->currentEntry);
+                ++rows;
+                more = reader->readNextEntry();
+            }
+        }
+
+        ++operations;
+
+        if (more)
+        {
+            tree.replaceWinner(keyOf(reader->currentEntry));
+            lastWinner = winner;
+        }
+        else
+        {
+            tree.removeWinner();
+            lastWinner = none;
+        }
+    }
+
+    Metrics::add(Metrics::Counter::RowsMerged, rows);
+    Metrics::add(Metrics::Counter::HeapOperations, operations);
+    Metrics::record(Metrics::Histogram::MergeHeapOps, operations);
+}
+
+template <typename Reader, typename Allocator, typename Emit>
+void kWayMerge(const std::vector<Reader *, Allocator> &readers, Emit &&emit)
+{
+    kWayMerge(readers, RecordKey(), std::forward<Emit>(emit));
+}
@@ -0,0 +1,419 @@
+// File: LineParser.cpp
+#include "LineParser.hpp"
+#include <atomic>
+#include <charconv>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINE_PARSER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using ScanFn = const char *(*)(const char *, const char *, const char **, size_t, size_t &);
+
+    inline void recordDelimiter(const char *position, const char **delimiters, size_t maxDelimiters, size_t &count)
+    {
+        if (count < maxDelimiters)
+        {
+            delimiters[count] = position;
+        }
+        ++count;
+    }
+
+    // Scalar scan continuing from an existing delimiter count
+    const char *scanTail(const char *p, const char *end, const char **delimiters, size_t maxDelimiters, size_t &count)
+    {
+        for (; p < end; ++p)
+        {
+            if (*p == '\n')
+            {
+                return p;
+            }
+            if (*p == ',')
+            {
+                recordDelimiter(p, delimiters, maxDelimiters, count);
+            }
+        }
+        return nullptr;
+    }
+
+    const char *scanScalar(const char *begin, const char *end, const char **delimiters, size_t maxDelimiters, size_t &count)
+    {
+        count = 0;
+        return scanTail(begin, end, delimiters, maxDelimiters, count);
+    }
+
+#ifdef LINE_PARSER_X86
+    // Record the commas of one block that precede its first newline; returns that newline
+    inline const char *consumeBlock(const char *base, uint32_t commaMask, uint32_t newlineMask,
+                                    const char **delimiters, size_t maxDelimiters, size_t &count)
+    {
+        if (newlineMask != 0)
+        {
+            unsigned newline = __builtin_ctz(newlineMask);
+            commaMask &= (1u << newline) - 1;
+        }
+        while (commaMask != 0)
+        {
+            recordDelimiter(base + __builtin_ctz(commaMask), delimiters, maxDelimiters, count);
+            commaMask &= commaMask - 1;
+        }
+        return newlineMask != 0 ? base + __builtin_ctz(newlineMask) : nullptr;
+    }
+
+    __attribute__((target("sse2"))) const char *scanSse2(const char *begin, const char *end, const char **delimiters,
+                                                         size_t maxDelimiters, size_t &count)
+    {
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const char *p = begin;
+        count = 0;
+
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            uint32_t commaMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma)));
+            uint32_t newlineMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+            if (const char *hit = consumeBlock(p, commaMask, newlineMask, delimiters, maxDelimiters, count))
+            {
+                return hit;
+            }
+        }
+        return scanTail(p, end, delimiters, maxDelimiters, count);
+    }
+
+    __attribute__((target("avx2"))) const char *scanAvx2(const char *begin, const char *end, const char **delimiters,
+                                                         size_t maxDelimiters, size_t &count)
+    {
+        const __m256i comma = _mm256_set1_epi8(',');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const char *p = begin;
+        count = 0;
+
+        for (; end - p >= 32; p += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            uint32_t commaMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, comma)));
+            uint32_t newlineMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+            if (const char *hit = consumeBlock(p, commaMask, newlineMask, delimiters, maxDelimiters, count))
+            {
+                return hit;
+            }
+        }
+        return scanTail(p, end, delimiters, maxDelimiters, count);
+    }
+#endif
+
+    bool isaSupported(LineParser::Isa isa)
+    {
+        switch (isa)
+        {
+        case LineParser::Isa::Scalar:
+            return true;
+#ifdef LINE_PARSER_X86
+        case LineParser::Isa::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case LineParser::Isa::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    ScanFn scanFor(LineParser::Isa isa)
+    {
+        switch (isa)
+        {
+#ifdef LINE_PARSER_X86
+        case LineParser::Isa::AVX2:
+            return scanAvx2;
+        case LineParser::Isa::SSE2:
+            return scanSse2;
+#endif
+        default:
+            return scanScalar;
+        }
+    }
+
+    LineParser::Isa detectIsa()
+    {
+        if (isaSupported(LineParser::Isa::AVX2))
+        {
+            return LineParser::Isa::AVX2;
+        }
+        if (isaSupported(LineParser::Isa::SSE2))
+        {
+            return LineParser::Isa::SSE2;
+        }
+        return LineParser::Isa::Scalar;
+    }
+
+    std::atomic<LineParser::Isa> g_isa{detectIsa()};
+    std::atomic<ScanFn> g_scan{scanFor(g_isa.load())};
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const double kPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+}
+
+const char *LineParser::scanLine(const char *begin, const char *end,
+                                 const char **delimiters, size_t maxDelimiters,
+                                 size_t &delimiterCount)
+{
+    return g_scan.load(std::memory_order_relaxed)(begin, end, delimiters, maxDelimiters, delimiterCount);
+}
+
+size_t LineParser::splitFields(const char *begin, const char *end,
+                               std::string_view *fields, size_t maxFields)
+{
+    if (maxFields == 0)
+    {
+        return 0;
+    }
+
+    // The last field takes the remainder of the line, like getline did
+    const char *delimiters[16];
+    size_t maxDelimiters = maxFields - 1 < 16 ? maxFields - 1 : 16;
+    size_t delimiterCount = 0;
+    scanLine(begin, end, delimiters, maxDelimiters, delimiterCount);
+
+    size_t count = delimiterCount < maxDelimiters ? delimiterCount : maxDelimiters;
+    const char *fieldBegin = begin;
+    for (size_t i = 0; i < count; ++i)
+    {
+        fields[i] = trim(std::string_view(fieldBegin, delimiters[i] - fieldBegin));
+        fieldBegin = delimiters[i] + 1;
+    }
+    fields[count] = trim(std::string_view(fieldBegin, end - fieldBegin));
+    return count + 1;
+}
+
+std::string_view LineParser::trim(std::string_view text)
+{
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && isBlank(text[begin]))
+    {
+        ++begin;
+    }
+    while (end > begin && isBlank(text[end - 1]))
+    {
+        --end;
+    }
+    return text.substr(begin, end - begin);
+}
+
+bool LineParser::parseDecimal(std::string_view text, int64_t &mantissa, int &fractionDigits)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t value = 0;
+    int digits = 0;
+    int fraction = -1;
+    for (; p < end; ++p)
+    {
+        char c = *p;
+        if (c >= '0' && c <= '9')
+        {
+            // 18 digits always fit in an int64
+            if (++digits > 18)
+            {
+                return false;
+            }
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+            if (fraction >= 0)
+            {
+                ++fraction;
+            }
+        }
+        else if (c == '.' && fraction < 0)
+        {
+            fraction = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (digits == 0)
+    {
+        return false;
+    }
+    mantissa = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    fractionDigits = fraction < 0 ? 0 : fraction;
+    return true;
+}
+
+bool LineParser::parsePrice(std::string_view text, double &value)
+{
+    int64_t mantissa = 0;
+    int fractionDigits = 0;
+    if (parseDecimal(text, mantissa, fractionDigits))
+    {
+        // Both operands are exact, so the quotient is the correctly rounded price
+        const int64_t exactLimit = int64_t(1) << 53;
+        if (mantissa < exactLimit && mantissa > -exactLimit)
+        {
+            value = static_cast<double>(mantissa) / kPowersOfTen[fractionDigits];
+            return true;
+        }
+    }
+
+    // Long or exotic inputs (exponents) take the slow path
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+    if (begin < end && *begin == '+')
+    {
+        // from_chars takes its own '-', which must not follow a '+'
+        if (++begin < end && *begin == '-')
+        {
+            return false;
+        }
+    }
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end && begin != end;
+}
+
+bool LineParser::parseFixed(std::string_view text, int digits, int64_t &value)
+{
+    int64_t mantissa = 0;
+    int fractionDigits = 0;
+    if (!parseDecimal(text, mantissa, fractionDigits) || fractionDigits > digits)
+    {
+        return false;
+    }
+    for (int i = fractionDigits; i < digits; ++i)
+    {
+        if (mantissa > std::numeric_limits<int64_t>::max() / 10 || mantissa < std::numeric_limits<int64_t>::min() / 10)
+        {
+            return false;
+        }
+        mantissa *= 10;
+    }
+    value = mantissa;
+    return true;
+}
+
+bool LineParser::parseInt(std::string_view text, int64_t &value)
+{
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+    if (begin < end && *begin == '+')
+    {
+        // from_chars takes its own '-', which must not follow a '+'
+        if (++begin < end && *begin == '-')
+        {
+            return false;
+        }
+    }
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end && begin != end;
+}
+
+bool LineParser::parseTimestamp(std::string_view text, int64_t &nanos)
+{
+    // Fixed layout: YYYY-MM-DD HH:MM:SS, then an optional fraction of up to 9 digits
+    if (text.size() < 19 || text[4] != '-' || text[7] != '-' || (text[10] != ' ' && text[10] != 'T') ||
+        text[13] != ':' || text[16] != ':')
+    {
+        return false;
+    }
+
+    auto number = [&text](size_t position, size_t length, int &value)
+    {
+        value = 0;
+        for (size_t i = position; i < position + length; ++i)
+        {
+            if (text[i] < '0' || text[i] > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+
+    int year, month, day, hour, minute, second;
+    if (!number(0, 4, year) || !number(5, 2, month) || !number(8, 2, day) ||
+        !number(11, 2, hour) || !number(14, 2, minute) || !number(17, 2, second) ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60 ||
+        year < 1678 || year > 2261) // Range of int64 nanoseconds
+    {
+        return false;
+    }
+
+    int64_t fraction = 0;
+    if (text.size() > 19)
+    {
+        size_t fractionDigits = text.size() - 20;
+        if (text[19] != '.' || fractionDigits == 0 || fractionDigits > 9)
+        {
+            return false;
+        }
+        int digits = 0;
+        if (!number(20, fractionDigits, digits))
+        {
+            return false;
+        }
+        fraction = digits;
+        for (size_t i = fractionDigits; i < 9; ++i)
+        {
+            fraction *= 10;
+        }
+    }
+
+    // Days from 1970-01-01 for a proleptic Gregorian date (Hinnant's days_from_civil)
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+
+    nanos = ((days * 24 + hour) * 60 + minute) * 60 + second;
+    nanos = nanos * 1000000000 + fraction;
+    return true;
+}
+
+LineParser::Isa LineParser::activeIsa()
+{
+    return g_isa.load(std::memory_order_relaxed);
+}
+
+void LineParser::forceIsa(Isa isa)
+{
+    if (!isaSupported(isa))
+    {
+        isa = detectIsa();
+    }
+    g_isa.store(isa, std::memory_order_relaxed);
+    g_scan.store(scanFor(isa), std::memory_order_relaxed);
+}
+
+const char *LineParser::isaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::AVX2:
+        return "avx2";
+    case Isa::SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
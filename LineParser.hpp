@@ -0,0 +1,57 @@
+// File: LineParser.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Allocation-free parsing of delimited market data lines straight from a byte buffer
+class LineParser
+{
+public:
+    // Instruction set used by scanLine
+    enum class Isa
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Scan [begin, end) for ',' and '\n' in bulk. Comma positions before the newline are
+    // stored in delimiters (up to maxDelimiters, further ones are only counted). Returns the
+    // newline position, or nullptr when the buffer ends before a newline.
+    static const char *scanLine(const char *begin, const char *end,
+                                const char **delimiters, size_t maxDelimiters,
+                                size_t &delimiterCount);
+
+    // Split one line (without its newline) into trimmed fields; returns the field count
+    static size_t splitFields(const char *begin, const char *end,
+                              std::string_view *fields, size_t maxFields);
+
+    // Strip leading and trailing blanks (space, tab, CR)
+    static std::string_view trim(std::string_view text);
+
+    // Parse a signed decimal as mantissa * 10^-fractionDigits without going through strtod
+    static bool parseDecimal(std::string_view text, int64_t &mantissa, int &fractionDigits);
+
+    // Parse a decimal price; exact for up to 15 significant digits
+    static bool parsePrice(std::string_view text, double &value);
+
+    // Parse a decimal into fixed point with the given number of decimals; rejects
+    // inputs with more decimals than that rather than rounding them
+    static bool parseFixed(std::string_view text, int digits, int64_t &value);
+
+    // Parse a signed integer
+    static bool parseInt(std::string_view text, int64_t &value);
+
+    // Parse "YYYY-MM-DD HH:MM:SS[.fffffffff]" (UTC) into nanoseconds since the Unix epoch
+    static bool parseTimestamp(std::string_view text, int64_t &nanos);
+
+    // Active implementation, picked from the CPU at startup
+    static Isa activeIsa();
+
+    // Override the implementation (benchmarks and tests); falls back if unsupported
+    static void forceIsa(Isa isa);
+
+    static const char *isaName(Isa isa);
+};
@@ -0,0 +1,389 @@
+// File: LiveMerger.cpp
+#include "LiveMerger.hpp"
+#include "LineParser.hpp"
+#include "LoserTree.hpp"
+#include "TextFormat.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#define LIVE_MERGER_INOTIFY 1
+#include <sys/inotify.h>
+#endif
+
+namespace
+{
+    MarketDataEntry::Key keyOf(int64_t timestamp, uint32_t symbolId)
+    {
+        MarketDataEntry entry{};
+        entry.timestamp = timestamp;
+        entry.symbolId = symbolId;
+        return entry.key();
+    }
+
+    [[noreturn]] void throwInvalidField(const char *field, std::string_view text)
+    {
+        throw std::runtime_error(std::string("Invalid ") + field + ": " + std::string(text));
+    }
+}
+
+LiveMerger::LiveMerger(const std::string &directory, const std::string &outputFile, const Options &options)
+    : directory_(directory), outputPath_(outputFile), options_(options), output_(outputFile),
+      newest_(INT64_MIN), emittedAny_(false), lastTimestamp_(0), lastTail_(nullptr),
+      emitted_(0), late_(0), closed_(false)
+{
+    if (!std::filesystem::is_directory(directory))
+    {
+        throw std::runtime_error("Directory does not exist: " + directory);
+    }
+    output_.buffer() += "Symbol,Timestamp,Price,Size,Exchange,Type\n";
+}
+
+LiveMerger::~LiveMerger()
+{
+    for (auto &entry : tails_)
+    {
+        if (entry.second->fd >= 0)
+        {
+            ::close(entry.second->fd);
+        }
+    }
+}
+
+size_t LiveMerger::poll()
+{
+    return step(true);
+}
+
+size_t LiveMerger::step(bool fullScan)
+{
+    if (fullScan)
+    {
+        scanDirectory();
+        for (auto &entry : tails_)
+        {
+            readTail(*entry.second);
+        }
+    }
+    else
+    {
+        for (const auto &name : changed_)
+        {
+            const std::string path = std::filesystem::path(directory_).append(name).generic_string();
+            auto it = tails_.find(SymbolTable::symbolOf(path));
+            if (it != tails_.end())
+            {
+                readTail(*it->second);
+            }
+            else if (name[0] != '.' && std::filesystem::is_regular_file(path))
+            {
+                std::error_code ec;
+                if (!std::filesystem::equivalent(path, outputPath_, ec))
+                {
+                    readTail(addTail(path));
+                }
+            }
+        }
+    }
+    changed_.clear();
+    return release(false);
+}
+
+void LiveMerger::run(const std::atomic<bool> &stop)
+{
+    int notify = -1;
+#ifdef LIVE_MERGER_INOTIFY
+    notify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify >= 0 &&
+        ::inotify_add_watch(notify, directory_.c_str(), IN_CREATE | IN_MODIFY | IN_MOVED_TO | IN_CLOSE_WRITE) < 0)
+    {
+        ::close(notify);
+        notify = -1;
+    }
+#endif
+
+    // Without inotify every tick rescans the directory
+    bool fullScan = true;
+    while (!stop.load())
+    {
+        step(fullScan);
+        fullScan = notify < 0;
+
+        if (notify < 0)
+        {
+            std::this_thread::sleep_for(options_.pollInterval);
+            continue;
+        }
+#ifdef LIVE_MERGER_INOTIFY
+        pollfd wait{notify, POLLIN, 0};
+        ::poll(&wait, 1, static_cast<int>(options_.pollInterval.count()));
+
+        alignas(inotify_event) char events[16 * 1024];
+        ssize_t length;
+        while ((length = ::read(notify, events, sizeof(events))) > 0)
+        {
+            for (char *p = events; p < events + length;)
+            {
+                const auto *event = reinterpret_cast<const inotify_event *>(p);
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    fullScan = true;
+                }
+                else if (event->len > 0)
+                {
+                    changed_.insert(event->name);
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+#endif
+    }
+
+    if (notify >= 0)
+    {
+        ::close(notify);
+    }
+    step(true);
+    flush();
+}
+
+size_t LiveMerger::flush()
+{
+    if (closed_)
+    {
+        return 0;
+    }
+    size_t rows = release(true);
+    closed_ = true;
+    output_.close();
+    return rows;
+}
+
+void LiveMerger::scanDirectory()
+{
+    for (const auto &entry : std::filesystem::directory_iterator(directory_))
+    {
+        const std::string path = entry.path().generic_string();
+        if (!entry.is_regular_file() || entry.path().filename().string()[0] == '.' ||
+            tails_.count(SymbolTable::symbolOf(path)))
+        {
+            continue;
+        }
+        std::error_code ec;
+        if (!std::filesystem::equivalent(path, outputPath_, ec))
+        {
+            addTail(path);
+        }
+    }
+}
+
+LiveMerger::Tail &LiveMerger::addTail(const std::string &path)
+{
+    auto tail = std::make_unique<Tail>();
+    tail->path = path;
+    tail->symbol = SymbolTable::symbolOf(path);
+    tail->lastData = Clock::now();
+    Tail &added = *tail;
+    tails_.emplace(tail->symbol, std::move(tail));
+
+    // Ids follow name order, so a new symbol renumbers the ones after it
+    std::vector<std::string> names;
+    byId_.clear();
+    for (auto &entry : tails_)
+    {
+        Tail &each = *entry.second;
+        each.id = static_cast<uint32_t>(byId_.size());
+        for (auto &pending : each.pending)
+        {
+            pending.symbolId = each.id;
+        }
+        names.push_back(each.symbol);
+        byId_.push_back(&each);
+    }
+    symbols_ = SymbolTable(std::move(names));
+    return added;
+}
+
+void LiveMerger::readTail(Tail &tail)
+{
+    if (tail.fd < 0)
+    {
+        tail.fd = ::open(tail.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (tail.fd < 0)
+        {
+            return; // Removed or renamed since it was seen
+        }
+    }
+
+    // A file shorter than what was read has been truncated and is read from the start
+    struct stat info;
+    if (::fstat(tail.fd, &info) == 0 && static_cast<uint64_t>(info.st_size) < tail.offset)
+    {
+        tail.offset = 0;
+        tail.partial.clear();
+        tail.headerSkipped = false;
+    }
+
+    char chunk[64 * 1024];
+    for (;;)
+    {
+        ssize_t count = ::pread(tail.fd, chunk, sizeof(chunk), static_cast<off_t>(tail.offset));
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            break;
+        }
+        tail.offset += static_cast<uint64_t>(count);
+        tail.partial.append(chunk, static_cast<size_t>(count));
+        tail.lastData = Clock::now();
+        parseLines(tail);
+    }
+}
+
+void LiveMerger::parseLines(Tail &tail)
+{
+    // Only complete lines are parsed; the rest waits for the writer to finish the line
+    const char *begin = tail.partial.data();
+    const char *end = begin + tail.partial.size();
+    const char *p = begin;
+    for (;;)
+    {
+        const char *delimiters[4];
+        size_t delimiterCount = 0;
+        const char *newline = LineParser::scanLine(p, end, delimiters, 4, delimiterCount);
+        if (!newline)
+        {
+            break;
+        }
+        if (!tail.headerSkipped)
+        {
+            tail.headerSkipped = true;
+        }
+        else if (delimiterCount >= 4)
+        {
+            parseLine(tail, p, newline, delimiters);
+        }
+        p = newline + 1;
+    }
+    tail.partial.erase(0, static_cast<size_t>(p - begin));
+}
+
+void LiveMerger::parseLine(Tail &tail, const char *begin, const char *end, const char *const *delimiters)
+{
+    auto field = [&](size_t i)
+    {
+        const char *from = i == 0 ? begin : delimiters[i - 1] + 1;
+        const char *to = i < 4 ? delimiters[i] : end;
+        return LineParser::trim(std::string_view(from, static_cast<size_t>(to - from)));
+    };
+
+    MarketDataEntry entry{};
+    entry.symbolId = tail.id;
+    if (!LineParser::parseTimestamp(field(0), entry.timestamp))
+    {
+        throwInvalidField("timestamp", field(0));
+    }
+    if (!LineParser::parseFixed(field(1), MarketDataEntry::kPriceDigits, entry.price))
+    {
+        throwInvalidField("price", field(1));
+    }
+    int64_t size = 0;
+    if (!LineParser::parseInt(field(2), size) || size < INT32_MIN || size > INT32_MAX)
+    {
+        throwInvalidField("size", field(2));
+    }
+    entry.size = static_cast<int32_t>(size);
+    entry.exchange = ExchangeTable::intern(field(3));
+    if (!parseSide(field(4), entry.side))
+    {
+        throwInvalidField("type", field(4));
+    }
+
+    tail.high = tail.hasRows ? std::max(tail.high, entry.timestamp) : entry.timestamp;
+    tail.hasRows = true;
+    newest_ = std::max(newest_, entry.timestamp);
+
+    // Behind what has already gone out: too late to place in order
+    if (emittedAny_ && entry.key() < keyOf(lastTimestamp_, lastTail_->id))
+    {
+        ++late_;
+        return;
+    }
+    tail.pending.push_back(entry);
+}
+
+size_t LiveMerger::release(bool everything)
+{
+    using Key = MarketDataEntry::Key;
+    Key limit = ~Key(0);
+    if (!everything)
+    {
+        // Watermark: the least advanced symbol that is still active
+        const auto now = Clock::now();
+        for (const Tail *tail : byId_)
+        {
+            if (now - tail->lastData <= options_.idleTimeout)
+            {
+                limit = std::min(limit, tail->hasRows ? keyOf(tail->high, tail->id) : Key(0));
+            }
+        }
+        // Lateness bound: nothing waits longer than that behind the newest row
+        if (newest_ != INT64_MIN && newest_ > INT64_MIN + options_.latenessNanos)
+        {
+            limit = std::max(limit, keyOf(newest_ - options_.latenessNanos, UINT32_MAX));
+        }
+    }
+
+    LoserTree<Key> tree(byId_.size());
+    for (size_t i = 0; i < byId_.size(); ++i)
+    {
+        if (!byId_[i]->pending.empty())
+        {
+            tree.set(i, byId_[i]->pending.front().key());
+        }
+    }
+    tree.build();
+
+    size_t rows = 0;
+    while (!tree.empty() && tree.winnerKey() <= limit)
+    {
+        Tail &tail = *byId_[tree.winner()];
+        const MarketDataEntry &entry = tail.pending.front();
+        TextFormat::appendEntry(output_.buffer(), entry, symbols_);
+        output_.commit();
+        lastTimestamp_ = entry.timestamp;
+        lastTail_ = &tail;
+        emittedAny_ = true;
+        ++rows;
+
+        tail.pending.pop_front();
+        if (tail.pending.empty())
+        {
+            tree.removeWinner();
+        }
+        else
+        {
+            tree.replaceWinner(tail.pending.front().key());
+        }
+    }
+
+    // Hand over what was formatted so readers see it without waiting for a full buffer
+    if (rows > 0)
+    {
+        output_.flush();
+    }
+    emitted_ += rows;
+    return rows;
+}
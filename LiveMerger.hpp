@@ -0,0 +1,97 @@
+// File: LiveMerger.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include "OutputWriter.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Streaming merge over symbol files that are still being appended to. Each file is
+// tailed from where it was last read; a row is released once every active symbol
+// has moved past it (or once it is older than the lateness bound), so the output
+// stays globally ordered while lagging the input by little more than the slowest feed.
+class LiveMerger
+{
+public:
+    struct Options
+    {
+        // Rows this far behind the newest timestamp seen anywhere are released even if a
+        // symbol has not caught up yet; rows arriving behind what was released are dropped
+        int64_t latenessNanos = 1000000000;
+
+        // A symbol without new rows for this long stops holding the others back
+        std::chrono::milliseconds idleTimeout{1000};
+
+        // Longest wait between polls when the directory is quiet
+        std::chrono::milliseconds pollInterval{10};
+    };
+
+    LiveMerger(const std::string &directory, const std::string &outputFile, const Options &options);
+    ~LiveMerger();
+
+    LiveMerger(const LiveMerger &) = delete;
+    LiveMerger &operator=(const LiveMerger &) = delete;
+
+    // Pick up new files and appended rows, and emit what the watermark allows;
+    // returns the rows emitted
+    size_t poll();
+
+    // Follow the directory (inotify where available) until stop is set, then flush
+    void run(const std::atomic<bool> &stop);
+
+    // Emit everything held back and close the output
+    size_t flush();
+
+    uint64_t emittedRows() const { return emitted_; }
+    uint64_t lateRows() const { return late_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // One symbol file being tailed
+    struct Tail
+    {
+        std::string path;
+        std::string symbol;
+        uint32_t id = 0;
+        int fd = -1;
+        uint64_t offset = 0;    // Bytes of the file consumed so far
+        std::string partial;    // Incomplete last line
+        bool headerSkipped = false;
+        bool hasRows = false;
+        int64_t high = 0;       // Latest timestamp read
+        Clock::time_point lastData;
+        std::deque<MarketDataEntry> pending; // Read, not yet released
+    };
+
+    size_t step(bool fullScan);
+    void scanDirectory();
+    Tail &addTail(const std::string &path);
+    void readTail(Tail &tail);
+    void parseLines(Tail &tail);
+    void parseLine(Tail &tail, const char *begin, const char *end, const char *const *delimiters);
+    size_t release(bool everything);
+
+    std::string directory_;
+    std::string outputPath_;
+    Options options_;
+    OutputWriter output_;
+    std::map<std::string, std::unique_ptr<Tail>> tails_; // By symbol name, so in id order
+    std::vector<Tail *> byId_;
+    SymbolTable symbols_;
+    std::unordered_set<std::string> changed_; // File names reported by inotify since the last step
+    int64_t newest_;                          // Newest timestamp read from any file
+    bool emittedAny_;
+    int64_t lastTimestamp_; // Key of the last emitted row, as (timestamp, symbol)
+    const Tail *lastTail_;
+    std::atomic<uint64_t> emitted_; // Read by other threads while run() is going
+    std::atomic<uint64_t> late_;
+    bool closed_;
+};
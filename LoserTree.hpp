@@ -0,0 +1,155 @@
+// File: LoserTree.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tournament tree of losers for k-way merging. Source keys live inline in one
+// contiguous array and each internal node keeps the source that lost there, so
+// replacing the winner's key replays a single leaf-to-root path: log k compares
+// per record, without touching the sources themselves. Equal keys are won by
+// the lower source index, which keeps the merge stable.
+template <typename Key>
+class LoserTree
+{
+public:
+    explicit LoserTree(size_t sources = 0)
+    {
+        reset(sources);
+    }
+
+    // Resize for a number of sources, all exhausted until set()
+    void reset(size_t sources)
+    {
+        keys_.assign(sources, Key());
+        live_.assign(sources, 0);
+        losers_.assign(sources, 0);
+        winner_ = 0;
+    }
+
+    size_t size() const { return keys_.size(); }
+
+    // Give a source its first key; call build() once all sources are set
+    void set(size_t source, const Key &key)
+    {
+        keys_[source] = key;
+        live_[source] = 1;
+    }
+
+    // Play the initial tournament
+    void build()
+    {
+        const size_t k = keys_.size();
+        if (k == 0)
+        {
+            return;
+        }
+
+        // winners[n] is the winner of the subtree at node n; leaves are nodes k..2k-1
+        std::vector<uint32_t> winners(2 * k);
+        for (size_t i = 0; i < k; ++i)
+        {
+            winners[k + i] = static_cast<uint32_t>(i);
+        }
+        for (size_t node = k - 1; node >= 1; --node)
+        {
+            uint32_t left = winners[2 * node];
+            uint32_t right = winners[2 * node + 1];
+            bool leftWins = less(left, right);
+            winners[node] = leftWins ? left : right;
+            losers_[node] = leftWins ? right : left;
+        }
+        winner_ = k == 1 ? 0 : winners[1];
+    }
+
+    // True once every source is exhausted
+    bool empty() const
+    {
+        return keys_.empty() || !live_[winner_];
+    }
+
+    size_t winner() const { return winner_; }
+    const Key &winnerKey() const { return keys_[winner_]; }
+
+    // The winner advanced to a new key
+    void replaceWinner(const Key &key)
+    {
+        keys_[winner_] = key;
+        replay(winner_);
+    }
+
+    // The winner ran out of keys
+    void removeWinner()
+    {
+        live_[winner_] = 0;
+        replay(winner_);
+    }
+
+    // Smallest live source other than the winner: the best loser on the winner's path.
+    // Returns false when the winner is the only live source.
+    bool runnerUp(size_t &source) const
+    {
+        const size_t k = keys_.size();
+        bool found = false;
+        uint32_t best = 0;
+        for (size_t node = (winner_ + k) / 2; node >= 1; node /= 2)
+        {
+            uint32_t candidate = losers_[node];
+            if (live_[candidate] && (!found || less(candidate, best)))
+            {
+                best = candidate;
+                found = true;
+            }
+        }
+        source = best;
+        return found;
+    }
+
+    // Whether a key from the winner would still beat a given source
+    bool beats(const Key &key, size_t source) const
+    {
+        return key < keys_[source] || (!(keys_[source] < key) && winner_ < source);
+    }
+
+    const Key &key(size_t source) const { return keys_[source]; }
+
+private:
+    bool less(uint32_t a, uint32_t b) const
+    {
+        if (!live_[a] || !live_[b])
+        {
+            return live_[a] > live_[b] || (live_[a] == live_[b] && a < b);
+        }
+        if (keys_[a] < keys_[b])
+        {
+            return true;
+        }
+        if (keys_[b] < keys_[a])
+        {
+            return false;
+        }
+        return a < b;
+    }
+
+    void replay(size_t source)
+    {
+        const size_t k = keys_.size();
+        uint32_t candidate = static_cast<uint32_t>(source);
+        for (size_t node = (source + k) / 2; node >= 1; node /= 2)
+        {
+            if (less(losers_[node], candidate))
+            {
+                uint32_t loser = candidate;
+                candidate = losers_[node];
+                losers_[node] = loser;
+            }
+        }
+        winner_ = candidate;
+    }
+
+    std::vector<Key> keys_;
+    std::vector<uint8_t> live_;
+    std::vector<uint32_t> losers_; // losers_[n] for internal nodes 1..k-1
+    size_t winner_;
+};
@@ -0,0 +1,118 @@
+// File: MarketDataEntry.cpp
+#include "MarketDataEntry.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+// SymbolTable implementation
+SymbolTable::SymbolTable(std::vector<std::string> names)
+    : names_(std::move(names))
+{
+    std::sort(names_.begin(), names_.end());
+    names_.erase(std::unique(names_.begin(), names_.end()), names_.end());
+}
+
+uint32_t SymbolTable::id(std::string_view name) const
+{
+    auto it = std::lower_bound(names_.begin(), names_.end(), name,
+                               [](const std::string &a, std::string_view b)
+                               { return std::string_view(a) < b; });
+    if (it == names_.end() || *it != name)
+    {
+        throw std::runtime_error("Unknown symbol: " + std::string(name));
+    }
+    return static_cast<uint32_t>(it - names_.begin());
+}
+
+std::string SymbolTable::symbolOf(const std::string &filename)
+{
+    // Compressed files keep the symbol of the file they hold ("CSCO.txt.zst" is CSCO)
+    std::filesystem::path path(filename);
+    if (path.extension() == ".gz" || path.extension() == ".zst")
+    {
+        path = path.stem();
+    }
+    return path.stem().string();
+}
+
+// ExchangeTable implementation
+std::array<std::string, ExchangeTable::kMaxExchanges> ExchangeTable::names_ = {"NYSE", "NYSE_ARCA", "NASDAQ"};
+std::atomic<size_t> ExchangeTable::count_{3};
+std::mutex ExchangeTable::mutex_;
+
+uint8_t ExchangeTable::intern(std::string_view name)
+{
+    // Published names never change, so lookups need no lock
+    size_t count = count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (names_[i] == name)
+        {
+            return static_cast<uint8_t>(i);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    count = count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (names_[i] == name)
+        {
+            return static_cast<uint8_t>(i);
+        }
+    }
+    if (count == kMaxExchanges)
+    {
+        throw std::runtime_error("Too many distinct exchanges: " + std::string(name));
+    }
+    names_[count] = std::string(name);
+    count_.store(count + 1, std::memory_order_release);
+    return static_cast<uint8_t>(count);
+}
+
+std::string_view ExchangeTable::name(uint8_t id)
+{
+    return names_[id];
+}
+
+bool parseSide(std::string_view text, Side &side)
+{
+    auto equalsIgnoreCase = [text](std::string_view expected)
+    {
+        return text.size() == expected.size() &&
+               std::equal(text.begin(), text.end(), expected.begin(),
+                          [](char a, char b)
+                          { return (a | 0x20) == (b | 0x20); });
+    };
+
+    if (equalsIgnoreCase("bid"))
+    {
+        side = Side::Bid;
+    }
+    else if (equalsIgnoreCase("ask"))
+    {
+        side = Side::Ask;
+    }
+    else if (equalsIgnoreCase("trade"))
+    {
+        side = Side::Trade;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+std::string_view sideName(Side side)
+{
+    switch (side)
+    {
+    case Side::Bid:
+        return "Bid";
+    case Side::Ask:
+        return "Ask";
+    default:
+        return "TRADE";
+    }
+}
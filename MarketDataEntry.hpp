@@ -0,0 +1,132 @@
+// File: MarketDataEntry.hpp
+#pragma once
+
+#include "Arena.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Quote side or trade marker of an entry
+enum class Side : uint8_t
+{
+    Bid,
+    Ask,
+    Trade
+};
+
+// Packed market data record. Text fields are interned and only rendered again at output.
+struct MarketDataEntry
+{
+    static constexpr int kPriceDigits = 8; // Fixed-point decimals of price
+
+    int64_t timestamp; // Nanoseconds since the Unix epoch (UTC)
+    int64_t price;     // price * 10^kPriceDigits
+    int32_t size;
+    uint32_t symbolId; // SymbolTable id; ids are ordered like the symbol names
+    uint8_t exchange;  // ExchangeTable id
+    Side side;
+
+    // Merge key: timestamp, then symbol, as a single 128-bit compare
+    using Key = unsigned __int128;
+    Key key() const
+    {
+        // Flipping the sign bit makes the signed timestamp order as unsigned
+        return (static_cast<Key>(static_cast<uint64_t>(timestamp) ^ (uint64_t(1) << 63)) << 64) | symbolId;
+    }
+
+    bool operator>(const MarketDataEntry &other) const
+    {
+        return key() > other.key();
+    }
+
+    bool operator<(const MarketDataEntry &other) const
+    {
+        return key() < other.key();
+    }
+};
+
+static_assert(std::is_trivially_copyable<MarketDataEntry>::value, "MarketDataEntry must stay POD");
+static_assert(sizeof(MarketDataEntry) == 32, "MarketDataEntry should pack into 32 bytes");
+
+// Structure-of-arrays chunk of parsed rows from one symbol file; the columns can live
+// in an arena (see Arena.hpp) or on the heap
+struct EntryBlock
+{
+    ArenaVector<int64_t> timestamps;
+    ArenaVector<int64_t> prices;
+    ArenaVector<int32_t> sizes;
+    ArenaVector<uint8_t> exchanges;
+    ArenaVector<Side> sides;
+    size_t count = 0;
+
+    explicit EntryBlock(size_t capacity = 0, Arena *arena = nullptr)
+        : timestamps(capacity, ArenaAllocator<int64_t>(arena)), prices(capacity, ArenaAllocator<int64_t>(arena)),
+          sizes(capacity, ArenaAllocator<int32_t>(arena)), exchanges(capacity, ArenaAllocator<uint8_t>(arena)),
+          sides(capacity, ArenaAllocator<Side>(arena))
+    {
+    }
+
+    size_t capacity() const { return timestamps.size(); }
+
+    // Row i as a packed record
+    MarketDataEntry entry(size_t i, uint32_t symbolId) const
+    {
+        MarketDataEntry result;
+        result.timestamp = timestamps[i];
+        result.price = prices[i];
+        result.size = sizes[i];
+        result.symbolId = symbolId;
+        result.exchange = exchanges[i];
+        result.side = sides[i];
+        return result;
+    }
+};
+
+// Symbol names of one merge, with ids assigned in name order so that id order is name order
+class SymbolTable
+{
+public:
+    SymbolTable() = default;
+    explicit SymbolTable(std::vector<std::string> names);
+
+    // Id of a symbol in the table; throws if unknown
+    uint32_t id(std::string_view name) const;
+
+    const std::string &name(uint32_t id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+
+    // Symbol name a market data file carries (its stem, ignoring a .gz or .zst suffix)
+    static std::string symbolOf(const std::string &filename);
+
+private:
+    std::vector<std::string> names_;
+};
+
+// Process-wide intern table for the small set of exchange names
+class ExchangeTable
+{
+public:
+    // Id for a name, adding it on first sight; throws past 256 exchanges
+    static uint8_t intern(std::string_view name);
+
+    static std::string_view name(uint8_t id);
+
+    // Names interned so far; ids run from 0 to size() - 1
+    static size_t size() { return count_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t kMaxExchanges = 256;
+
+    static std::array<std::string, kMaxExchanges> names_;
+    static std::atomic<size_t> count_;
+    static std::mutex mutex_;
+};
+
+// Text form of sides as written in the input and output files
+bool parseSide(std::string_view text, Side &side);
+std::string_view sideName(Side side);
@@ -0,0 +1,535 @@
+// File: Metrics.cpp
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+std::atomic<bool> Metrics::enabled_{false};
+thread_local Metrics::Shard *Metrics::shard_ = nullptr;
+
+namespace
+{
+    struct MetricInfo
+    {
+        const char *name;
+        const char *help;
+        bool seconds; // Recorded in timer cycles, reported in seconds
+    };
+
+    const MetricInfo kCounters[] = {
+        {"bytes_read", "Bytes read from input files", false},
+        {"rows_parsed", "Rows parsed from input files", false},
+        {"rows_merged", "Rows emitted by k-way merges, intermediate ones included", false},
+        {"heap_operations", "Loser-tree builds, replays and removals", false},
+        {"batches_merged", "Leaf batches merged into runs", false},
+        {"nodes_merged", "Merge-tree nodes above the batches", false},
+        {"output_waits", "Times the output producer waited for the writer thread", false},
+        {"rows_replayed", "Rows published by a replay", false},
+    };
+
+    const MetricInfo kHistograms[] = {
+        {"read_bytes", "Bytes per input read", false},
+        {"block_rows", "Rows per parsed block", false},
+        {"merge_heap_operations", "Heap operations per k-way merge", false},
+        {"parse_seconds", "Time to parse one block", true},
+        {"batch_seconds", "Time to merge one leaf batch", true},
+        {"node_seconds", "Time to merge one merge-tree node", true},
+        {"final_merge_seconds", "Time of the final merge", true},
+        {"write_seconds", "Time to write one output buffer", true},
+        {"output_wait_seconds", "Time the output producer waited for an empty buffer", true},
+        {"idle_seconds", "Time a pool thread waited for work, per wait", true},
+        {"replay_jitter_nanoseconds", "How late a paced replay published a row it waited for", false},
+        {"replay_lag_nanoseconds", "How far overdue a row was when the merge handed it to the replay", false},
+        {"replay_delivery_nanoseconds", "Time from a replay publishing a row to a ring consumer reading it", false},
+    };
+
+    constexpr size_t kCounterCount = static_cast<size_t>(Metrics::Counter::Count);
+    constexpr size_t kHistogramCount = static_cast<size_t>(Metrics::Histogram::Count);
+
+    static_assert(sizeof(kCounters) / sizeof(kCounters[0]) == kCounterCount, "Every counter needs a name");
+    static_assert(sizeof(kHistograms) / sizeof(kHistograms[0]) == kHistogramCount, "Every histogram needs a name");
+
+    struct Origin
+    {
+        uint64_t cycles;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    const Origin &origin()
+    {
+        static const Origin start{Metrics::cycles(), std::chrono::steady_clock::now()};
+        return start;
+    }
+
+    struct HistogramTotals
+    {
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(Metrics::kBuckets);
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        // Highest value the bucket holding the q-th value can contain, capped at the maximum
+        uint64_t quantile(double q) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count) + 0.5));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < Metrics::kBuckets; ++b)
+            {
+                seen += buckets[b];
+                if (seen >= rank)
+                {
+                    const uint64_t ceiling = b + 1 < Metrics::kBuckets ? Metrics::bucketFloor(b + 1) - 1 : UINT64_MAX;
+                    return std::min(ceiling, max);
+                }
+            }
+            return max;
+        }
+    };
+
+    // Totals over every shard
+    struct Snapshot
+    {
+        std::array<uint64_t, kCounterCount> counters{};
+        std::array<HistogramTotals, kHistogramCount> histograms;
+        std::vector<std::pair<std::string, uint64_t>> idle; // Cycles per named thread
+    };
+
+    std::string number(double value)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", value);
+        return text;
+    }
+
+    std::string escape(const std::string &text)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    std::string renderJson(const Snapshot &snapshot, double cyclesPerSecond, double uptime)
+    {
+        std::string out = "{\n  \"uptime_seconds\": " + number(uptime) + ",\n  \"counters\": {";
+        for (size_t i = 0; i < kCounterCount; ++i)
+        {
+            out += i ? ",\n    \"" : "\n    \"";
+            out += kCounters[i].name;
+            out += "\": " + std::to_string(snapshot.counters[i]);
+        }
+        out += "\n  },\n  \"histograms\": {";
+        for (size_t i = 0; i < kHistogramCount; ++i)
+        {
+            const HistogramTotals &histogram = snapshot.histograms[i];
+            const double scale = kHistograms[i].seconds ? 1.0 / cyclesPerSecond : 1.0;
+            auto value = [&](double raw)
+            { return number(raw * scale); };
+
+            out += i ? ",\n    \"" : "\n    \"";
+            out += kHistograms[i].name;
+            out += "\": {\"count\": " + std::to_string(histogram.count) +
+                   ", \"sum\": " + value(static_cast<double>(histogram.sum)) +
+                   ", \"max\": " + value(static_cast<double>(histogram.max)) +
+                   ", \"p50\": " + value(static_cast<double>(histogram.quantile(0.5))) +
+                   ", \"p90\": " + value(static_cast<double>(histogram.quantile(0.9))) +
+                   ", \"p99\": " + value(static_cast<double>(histogram.quantile(0.99))) +
+                   ", \"p999\": " + value(static_cast<double>(histogram.quantile(0.999))) + "}";
+        }
+        out += "\n  },\n  \"threads\": [";
+        for (size_t i = 0; i < snapshot.idle.size(); ++i)
+        {
+            out += i ? ",\n    " : "\n    ";
+            out += "{\"name\": \"" + escape(snapshot.idle[i].first) + "\", \"idle_seconds\": " +
+                   number(static_cast<double>(snapshot.idle[i].second) / cyclesPerSecond) + "}";
+        }
+        out += "\n  ]\n}\n";
+        return out;
+    }
+
+    std::string renderPrometheus(const Snapshot &snapshot, double cyclesPerSecond)
+    {
+        std::string out;
+        for (size_t i = 0; i < kCounterCount; ++i)
+        {
+            const std::string name = std::string("mdf_") + kCounters[i].name + "_total";
+            out += "# HELP " + name + " " + kCounters[i].help + "\n# TYPE " + name + " counter\n";
+            out += name + " " + std::to_string(snapshot.counters[i]) + "\n";
+        }
+        for (size_t i = 0; i < kHistogramCount; ++i)
+        {
+            const HistogramTotals &histogram = snapshot.histograms[i];
+            const double scale = kHistograms[i].seconds ? 1.0 / cyclesPerSecond : 1.0;
+            const std::string name = std::string("mdf_") + kHistograms[i].name;
+            out += "# HELP " + name + " " + kHistograms[i].help + "\n# TYPE " + name + " histogram\n";
+
+            // Only buckets that hold values, as cumulative counts at their upper bounds
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b + 1 < Metrics::kBuckets; ++b)
+            {
+                if (histogram.buckets[b] == 0)
+                {
+                    continue;
+                }
+                cumulative += histogram.buckets[b];
+                const double bound = static_cast<double>(Metrics::bucketFloor(b + 1) - 1) * scale;
+                out += name + "_bucket{le=\"" + number(bound) + "\"} " + std::to_string(cumulative) + "\n";
+            }
+            out += name + "_bucket{le=\"+Inf\"} " + std::to_string(histogram.count) + "\n";
+            out += name + "_sum " + number(static_cast<double>(histogram.sum) * scale) + "\n";
+            out += name + "_count " + std::to_string(histogram.count) + "\n";
+        }
+        out += "# HELP mdf_thread_idle_seconds_total Time each thread waited for work\n"
+               "# TYPE mdf_thread_idle_seconds_total counter\n";
+        for (const auto &thread : snapshot.idle)
+        {
+            out += "mdf_thread_idle_seconds_total{thread=\"" + escape(thread.first) + "\"} " +
+                   number(static_cast<double>(thread.second) / cyclesPerSecond) + "\n";
+        }
+        return out;
+    }
+}
+
+struct Metrics::Registry
+{
+    // Marks the thread's shard free when the thread exits
+    struct Release
+    {
+        ~Release()
+        {
+            if (shard_)
+            {
+                std::lock_guard<std::mutex> lock(mutex());
+                shard_->inUse = false;
+                shard_ = nullptr;
+            }
+        }
+    };
+
+    static std::mutex &mutex()
+    {
+        static std::mutex registryMutex;
+        return registryMutex;
+    }
+
+    // Never freed, so snapshots can read shards of threads that have exited
+    static std::vector<std::unique_ptr<Shard>> &shards()
+    {
+        static std::vector<std::unique_ptr<Shard>> all;
+        return all;
+    }
+
+    static Snapshot snapshot()
+    {
+        Snapshot snapshot;
+        std::lock_guard<std::mutex> lock(mutex());
+        for (const auto &shard : shards())
+        {
+            for (size_t i = 0; i < kCounterCount; ++i)
+            {
+                snapshot.counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < kHistogramCount; ++i)
+            {
+                const HistogramData &data = shard->histograms[i];
+                HistogramTotals &totals = snapshot.histograms[i];
+                if (data.count.load(std::memory_order_relaxed) == 0)
+                {
+                    continue;
+                }
+                for (size_t b = 0; b < kBuckets; ++b)
+                {
+                    totals.buckets[b] += data.buckets[b].load(std::memory_order_relaxed);
+                }
+                totals.count += data.count.load(std::memory_order_relaxed);
+                totals.sum += data.sum.load(std::memory_order_relaxed);
+                totals.max = std::max(totals.max, data.max.load(std::memory_order_relaxed));
+            }
+            const uint64_t idle = shard->idleCycles.load(std::memory_order_relaxed);
+            if (idle > 0)
+            {
+                snapshot.idle.emplace_back(shard->name, idle);
+            }
+        }
+        return snapshot;
+    }
+};
+
+Metrics::Shard &Metrics::attachShard()
+{
+    thread_local Registry::Release release;
+    std::lock_guard<std::mutex> lock(Registry::mutex());
+    auto &shards = Registry::shards();
+
+    // A shard left by a finished thread keeps its totals and serves the new thread
+    auto free = std::find_if(shards.begin(), shards.end(), [](const std::unique_ptr<Shard> &shard)
+                             { return !shard->inUse; });
+    if (free == shards.end())
+    {
+        shards.push_back(std::make_unique<Shard>());
+        free = shards.end() - 1;
+    }
+    shard_ = free->get();
+    shard_->inUse = true;
+    shard_->name = "thread-" + std::to_string(free - shards.begin());
+    return *shard_;
+}
+
+void Metrics::enable(bool on)
+{
+    origin();
+    enabled_.store(on, std::memory_order_relaxed);
+}
+
+void Metrics::nameThread(const std::string &name)
+{
+    Shard &shard = thisShard();
+    std::lock_guard<std::mutex> lock(Registry::mutex());
+    shard.name = name;
+}
+
+void Metrics::recordIdle(uint64_t idleCycles)
+{
+    if (enabled())
+    {
+        Shard &shard = thisShard();
+        shard.histograms[static_cast<size_t>(Histogram::IdleTime)].record(idleCycles);
+        bump(shard.idleCycles, idleCycles);
+    }
+}
+
+double Metrics::cyclesPerSecond()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // Calibrate over at least 10 ms since the origin
+    const Origin &start = origin();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start.time;
+    if (elapsed.count() < 0.01)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(0.01 - elapsed.count()));
+    }
+    const uint64_t now = cycles();
+    elapsed = std::chrono::steady_clock::now() - start.time;
+    return static_cast<double>(now - start.cycles) / elapsed.count();
+#else
+    return 1e9;
+#endif
+}
+
+std::string Metrics::render(MetricsFormat format)
+{
+    const double rate = cyclesPerSecond();
+    const double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - origin().time).count();
+    const Snapshot snapshot = Registry::snapshot();
+    return format == MetricsFormat::Json ? renderJson(snapshot, rate, uptime) : renderPrometheus(snapshot, rate);
+}
+
+void Metrics::reset()
+{
+    std::lock_guard<std::mutex> lock(Registry::mutex());
+    for (auto &shard : Registry::shards())
+    {
+        for (auto &counter : shard->counters)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto &histogram : shard->histograms)
+        {
+            for (auto &bucket : histogram.buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+        }
+        shard->idleCycles.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Metrics::total(Counter counter)
+{
+    return Registry::snapshot().counters[static_cast<size_t>(counter)];
+}
+
+uint64_t Metrics::count(Histogram histogram)
+{
+    return Registry::snapshot().histograms[static_cast<size_t>(histogram)].count;
+}
+
+uint64_t Metrics::quantile(Histogram histogram, double q)
+{
+    return Registry::snapshot().histograms[static_cast<size_t>(histogram)].quantile(q);
+}
+
+// MetricsReporter implementation
+MetricsReporter::MetricsReporter(const std::string &target, MetricsFormat format, std::chrono::milliseconds interval)
+    : format_(format), interval_(interval), listenFd_(-1), stopping_(false)
+{
+    if (target.rfind("unix:", 0) == 0)
+    {
+        path_ = target.substr(5);
+        sockaddr_un address{};
+        if (path_.empty() || path_.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("Invalid metrics socket path: " + path_);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Failed to create metrics socket");
+        }
+        ::unlink(path_.c_str());
+        if (::bind(listenFd_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, 8) != 0)
+        {
+            const int error = errno;
+            ::close(listenFd_);
+            throw std::system_error(error, std::generic_category(), "Failed to listen on metrics socket " + path_);
+        }
+    }
+    else
+    {
+        path_ = target;
+        writeFile(); // Fails early on a bad path
+    }
+
+    if (listenFd_ >= 0 || interval_.count() > 0)
+    {
+        thread_ = std::thread(&MetricsReporter::run, this);
+    }
+}
+
+MetricsReporter::~MetricsReporter()
+{
+    try
+    {
+        stop();
+    }
+    catch (...)
+    {
+        // Destructors must not throw; stop() is called explicitly where errors matter
+    }
+}
+
+void MetricsReporter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+        {
+            return;
+        }
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    if (listenFd_ >= 0)
+    {
+        ::close(listenFd_);
+        ::unlink(path_.c_str());
+        listenFd_ = -1;
+    }
+    else
+    {
+        writeFile();
+    }
+}
+
+void MetricsReporter::run()
+{
+    Metrics::nameThread("metrics");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+        if (listenFd_ < 0)
+        {
+            wake_.wait_for(lock, interval_, [this]()
+                           { return stopping_; });
+            if (!stopping_)
+            {
+                lock.unlock();
+                try
+                {
+                    writeFile();
+                }
+                catch (const std::exception &)
+                {
+                    // Retried at the next interval; the final write in stop() reports it
+                }
+                lock.lock();
+            }
+            continue;
+        }
+
+        // Serve a snapshot to each client; poll briefly so stop() is noticed
+        lock.unlock();
+        pollfd listener{listenFd_, POLLIN, 0};
+        if (::poll(&listener, 1, 100) > 0)
+        {
+            int client = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0)
+            {
+                const std::string text = Metrics::render(format_);
+                size_t done = 0;
+                while (done < text.size())
+                {
+                    ssize_t count = ::send(client, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+                    if (count <= 0)
+                    {
+                        break;
+                    }
+                    done += static_cast<size_t>(count);
+                }
+                ::close(client);
+            }
+        }
+        lock.lock();
+    }
+}
+
+void MetricsReporter::writeFile()
+{
+    // Readers never see a half-written snapshot
+    const std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << Metrics::render(format_);
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write metrics file: " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), path_.c_str()) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Failed to write metrics file: " + path_);
+    }
+}
@@ -0,0 +1,234 @@
+// File: Metrics.hpp
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Output formats of a metrics snapshot
+enum class MetricsFormat
+{
+    Json,
+    Prometheus
+};
+
+// Pipeline instrumentation: counters, log-linear histograms and cycle timers. Each
+// thread records into its own shard (one writer, so no read-modify-write atomics on
+// the hot path) and a snapshot sums the shards. While metrics are off, recording
+// costs one predictable branch. Call sites record per read, per parsed block or per
+// merge rather than per row.
+class Metrics
+{
+public:
+    enum class Counter
+    {
+        BytesRead,      // Bytes pulled from input files (compressed bytes for compressed files)
+        RowsParsed,
+        RowsMerged,     // Rows emitted by k-way merges, intermediate ones included
+        HeapOperations, // Loser-tree builds, replays and removals
+        BatchesMerged,
+        NodesMerged,    // Merge-tree nodes above the batches
+        OutputWaits,    // Times the output producer waited for the writer
+        RowsReplayed,   // Rows published by a replay
+        Count
+    };
+
+    enum class Histogram
+    {
+        ReadBytes,      // Bytes per input read
+        BlockRows,      // Rows per parsed block
+        MergeHeapOps,   // Heap operations per k-way merge
+        ParseTime,      // Per parsed block
+        BatchTime,      // Per leaf batch
+        NodeTime,       // Per merge-tree node
+        FinalMergeTime,
+        WriteTime,      // Per output buffer written
+        OutputWaitTime, // Per producer wait for an empty output buffer
+        IdleTime,       // Per spell of a pool thread waiting for work
+        ReplayJitter,   // Nanoseconds a paced row went out after its time, per publication waited for
+        ReplayLag,      // Nanoseconds a row was already overdue when the merge produced it
+        ReplayDelivery, // Nanoseconds from publication to a ring consumer reading the row
+        Count
+    };
+
+    // Log-linear buckets: 16 per power of two, so bucket bounds are within 1/16 of
+    // any value recorded in them, from 0 up to 2^64
+    static constexpr size_t kSubBuckets = 16;
+    static constexpr size_t kBuckets = 61 * kSubBuckets;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return static_cast<size_t>(value);
+        }
+        const int shift = 59 - __builtin_clzll(value); // Position of the top bit, minus 4
+        return static_cast<size_t>(shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+    }
+
+    // Smallest value of a bucket
+    static uint64_t bucketFloor(size_t bucket)
+    {
+        if (bucket < kSubBuckets)
+        {
+            return bucket;
+        }
+        const size_t shift = bucket / kSubBuckets - 1;
+        return (kSubBuckets + bucket % kSubBuckets) << shift;
+    }
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+    static void enable(bool on);
+
+    static void add(Counter counter, uint64_t amount = 1)
+    {
+        if (enabled())
+        {
+            Shard &shard = thisShard();
+            bump(shard.counters[static_cast<size_t>(counter)], amount);
+        }
+    }
+
+    static void record(Histogram histogram, uint64_t value)
+    {
+        if (enabled())
+        {
+            thisShard().histograms[static_cast<size_t>(histogram)].record(value);
+        }
+    }
+
+    // Timestamp counter where the CPU has one (rdtsc), nanoseconds otherwise
+    static uint64_t cycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Records the cycles of a scope into a time histogram
+    class Timer
+    {
+    public:
+        explicit Timer(Histogram histogram) : histogram_(histogram), start_(enabled() ? cycles() : 0) {}
+        ~Timer()
+        {
+            if (start_ != 0)
+            {
+                record(histogram_, cycles() - start_);
+            }
+        }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        Histogram histogram_;
+        uint64_t start_;
+    };
+
+    // Label the calling thread's shard in per-thread output
+    static void nameThread(const std::string &name);
+
+    // A spell of waiting for work: recorded in IdleTime and in the thread's own total
+    static void recordIdle(uint64_t idleCycles);
+
+    // Current totals in the given format
+    static std::string render(MetricsFormat format);
+
+    // Zero every shard; only while no thread is recording
+    static void reset();
+
+    // Sum of a counter, and the count and a quantile of a histogram (in its raw unit)
+    static uint64_t total(Counter counter);
+    static uint64_t count(Histogram histogram);
+    static uint64_t quantile(Histogram histogram, double q);
+
+    // Timer cycles per second, calibrated against the steady clock
+    static double cyclesPerSecond();
+
+private:
+    struct HistogramData
+    {
+        std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+
+        void record(uint64_t value)
+        {
+            bump(buckets[bucketOf(value)], 1);
+            bump(count, 1);
+            bump(sum, value);
+            if (value > max.load(std::memory_order_relaxed))
+            {
+                max.store(value, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // One thread's metrics; kept when the thread exits and handed to the next new one
+    struct Shard
+    {
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters{};
+        std::array<HistogramData, static_cast<size_t>(Histogram::Count)> histograms;
+        std::atomic<uint64_t> idleCycles{0};
+        std::string name; // Guarded by the registry mutex
+        bool inUse = false;
+    };
+
+    // Single writer per shard: a plain load and store, readable by snapshots
+    static void bump(std::atomic<uint64_t> &value, uint64_t amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static Shard &thisShard()
+    {
+        return shard_ ? *shard_ : attachShard();
+    }
+
+    static Shard &attachShard();
+
+    struct Registry; // Every shard, and snapshots over them (Metrics.cpp)
+
+    static std::atomic<bool> enabled_;
+    static thread_local Shard *shard_;
+};
+
+// Writes snapshots to a file every interval (and once more when stopped), or serves
+// the current snapshot to every client of a Unix socket ("unix:PATH")
+class MetricsReporter
+{
+public:
+    MetricsReporter(const std::string &target, MetricsFormat format, std::chrono::milliseconds interval);
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter &) = delete;
+    MetricsReporter &operator=(const MetricsReporter &) = delete;
+
+    // Stop the thread and write the final snapshot to a file target
+    void stop();
+
+    bool socket() const { return listenFd_ >= 0; }
+
+private:
+    void run();
+    void writeFile();
+
+    std::string path_;
+    MetricsFormat format_;
+    std::chrono::milliseconds interval_;
+    int listenFd_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+    std::thread thread_;
+};
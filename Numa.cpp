@@ -0,0 +1,166 @@
+// File: Numa.cpp
+#include "Numa.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(SYS_set_mempolicy) && __has_include(<linux/mempolicy.h>)
+#define NUMA_MEMPOLICY 1
+#include <linux/mempolicy.h>
+#endif
+
+namespace
+{
+    std::string readLine(const std::filesystem::path &path)
+    {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    std::vector<int> onlineCpus()
+    {
+        std::vector<int> cpus = NumaTopology::parseCpuList(readLine("/sys/devices/system/cpu/online"));
+        if (cpus.empty())
+        {
+            const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned cpu = 0; cpu < count; ++cpu)
+            {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+        return cpus;
+    }
+}
+
+std::vector<int> NumaTopology::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    size_t position = 0;
+    while (position < list.size())
+    {
+        size_t end = list.find(',', position);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        const std::string range = list.substr(position, end - position);
+        position = end + 1;
+        if (range.find_first_not_of(" \t\n") == std::string::npos)
+        {
+            continue;
+        }
+
+        const size_t dash = range.find('-');
+        try
+        {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            if (first < 0 || last < first)
+            {
+                throw std::invalid_argument(range);
+            }
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            throw std::runtime_error("Invalid CPU list: " + list);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology NumaTopology::detect()
+{
+    NumaTopology topology;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos)
+        {
+            continue;
+        }
+        std::vector<int> cpus = parseCpuList(readLine(entry.path() / "cpulist"));
+        if (!cpus.empty()) // Memory-only nodes get no workers
+        {
+            topology.nodes_.push_back(Node{std::stoi(name.substr(4)), std::move(cpus)});
+        }
+    }
+    std::sort(topology.nodes_.begin(), topology.nodes_.end(), [](const Node &a, const Node &b)
+              { return a.id < b.id; });
+
+    if (topology.nodes_.empty())
+    {
+        topology.nodes_.push_back(Node{0, onlineCpus()});
+    }
+    return topology;
+}
+
+NumaTopology NumaTopology::simulated(size_t nodes)
+{
+    if (nodes == 0)
+    {
+        throw std::runtime_error("A simulated NUMA topology needs at least one node");
+    }
+    const std::vector<int> cpus = onlineCpus();
+
+    NumaTopology topology;
+    topology.simulated_ = true;
+    for (size_t i = 0; i < nodes; ++i)
+    {
+        Node node{static_cast<int>(i), {}};
+        const size_t first = i * cpus.size() / nodes;
+        const size_t last = (i + 1) * cpus.size() / nodes;
+        if (first == last)
+        {
+            node.cpus.push_back(cpus[i % cpus.size()]);
+        }
+        else
+        {
+            node.cpus.assign(cpus.begin() + first, cpus.begin() + last);
+        }
+        topology.nodes_.push_back(std::move(node));
+    }
+    return topology;
+}
+
+void NumaTopology::bindThread(size_t index) const
+{
+    const Node &node = nodes_[index];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : node.cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+
+#ifdef NUMA_MEMPOLICY
+    // Preferred rather than bound: a full node falls back to the others instead of failing
+    if (!simulated_ && nodes_.size() > 1)
+    {
+        constexpr size_t kMaskBits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask(static_cast<size_t>(node.id) / kMaskBits + 1, 0);
+        mask[static_cast<size_t>(node.id) / kMaskBits] = 1ul << (static_cast<size_t>(node.id) % kMaskBits);
+        ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * kMaskBits + 1);
+    }
+#endif
+}
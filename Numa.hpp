@@ -0,0 +1,46 @@
+// File: Numa.hpp
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// NUMA nodes and the CPUs of each. A topology is read from sysfs, or simulated by
+// splitting the online CPUs into equal nodes so NUMA placement can be exercised on a
+// single-node machine. An empty topology means NUMA placement is off.
+class NumaTopology
+{
+public:
+    struct Node
+    {
+        int id;                // Kernel node id; simulated nodes count from 0
+        std::vector<int> cpus;
+    };
+
+    NumaTopology() = default;
+
+    // Nodes with CPUs under /sys/devices/system/node; one node of every online CPU
+    // where sysfs has no NUMA information
+    static NumaTopology detect();
+
+    // The online CPUs dealt into `nodes` contiguous groups; with fewer CPUs than
+    // nodes, nodes share CPUs. Memory is never bound for simulated nodes.
+    static NumaTopology simulated(size_t nodes);
+
+    // "0-3,8,10-11" as in sysfs cpulist files
+    static std::vector<int> parseCpuList(const std::string &list);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t size() const { return nodes_.size(); }
+    const Node &node(size_t index) const { return nodes_[index]; }
+    bool isSimulated() const { return simulated_; }
+
+    // Pin the calling thread to a node's CPUs and prefer that node's memory for its
+    // allocations, so buffers the thread first touches stay node-local. Best effort:
+    // a refused pin or policy leaves the thread where it was.
+    void bindThread(size_t index) const;
+
+private:
+    std::vector<Node> nodes_;
+    bool simulated_ = false;
+};
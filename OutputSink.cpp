@@ -0,0 +1,73 @@
+// File: OutputSink.cpp
+#include "OutputSink.hpp"
+#include "ColumnarFile.hpp"
+#include "TextFormat.hpp"
+#include <stdexcept>
+
+std::unique_ptr<OutputSink> OutputSink::open(const std::string &filename, OutputFormat format, bool directIo)
+{
+    const Compression compression = Codec::fromFilename(filename);
+    if (format == OutputFormat::Columnar)
+    {
+        // The columnar file is meant to be mapped and searched in place
+        if (compression != Compression::None)
+        {
+            throw std::runtime_error("Columnar output cannot be compressed: " + filename);
+        }
+        return std::make_unique<ColumnarSink>(filename, directIo);
+    }
+    return std::make_unique<TextSink>(filename, directIo, compression);
+}
+
+// TextSink implementation
+TextSink::TextSink(const std::string &filename, bool directIo, Compression compression, bool append)
+    : output_(filename, directIo, OutputWriter::kDefaultBufferSize, OutputWriter::kDefaultBufferCount, append),
+      symbols_(nullptr), append_(append)
+{
+    if (append && compression != Compression::None)
+    {
+        throw std::runtime_error("Compressed output cannot be appended to: " + filename);
+    }
+    if (compression != Compression::None)
+    {
+        compressor_ = std::make_unique<BlockCompressor>(output_, compression);
+    }
+}
+
+void TextSink::begin(const SymbolTable &symbols)
+{
+    symbols_ = &symbols;
+    if (append_)
+    {
+        return;
+    }
+    std::string &out = compressor_ ? compressor_->buffer() : output_.buffer();
+    out += "Symbol,Timestamp,Price,Size,Exchange,Type\n";
+}
+
+void TextSink::write(const MarketDataEntry *entries, size_t count)
+{
+    if (compressor_)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            TextFormat::appendEntry(compressor_->buffer(), entries[i], *symbols_);
+        }
+        compressor_->commit();
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        TextFormat::appendEntry(output_.buffer(), entries[i], *symbols_);
+        output_.commit();
+    }
+}
+
+void TextSink::finish()
+{
+    if (compressor_)
+    {
+        compressor_->close();
+    }
+    output_.close();
+}
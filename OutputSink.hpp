@@ -0,0 +1,56 @@
+// File: OutputSink.hpp
+#pragma once
+
+#include "Compression.hpp"
+#include "MarketDataEntry.hpp"
+#include "OutputWriter.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Encodings the merged output can be written in
+enum class OutputFormat
+{
+    Text,    // Symbol,Timestamp,Price,Size,Exchange,Type lines
+    Columnar // Fixed-width column blocks with a block time index (ColumnarFile.hpp)
+};
+
+// Destination of the merged rows. begin() comes first, then rows in merge order
+// in batches, then finish(), which throws if the output could not be completed.
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+
+    // Symbol dictionary the rows' symbol ids refer to
+    virtual void begin(const SymbolTable &symbols) = 0;
+
+    virtual void write(const MarketDataEntry *entries, size_t count) = 0;
+
+    virtual void finish() = 0;
+
+    // Open (and truncate) a file in the given format; text output to a .gz or .zst
+    // name is compressed
+    static std::unique_ptr<OutputSink> open(const std::string &filename, OutputFormat format,
+                                            bool directIo = false);
+};
+
+// CSV text through the buffer-swapping writer thread, optionally compressed in
+// parallel blocks (see BlockCompressor)
+class TextSink : public OutputSink
+{
+public:
+    // append continues an uncompressed file, header and all, after its last row
+    explicit TextSink(const std::string &filename, bool directIo = false,
+                      Compression compression = Compression::None, bool append = false);
+
+    void begin(const SymbolTable &symbols) override;
+    void write(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+private:
+    OutputWriter output_;
+    std::unique_ptr<BlockCompressor> compressor_;
+    const SymbolTable *symbols_;
+    bool append_;
+};
@@ -0,0 +1,237 @@
+// File: OutputWriter.cpp
+#include "OutputWriter.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    // Wait step for a ring that is momentarily empty or full: yield first, then
+    // sleep briefly so an idle side does not burn a core
+    void backoff(unsigned &spins)
+    {
+        if (++spins < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+OutputWriter::OutputWriter(const std::string &filename, bool directIo, size_t bufferSize, size_t bufferCount,
+                           bool append)
+    : filename_(filename), fd_(-1), direct_(false), bufferSize_(std::max<size_t>(bufferSize, 1)),
+      full_(bufferCount), empty_(bufferCount), closing_(false), error_(0),
+      staging_(nullptr, std::free), staged_(0), stagingSize_(0)
+{
+    const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+#ifdef O_DIRECT
+    if (directIo && !append)
+    {
+        fd_ = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+    }
+#else
+    (void)directIo;
+#endif
+    if (fd_ < 0)
+    {
+        fd_ = ::open(filename.c_str(), flags, 0644);
+    }
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("Failed to open output file: " + filename);
+    }
+
+    if (direct_)
+    {
+        // Room for a full buffer plus the unaligned tail carried from the previous one
+        stagingSize_ = (bufferSize_ + 2 * kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment;
+        void *memory = nullptr;
+        if (::posix_memalign(&memory, kDirectAlignment, stagingSize_) != 0)
+        {
+            ::close(fd_);
+            throw std::bad_alloc();
+        }
+        staging_.reset(static_cast<char *>(memory));
+    }
+
+    // One buffer is always being filled; the rest start on the empty ring
+    current_.reserve(bufferSize_ + 1024);
+    for (size_t i = 1; i < std::max<size_t>(bufferCount, 2); ++i)
+    {
+        std::string buffer;
+        buffer.reserve(bufferSize_ + 1024);
+        empty_.tryPush(std::move(buffer));
+    }
+    thread_ = std::thread(&OutputWriter::run, this);
+}
+
+OutputWriter::~OutputWriter()
+{
+    finish();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void OutputWriter::submit()
+{
+    if (error_.load(std::memory_order_relaxed) != 0)
+    {
+        throw std::system_error(error_.load(), std::generic_category(), "Failed to write output file: " + filename_);
+    }
+
+    // Swap in an emptied buffer; both rings have room for every buffer, so only
+    // the pop can wait, and only while the writer is behind
+    unsigned spins = 0;
+    std::string next;
+    if (!empty_.tryPop(next))
+    {
+        const uint64_t start = Metrics::cycles();
+        do
+        {
+            backoff(spins);
+        } while (!empty_.tryPop(next));
+        Metrics::add(Metrics::Counter::OutputWaits);
+        Metrics::record(Metrics::Histogram::OutputWaitTime, Metrics::cycles() - start);
+    }
+    while (!full_.tryPush(std::move(current_)))
+    {
+        backoff(spins);
+    }
+    current_ = std::move(next);
+}
+
+void OutputWriter::close()
+{
+    flush();
+    finish();
+
+    if (direct_ && staged_ > 0 && error_.load() == 0)
+    {
+        // The unaligned tail goes out through the page cache
+        int flags = ::fcntl(fd_, F_GETFL);
+#ifdef O_DIRECT
+        ::fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+#endif
+        writeAll(staging_.get(), staged_);
+        staged_ = 0;
+    }
+
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0 && error_.load() == 0)
+    {
+        error_.store(errno);
+    }
+    if (error_.load() != 0)
+    {
+        throw std::system_error(error_.load(), std::generic_category(), "Failed to write output file: " + filename_);
+    }
+}
+
+void OutputWriter::finish()
+{
+    if (thread_.joinable())
+    {
+        closing_.store(true, std::memory_order_release);
+        thread_.join();
+    }
+}
+
+void OutputWriter::run()
+{
+    if (Metrics::enabled())
+    {
+        Metrics::nameThread("writer");
+    }
+    unsigned spins = 0;
+    std::string buffer;
+    for (;;)
+    {
+        if (!full_.tryPop(buffer))
+        {
+            // Buffers pushed before closing_ was set are visible after reading it
+            if (!closing_.load(std::memory_order_acquire))
+            {
+                backoff(spins);
+                continue;
+            }
+            if (!full_.tryPop(buffer))
+            {
+                return;
+            }
+        }
+        spins = 0;
+
+        // After a failure buffers are still recycled so the producer never stalls
+        if (error_.load(std::memory_order_relaxed) == 0)
+        {
+            Metrics::Timer timer(Metrics::Histogram::WriteTime);
+            writeOut(buffer);
+        }
+        buffer.clear();
+        empty_.tryPush(std::move(buffer));
+    }
+}
+
+void OutputWriter::writeOut(const std::string &data)
+{
+    if (!direct_)
+    {
+        writeAll(data.data(), data.size());
+        return;
+    }
+
+    // O_DIRECT only takes whole aligned blocks from aligned memory
+    const char *next = data.data();
+    size_t remaining = data.size();
+    while (remaining > 0)
+    {
+        size_t count = std::min(remaining, stagingSize_ - staged_);
+        std::memcpy(staging_.get() + staged_, next, count);
+        staged_ += count;
+        next += count;
+        remaining -= count;
+
+        size_t aligned = staged_ - staged_ % kDirectAlignment;
+        if (aligned > 0)
+        {
+            writeAll(staging_.get(), aligned);
+            std::memmove(staging_.get(), staging_.get() + aligned, staged_ - aligned);
+            staged_ -= aligned;
+        }
+    }
+}
+
+void OutputWriter::writeAll(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t count = ::write(fd_, data, length);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            error_.store(errno);
+            return;
+        }
+        data += count;
+        length -= static_cast<size_t>(count);
+    }
+}
@@ -0,0 +1,80 @@
+// File: OutputWriter.hpp
+#pragma once
+
+#include "SpscRing.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Output file written by a dedicated thread. The producer formats rows into the
+// current buffer; full buffers are swapped over a lock-free ring to the writer,
+// which issues large write() calls and hands the emptied buffers back.
+class OutputWriter
+{
+public:
+    static constexpr size_t kDefaultBufferSize = 256 * 1024;
+    static constexpr size_t kDefaultBufferCount = 4;
+    static constexpr size_t kDirectAlignment = 4096; // O_DIRECT offset, length and address alignment
+
+    // Truncates the file, or with append writes after its current end. directIo asks
+    // for O_DIRECT, quietly falling back to buffered writes where the file system
+    // refuses it; appends are always buffered.
+    explicit OutputWriter(const std::string &filename, bool directIo = false,
+                          size_t bufferSize = kDefaultBufferSize, size_t bufferCount = kDefaultBufferCount,
+                          bool append = false);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+
+    // Buffer to append formatted rows to; call commit() after appending
+    std::string &buffer() { return current_; }
+
+    // Hand the buffer to the writer once it has filled up
+    void commit()
+    {
+        if (current_.size() >= bufferSize_)
+        {
+            submit();
+        }
+    }
+
+    // Hand over whatever has been appended, without waiting for a full buffer
+    void flush()
+    {
+        if (!current_.empty())
+        {
+            submit();
+        }
+    }
+
+    // Write out everything appended so far, stop the writer and close the file;
+    // throws if any write failed
+    void close();
+
+    // Whether writes bypass the page cache
+    bool direct() const { return direct_; }
+
+private:
+    void submit();
+    void run();
+    void writeOut(const std::string &data);
+    void writeAll(const char *data, size_t length);
+    void finish();
+
+    std::string filename_;
+    int fd_;
+    bool direct_;
+    size_t bufferSize_;
+    std::string current_;
+    SpscRing<std::string> full_;  // Producer to writer
+    SpscRing<std::string> empty_; // Writer back to producer
+    std::atomic<bool> closing_;
+    std::atomic<int> error_; // First errno seen by the writer
+    std::unique_ptr<char, void (*)(void *)> staging_; // Aligned O_DIRECT staging area
+    size_t staged_;
+    size_t stagingSize_;
+    std::thread thread_;
+};
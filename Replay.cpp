@@ -0,0 +1,225 @@
+// File: Replay.cpp
+#include "Replay.hpp"
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    std::string formatNanos(uint64_t nanos)
+    {
+        char text[32];
+        if (nanos < 1000)
+        {
+            std::snprintf(text, sizeof(text), "%lluns", static_cast<unsigned long long>(nanos));
+        }
+        else if (nanos < 1000000)
+        {
+            std::snprintf(text, sizeof(text), "%.1fus", nanos / 1e3);
+        }
+        else
+        {
+            std::snprintf(text, sizeof(text), "%.1fms", nanos / 1e6);
+        }
+        return text;
+    }
+}
+
+// LatencyHistogram implementation
+uint64_t LatencyHistogram::quantile(double q) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets_.size(); ++bucket)
+    {
+        seen += buckets_[bucket];
+        if (seen > rank)
+        {
+            return Metrics::bucketFloor(bucket);
+        }
+    }
+    return max_;
+}
+
+std::string LatencyHistogram::summary() const
+{
+    if (count_ == 0)
+    {
+        return "none";
+    }
+    return "p50 " + formatNanos(quantile(0.5)) + " p99 " + formatNanos(quantile(0.99)) + " p99.9 " +
+           formatNanos(quantile(0.999)) + " max " + formatNanos(max_);
+}
+
+// ReplaySink implementation
+ReplaySink::ReplaySink(const ReplayOptions &options, OutputSink *inner)
+    : options_(options), inner_(inner), ringCapacity_(0), ringAttachTimeout_(0), started_(false), startNanos_(0), firstTimestamp_(0)
+{
+    if (options.speed < 0)
+    {
+        throw std::runtime_error("Replay speed must be positive, or 0 for as fast as possible");
+    }
+}
+
+ReplaySink::~ReplaySink() = default;
+
+void ReplaySink::subscribe(Callback callback)
+{
+    callbacks_.push_back(std::move(callback));
+}
+
+void ReplaySink::publishToRing(const std::string &name, size_t capacity, std::chrono::milliseconds attachTimeout)
+{
+    ringName_ = ShmRing::segmentName(name);
+    ringCapacity_ = capacity;
+    ringAttachTimeout_ = attachTimeout;
+}
+
+int64_t ReplaySink::nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ReplaySink::begin(const SymbolTable &symbols)
+{
+    if (inner_)
+    {
+        inner_->begin(symbols);
+    }
+    if (!ringName_.empty())
+    {
+        ring_ = std::make_unique<ShmRing>(ringName_, ringCapacity_, symbols);
+        ring_->waitForConsumer(ringAttachTimeout_);
+    }
+}
+
+void ReplaySink::write(const MarketDataEntry *entries, size_t count)
+{
+    size_t first = 0;
+    if (!group_.empty())
+    {
+        while (first < count && entries[first].timestamp == group_.front().timestamp)
+        {
+            ++first;
+        }
+        group_.insert(group_.end(), entries, entries + first);
+        if (first < count)
+        {
+            publish(group_.data(), group_.size());
+            group_.clear();
+        }
+    }
+    while (first < count)
+    {
+        size_t last = first + 1;
+        while (last < count && entries[last].timestamp == entries[first].timestamp)
+        {
+            ++last;
+        }
+        if (last == count)
+        {
+            // The next call may hold more rows of this timestamp
+            group_.assign(entries + first, entries + count);
+        }
+        else
+        {
+            publish(entries + first, last - first);
+        }
+        first = last;
+    }
+
+    // The file copy comes after the rows went out, off the latency path
+    if (inner_)
+    {
+        inner_->write(entries, count);
+    }
+}
+
+void ReplaySink::finish()
+{
+    if (!group_.empty())
+    {
+        publish(group_.data(), group_.size());
+        group_.clear();
+    }
+    if (ring_)
+    {
+        ring_->close();
+        stats_.ringFullWaits = ring_->fullWaits();
+    }
+    if (inner_)
+    {
+        inner_->finish();
+    }
+}
+
+void ReplaySink::publish(const MarketDataEntry *entries, size_t count)
+{
+    int64_t now = nowNanos();
+    if (options_.speed > 0)
+    {
+        if (!started_)
+        {
+            started_ = true;
+            startNanos_ = now;
+            firstTimestamp_ = entries[0].timestamp;
+        }
+        const int64_t due = startNanos_ + static_cast<int64_t>(static_cast<double>(entries[0].timestamp - firstTimestamp_) / options_.speed);
+        if (now < due)
+        {
+            waitUntil(due);
+            now = nowNanos();
+            stats_.jitter.record(static_cast<uint64_t>(now - due));
+            Metrics::record(Metrics::Histogram::ReplayJitter, static_cast<uint64_t>(now - due));
+        }
+        else
+        {
+            stats_.lag.record(static_cast<uint64_t>(now - due));
+            Metrics::record(Metrics::Histogram::ReplayLag, static_cast<uint64_t>(now - due));
+        }
+    }
+
+    for (auto &callback : callbacks_)
+    {
+        callback(entries, count);
+    }
+    if (ring_)
+    {
+        ring_->push(entries, count, now);
+    }
+    stats_.rows += count;
+    ++stats_.groups;
+    Metrics::add(Metrics::Counter::RowsReplayed, count);
+}
+
+void ReplaySink::waitUntil(int64_t due) const
+{
+    if (options_.pacing == ReplayPacing::Hybrid)
+    {
+        // The sleep is cut short by spinNanos so that the wake-up's own delay lands
+        // inside the spin, which then hits the row's time precisely
+        const int64_t remaining = due - nowNanos();
+        if (remaining > options_.spinNanos)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - options_.spinNanos));
+        }
+    }
+    while (nowNanos() < due)
+    {
+        cpuRelax();
+    }
+}
@@ -0,0 +1,118 @@
+// File: Replay.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include "Metrics.hpp"
+#include "OutputSink.hpp"
+#include "ShmRing.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How a replay waits for a row's time
+enum class ReplayPacing
+{
+    BusyPoll, // Spin on the clock: lowest jitter, one core at 100%
+    Hybrid    // Sleep until spinNanos before the row's time, then spin
+};
+
+struct ReplayOptions
+{
+    double speed = 1.0; // Multiple of the recorded pace; 0 replays as fast as possible
+    ReplayPacing pacing = ReplayPacing::Hybrid;
+    int64_t spinNanos = 200000; // Hybrid: how early to stop sleeping (covers the scheduler's wake-up)
+};
+
+// Nanosecond histogram over the Metrics log-linear buckets
+class LatencyHistogram
+{
+public:
+    void record(uint64_t nanos)
+    {
+        ++buckets_[Metrics::bucketOf(nanos)];
+        ++count_;
+        max_ = std::max(max_, nanos);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+
+    // Lower bound of the bucket holding quantile q
+    uint64_t quantile(double q) const;
+
+    // "p50 1.2us p99 3.4us p99.9 8us max 12us" (or "none")
+    std::string summary() const;
+
+private:
+    std::array<uint64_t, Metrics::kBuckets> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+// What a replay did. A row is due at the replay's start plus its time since the first
+// row, divided by the speed. Rows the replay had to wait for measure the scheduler
+// (jitter: published minus due); rows that were already due when the merge handed them
+// over measure the pipeline falling behind (lag).
+struct ReplayStats
+{
+    uint64_t rows = 0;
+    uint64_t groups = 0; // Publications: rows sharing a timestamp go out together
+    LatencyHistogram jitter;
+    LatencyHistogram lag;
+    uint64_t ringFullWaits = 0;
+};
+
+// Sink that publishes the merged rows at their recorded pace: to in-process callbacks,
+// to a shared-memory ring for another process, and on to an inner sink (the output
+// file) when one is given. Pacing runs on the final merge's thread, so a replay holds
+// the merge back rather than buffering ahead of it.
+class ReplaySink : public OutputSink
+{
+public:
+    // All the rows of one timestamp, however the merge batched them; valid for the
+    // duration of the call
+    using Callback = std::function<void(const MarketDataEntry *entries, size_t count)>;
+
+    explicit ReplaySink(const ReplayOptions &options, OutputSink *inner = nullptr);
+    ~ReplaySink() override;
+
+    // Called on the merge's thread for every publication; register before the merge
+    void subscribe(Callback callback);
+
+    // Publish to a ShmRing of this name, created when the merge begins; the replay
+    // starts once a consumer has attached, and the merge fails if none does in time
+    void publishToRing(const std::string &name, size_t capacity = ShmRing::kDefaultCapacity,
+                       std::chrono::milliseconds attachTimeout = ShmRing::kDefaultAttachTimeout);
+
+    void begin(const SymbolTable &symbols) override;
+    void write(const MarketDataEntry *entries, size_t count) override;
+    void finish() override;
+
+    const ReplayStats &stats() const { return stats_; }
+
+    // Steady-clock nanoseconds, the time base of publishedNanos
+    static int64_t nowNanos();
+
+private:
+    void publish(const MarketDataEntry *entries, size_t count);
+    void waitUntil(int64_t due) const;
+
+    ReplayOptions options_;
+    OutputSink *inner_;
+    std::vector<Callback> callbacks_;
+    std::string ringName_;
+    size_t ringCapacity_;
+    std::chrono::milliseconds ringAttachTimeout_;
+    std::unique_ptr<ShmRing> ring_;
+    std::vector<MarketDataEntry> group_; // Last timestamp's rows so far, published once it changes
+    bool started_;
+    int64_t startNanos_;    // Wall time of the first row
+    int64_t firstTimestamp_; // Recorded time of the first row
+    ReplayStats stats_;
+};
@@ -0,0 +1,287 @@
+// File: ShmRing.cpp
+#include "ShmRing.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr uint64_t kMagic = 0x676e69722d66646dull; // "mdf-ring"
+    constexpr uint32_t kVersion = 2;
+    constexpr uint32_t kAttached = 1;
+    constexpr uint32_t kClosed = 2;
+    constexpr uint32_t kDetached = 4;
+
+    // Full-ring spins between checks that the consumer is still there
+    constexpr unsigned kLivenessSpins = 16 * 1024;
+
+    inline void cpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+struct ShmRing::Header
+{
+    std::atomic<uint64_t> magic; // Stored last by the producer: the rest is in place
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t capacity;
+    uint64_t namesOffset; // Symbol names, one per line, in id order
+    uint64_t namesBytes;
+    uint64_t slotsOffset;
+    alignas(64) std::atomic<uint64_t> head; // Written by the producer only
+    alignas(64) std::atomic<uint64_t> tail; // Written by the consumer only
+    alignas(64) std::atomic<uint32_t> state;
+    std::atomic<int32_t> consumerPid; // Stored before kAttached is set
+};
+
+std::string ShmRing::segmentName(const std::string &name)
+{
+    if (name.empty() || name.find('/', 1) != std::string::npos)
+    {
+        throw std::runtime_error("Invalid shared memory ring name: " + name);
+    }
+    return name[0] == '/' ? name : "/" + name;
+}
+
+// ShmRing implementation
+ShmRing::ShmRing(const std::string &name, size_t capacity, const SymbolTable &symbols)
+    : name_(segmentName(name)), header_(nullptr), slots_(nullptr), mappedBytes_(0), mask_(0), head_(0),
+      cachedTail_(0), fullWaits_(0)
+{
+    size_t slots = 1;
+    while (slots < std::max<size_t>(capacity, 2))
+    {
+        slots *= 2;
+    }
+    std::string names;
+    for (size_t id = 0; id < symbols.size(); ++id)
+    {
+        names += symbols.name(static_cast<uint32_t>(id));
+        names += '\n';
+    }
+    const size_t namesOffset = alignUp(sizeof(Header), 64);
+    const size_t slotsOffset = alignUp(namesOffset + names.size(), 64);
+    mappedBytes_ = slotsOffset + slots * sizeof(Slot);
+
+    ::shm_unlink(name_.c_str());
+    const int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Failed to create shared memory ring " + name_);
+    }
+    void *mapping = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(mappedBytes_)) == 0)
+    {
+        mapping = ::mmap(nullptr, mappedBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        ::shm_unlink(name_.c_str());
+        throw std::system_error(error, std::generic_category(), "Failed to map shared memory ring " + name_);
+    }
+
+    // The segment starts zeroed, so the atomics begin at 0
+    header_ = static_cast<Header *>(mapping);
+    header_->version = kVersion;
+    header_->slotSize = sizeof(Slot);
+    header_->capacity = slots;
+    header_->namesOffset = namesOffset;
+    header_->namesBytes = names.size();
+    header_->slotsOffset = slotsOffset;
+    std::memcpy(static_cast<char *>(mapping) + namesOffset, names.data(), names.size());
+    slots_ = reinterpret_cast<Slot *>(static_cast<char *>(mapping) + slotsOffset);
+    mask_ = slots - 1;
+    header_->magic.store(kMagic, std::memory_order_release);
+}
+
+ShmRing::~ShmRing()
+{
+    close();
+    ::munmap(header_, mappedBytes_);
+    ::shm_unlink(name_.c_str());
+}
+
+void ShmRing::waitForConsumer(std::chrono::milliseconds timeout) const
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!(header_->state.load(std::memory_order_acquire) & kAttached))
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            throw std::runtime_error("No consumer attached to shared memory ring " + name_);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool ShmRing::consumerGone() const
+{
+    const uint32_t state = header_->state.load(std::memory_order_acquire);
+    if (!(state & kAttached))
+    {
+        return false;
+    }
+    // EPERM means the process exists but belongs to another user
+    const pid_t pid = header_->consumerPid.load(std::memory_order_relaxed);
+    return (state & kDetached) || (::kill(pid, 0) != 0 && errno == ESRCH);
+}
+
+void ShmRing::push(const MarketDataEntry *entries, size_t count, int64_t publishedNanos)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (head_ - cachedTail_ > mask_)
+        {
+            cachedTail_ = header_->tail.load(std::memory_order_acquire);
+            if (head_ - cachedTail_ > mask_)
+            {
+                // Let the consumer at what is written so far, then wait for room
+                header_->head.store(head_, std::memory_order_release);
+                ++fullWaits_;
+                unsigned spins = 0;
+                do
+                {
+                    cpuRelax();
+                    if (++spins % kLivenessSpins == 0 && consumerGone())
+                    {
+                        throw std::runtime_error("Consumer of shared memory ring " + name_ + " went away");
+                    }
+                    cachedTail_ = header_->tail.load(std::memory_order_acquire);
+                } while (head_ - cachedTail_ > mask_);
+            }
+        }
+        Slot &slot = slots_[head_ & mask_];
+        slot.entry = entries[i];
+        slot.publishedNanos = publishedNanos;
+        ++head_;
+    }
+    header_->head.store(head_, std::memory_order_release);
+}
+
+void ShmRing::close()
+{
+    header_->head.store(head_, std::memory_order_release);
+    header_->state.fetch_or(kClosed, std::memory_order_release);
+}
+
+// ShmRingReader implementation
+ShmRingReader::ShmRingReader(const std::string &name, std::chrono::milliseconds timeout)
+    : header_(nullptr), slots_(nullptr), mappedBytes_(0), mask_(0), tail_(0), cachedHead_(0)
+{
+    const std::string segment = ShmRing::segmentName(name);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    // The producer may not have created (or finished setting up) the segment yet
+    for (;;)
+    {
+        const int fd = ::shm_open(segment.c_str(), O_RDWR, 0);
+        struct stat status;
+        if (fd >= 0 && ::fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(ShmRing::Header))
+        {
+            void *mapping = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                throw std::system_error(errno, std::generic_category(), "Failed to map shared memory ring " + segment);
+            }
+            header_ = static_cast<ShmRing::Header *>(mapping);
+            mappedBytes_ = static_cast<size_t>(status.st_size);
+            if (header_->magic.load(std::memory_order_acquire) == kMagic)
+            {
+                break;
+            }
+            ::munmap(mapping, mappedBytes_);
+            header_ = nullptr;
+        }
+        else if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            throw std::runtime_error("Shared memory ring " + segment + " did not appear");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (header_->version != kVersion || header_->slotSize != sizeof(ShmRing::Slot))
+    {
+        ::munmap(header_, mappedBytes_);
+        throw std::runtime_error("Shared memory ring " + segment + " has an incompatible layout");
+    }
+    const char *base = reinterpret_cast<const char *>(header_);
+    std::vector<std::string> names;
+    const char *cursor = base + header_->namesOffset;
+    const char *namesEnd = cursor + header_->namesBytes;
+    while (cursor < namesEnd)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', static_cast<size_t>(namesEnd - cursor)));
+        names.emplace_back(cursor, newline ? newline : namesEnd);
+        cursor = newline ? newline + 1 : namesEnd;
+    }
+    symbols_ = SymbolTable(std::move(names));
+    slots_ = reinterpret_cast<const ShmRing::Slot *>(base + header_->slotsOffset);
+    mask_ = header_->capacity - 1;
+    tail_ = header_->tail.load(std::memory_order_relaxed);
+    header_->consumerPid.store(static_cast<int32_t>(::getpid()), std::memory_order_relaxed);
+    header_->state.fetch_or(kAttached, std::memory_order_release);
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    header_->state.fetch_or(kDetached, std::memory_order_release);
+    ::munmap(header_, mappedBytes_);
+}
+
+size_t ShmRingReader::read(ShmRing::Slot *out, size_t max)
+{
+    if (cachedHead_ == tail_)
+    {
+        cachedHead_ = header_->head.load(std::memory_order_acquire);
+    }
+    const size_t count = static_cast<size_t>(std::min<uint64_t>(cachedHead_ - tail_, max));
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = slots_[(tail_ + i) & mask_];
+    }
+    tail_ += count;
+    if (count > 0)
+    {
+        header_->tail.store(tail_, std::memory_order_release);
+    }
+    return count;
+}
+
+bool ShmRingReader::finished()
+{
+    // Closed is set after the last head store, so a head read after it is final
+    if (!(header_->state.load(std::memory_order_acquire) & kClosed))
+    {
+        return false;
+    }
+    cachedHead_ = header_->head.load(std::memory_order_acquire);
+    return cachedHead_ == tail_;
+}
@@ -0,0 +1,102 @@
+// File: ShmRing.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Single-producer single-consumer ring of merged rows in POSIX shared memory, for a
+// consumer in another local process. The segment ("/name") holds a header, the
+// merge's symbol names and the slots. Head and tail sit on cache lines of their own,
+// and each side caches the other's index, so the shared lines are only touched when
+// the ring looks full or empty. Neither side makes a system call per row. The consumer
+// records its pid, so a producer waiting for room notices when it exits or dies.
+class ShmRing
+{
+public:
+    // A row and when it was published, in steady-clock nanoseconds (CLOCK_MONOTONIC,
+    // which both processes share)
+    struct Slot
+    {
+        MarketDataEntry entry;
+        int64_t publishedNanos;
+    };
+
+    struct Header;
+
+    static constexpr size_t kDefaultCapacity = 64 * 1024;
+    static constexpr std::chrono::milliseconds kDefaultAttachTimeout{60000};
+
+    // Create the segment (replacing a stale one of the same name) with room for
+    // capacity slots, rounded up to a power of two; throws on failure
+    ShmRing(const std::string &name, size_t capacity, const SymbolTable &symbols);
+    ~ShmRing();
+
+    ShmRing(const ShmRing &) = delete;
+    ShmRing &operator=(const ShmRing &) = delete;
+
+    // Block until a consumer has attached; throws if none does within timeout
+    void waitForConsumer(std::chrono::milliseconds timeout) const;
+
+    // Append rows, spinning while the ring is full; the consumer sees them all at once
+    // unless they do not fit. Throws if the consumer detaches or dies while the ring is full.
+    void push(const MarketDataEntry *entries, size_t count, int64_t publishedNanos);
+
+    // Tell the consumer no more rows follow. The segment's name is removed on
+    // destruction; an attached consumer keeps its mapping.
+    void close();
+
+    // Times push() found the ring full
+    uint64_t fullWaits() const { return fullWaits_; }
+
+    // "/name" for a name given with or without its slash
+    static std::string segmentName(const std::string &name);
+
+private:
+    bool consumerGone() const;
+
+    std::string name_;
+    Header *header_;
+    Slot *slots_;
+    size_t mappedBytes_;
+    uint64_t mask_;
+    uint64_t head_;       // Next slot to write; published to the header after each push
+    uint64_t cachedTail_; // Consumer's tail as last read
+    uint64_t fullWaits_;
+};
+
+// Consumer side of a ShmRing
+class ShmRingReader
+{
+public:
+    // Attach to a segment, waiting up to timeout for the producer to create it; throws
+    // if it does not appear
+    ShmRingReader(const std::string &name, std::chrono::milliseconds timeout);
+
+    // Detach, so that a producer waiting for room gives up
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader &) = delete;
+    ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+    // The producer's symbols; entries' symbolId index them
+    const SymbolTable &symbols() const { return symbols_; }
+
+    // Copy up to max published slots out of the ring without waiting; 0 when it is empty
+    size_t read(ShmRing::Slot *out, size_t max);
+
+    // Whether the producer closed the ring and every row has been read
+    bool finished();
+
+private:
+    ShmRing::Header *header_;
+    const ShmRing::Slot *slots_;
+    size_t mappedBytes_;
+    uint64_t mask_;
+    uint64_t tail_;
+    uint64_t cachedHead_;
+    SymbolTable symbols_;
+};
@@ -0,0 +1,147 @@
+// File: TextFormat.cpp
+#include "TextFormat.hpp"
+
+namespace
+{
+    // Write value as exactly width digits, zero padded
+    inline char *writePadded(char *out, uint64_t value, int width)
+    {
+        for (int i = width - 1; i >= 0; --i)
+        {
+            out[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        return out + width;
+    }
+
+    inline char *writeUnsigned(char *out, uint64_t value)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count > 0)
+        {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+}
+
+size_t TextFormat::formatTimestamp(int64_t nanos, char *out)
+{
+    const int64_t nanosPerDay = int64_t(86400) * 1000000000;
+    int64_t days = nanos / nanosPerDay;
+    int64_t rest = nanos % nanosPerDay;
+    if (rest < 0)
+    {
+        rest += nanosPerDay;
+        --days;
+    }
+
+    // Civil date from days since 1970-01-01 (Hinnant's civil_from_days)
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int64_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+
+    int64_t seconds = rest / 1000000000;
+    int64_t fraction = rest % 1000000000;
+
+    char *p = out;
+    p = writePadded(p, static_cast<uint64_t>(year), 4);
+    *p++ = '-';
+    p = writePadded(p, static_cast<uint64_t>(month), 2);
+    *p++ = '-';
+    p = writePadded(p, static_cast<uint64_t>(day), 2);
+    *p++ = ' ';
+    p = writePadded(p, static_cast<uint64_t>(seconds / 3600), 2);
+    *p++ = ':';
+    p = writePadded(p, static_cast<uint64_t>(seconds / 60 % 60), 2);
+    *p++ = ':';
+    p = writePadded(p, static_cast<uint64_t>(seconds % 60), 2);
+    *p++ = '.';
+    if (fraction % 1000000 == 0)
+    {
+        p = writePadded(p, static_cast<uint64_t>(fraction / 1000000), 3);
+    }
+    else if (fraction % 1000 == 0)
+    {
+        p = writePadded(p, static_cast<uint64_t>(fraction / 1000), 6);
+    }
+    else
+    {
+        p = writePadded(p, static_cast<uint64_t>(fraction), 9);
+    }
+    return static_cast<size_t>(p - out);
+}
+
+size_t TextFormat::formatFixed(int64_t value, int digits, char *out)
+{
+    char *p = out;
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0)
+    {
+        *p++ = '-';
+        magnitude = ~magnitude + 1;
+    }
+
+    uint64_t scale = 1;
+    for (int i = 0; i < digits; ++i)
+    {
+        scale *= 10;
+    }
+    p = writeUnsigned(p, magnitude / scale);
+
+    uint64_t fraction = magnitude % scale;
+    if (fraction != 0)
+    {
+        int width = digits;
+        while (fraction % 10 == 0)
+        {
+            fraction /= 10;
+            --width;
+        }
+        *p++ = '.';
+        p = writePadded(p, fraction, width);
+    }
+    return static_cast<size_t>(p - out);
+}
+
+size_t TextFormat::formatInt(int64_t value, char *out)
+{
+    char *p = out;
+    uint64_t magnitude = static_cast<uint64_t>(value);
+    if (value < 0)
+    {
+        *p++ = '-';
+        magnitude = ~magnitude + 1;
+    }
+    return static_cast<size_t>(writeUnsigned(p, magnitude) - out);
+}
+
+void TextFormat::appendEntry(std::string &out, const MarketDataEntry &entry, const SymbolTable &symbols)
+{
+    char field[kMaxFieldLength];
+
+    out += symbols.name(entry.symbolId);
+    out += ',';
+    out.append(field, formatTimestamp(entry.timestamp, field));
+    out += ',';
+    out.append(field, formatFixed(entry.price, MarketDataEntry::kPriceDigits, field));
+    out += ',';
+    out.append(field, formatInt(entry.size, field));
+    out += ',';
+    out += ExchangeTable::name(entry.exchange);
+    out += ',';
+    out += sideName(entry.side);
+    out += '\n';
+}
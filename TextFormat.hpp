@@ -0,0 +1,26 @@
+// File: TextFormat.hpp
+#pragma once
+
+#include "MarketDataEntry.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hand-rolled rendering of packed entries back to the text output format
+class TextFormat
+{
+public:
+    // Longest output of formatTimestamp / formatFixed / formatInt
+    static constexpr size_t kMaxFieldLength = 32;
+
+    // "YYYY-MM-DD HH:MM:SS.fff", with 6 or 9 decimals when the value needs them
+    static size_t formatTimestamp(int64_t nanos, char *out);
+
+    // Fixed-point value without trailing zeros ("228.5", "100")
+    static size_t formatFixed(int64_t value, int digits, char *out);
+
+    static size_t formatInt(int64_t value, char *out);
+
+    // Append "Symbol,Timestamp,Price,Size,Exchange,Type\n" for an entry
+    static void appendEntry(std::string &out, const MarketDataEntry &entry, const SymbolTable &symbols);
+};
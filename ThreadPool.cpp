@@ -0,0 +1,305 @@
+// File: ThreadPool.cpp
+#include "ThreadPool.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+    // Pool and worker index of the current thread, when it is a pool worker
+    thread_local ThreadPool *t_pool = nullptr;
+    thread_local size_t t_worker = 0;
+}
+
+// ThreadPool implementation
+ThreadPool::ThreadPool(size_t threads)
+    : queued_(0), nextWorker_(0), stopping_(false)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nodeWorkers_.resize(1);
+    start(threads);
+}
+
+ThreadPool::ThreadPool(const NumaTopology &topology, size_t threads)
+    : topology_(topology), queued_(0), nextWorker_(0), stopping_(false)
+{
+    if (topology_.empty())
+    {
+        throw std::runtime_error("A NUMA thread pool needs a topology with nodes");
+    }
+    if (threads == 0)
+    {
+        for (size_t node = 0; node < topology_.size(); ++node)
+        {
+            threads += topology_.node(node).cpus.size();
+        }
+    }
+    // Every node needs a worker, or its pinned tasks would never run
+    nodeWorkers_.resize(topology_.size());
+    start(std::max(threads, topology_.size()));
+}
+
+void ThreadPool::start(size_t threads)
+{
+    pinnedQueued_ = std::make_unique<std::atomic<size_t>[]>(nodeWorkers_.size());
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_.back()->node = i % nodeWorkers_.size();
+        nodeWorkers_[workers_.back()->node].push_back(i);
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::currentNode()
+{
+    return t_pool ? t_pool->workers_[t_worker]->node : kAnyNode;
+}
+
+void ThreadPool::submit(std::function<void()> task, size_t node)
+{
+    // Without a topology every worker is on the same node
+    if (node == kAnyNode || topology_.empty())
+    {
+        // Workers keep their own tasks local; others spread them round-robin
+        size_t index = t_pool == this ? t_worker : nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        {
+            std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+            workers_[index]->tasks.push_back(std::move(task));
+        }
+        queued_.fetch_add(1);
+
+        // Taking the lock orders the count against a worker about to sleep
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wake_.notify_one();
+        return;
+    }
+
+    node %= nodeWorkers_.size();
+    const std::vector<size_t> &local = nodeWorkers_[node];
+    size_t index = t_pool == this && workers_[t_worker]->node == node
+                       ? t_worker
+                       : local[nextWorker_.fetch_add(1, std::memory_order_relaxed) % local.size()];
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->pinned.push_back(std::move(task));
+    }
+    pinnedQueued_[node].fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wake_.notify_all(); // notify_one could pick a worker of another node
+}
+
+void ThreadPool::notifyAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wake_.notify_all();
+}
+
+bool ThreadPool::hasWork(size_t index) const
+{
+    return queued_.load() > 0 || (index < workers_.size() && pinnedQueued_[workers_[index]->node].load() > 0);
+}
+
+bool ThreadPool::take(size_t index, std::function<void()> &task)
+{
+    if (!hasWork(index))
+    {
+        return false;
+    }
+
+    // Own deque from the back, then steal from the front of the others: pinned and
+    // free tasks on the same node first, free tasks of other nodes last
+    const size_t count = workers_.size();
+    const bool worker = index < count;
+    const size_t node = worker ? workers_[index]->node : kAnyNode;
+    if (worker)
+    {
+        Worker &own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.pinned.empty())
+        {
+            task = std::move(own.pinned.back());
+            own.pinned.pop_back();
+            pinnedQueued_[node].fetch_sub(1);
+            return true;
+        }
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    for (bool sameNode : {true, false})
+    {
+        for (size_t offset = 1; offset <= count; ++offset)
+        {
+            Worker &victim = *workers_[(index + offset) % count];
+            if ((victim.node == node) != sameNode)
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (sameNode && !victim.pinned.empty())
+            {
+                task = std::move(victim.pinned.front());
+                victim.pinned.pop_front();
+                pinnedQueued_[node].fetch_sub(1);
+                return true;
+            }
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued_.fetch_sub(1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(size_t index)
+{
+    t_pool = this;
+    t_worker = index;
+    if (!topology_.empty())
+    {
+        topology_.bindThread(workers_[index]->node);
+    }
+    if (Metrics::enabled())
+    {
+        Metrics::nameThread("worker-" + std::to_string(index));
+    }
+
+    std::function<void()> task;
+    for (;;)
+    {
+        if (take(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        const uint64_t idleStart = Metrics::enabled() ? Metrics::cycles() : 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, index]()
+                   { return stopping_ || hasWork(index); });
+        if (idleStart != 0)
+        {
+            Metrics::recordIdle(Metrics::cycles() - idleStart);
+        }
+        if (stopping_ && !hasWork(index))
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::helpUntil(const std::function<bool()> &done)
+{
+    // Callers from outside the pool steal from every deque
+    const size_t index = t_pool == this ? t_worker : workers_.size();
+
+    std::function<void()> task;
+    while (!done())
+    {
+        if (take(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        // Nothing to steal: the remaining work is running elsewhere
+        const uint64_t idleStart = Metrics::enabled() ? Metrics::cycles() : 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait_for(lock, std::chrono::milliseconds(1), [this, index, &done]()
+                       { return hasWork(index) || done(); });
+        if (idleStart != 0)
+        {
+            Metrics::recordIdle(Metrics::cycles() - idleStart);
+        }
+    }
+}
+
+// TaskGroup implementation
+TaskGroup::~TaskGroup()
+{
+    pool_.helpUntil([this]()
+                    { return pending_.load() == 0; });
+}
+
+void TaskGroup::run(std::function<void()> task, size_t node)
+{
+    pending_.fetch_add(1);
+    pool_.submit([this, &pool = pool_, task = std::move(task)]()
+                 {
+                     try
+                     {
+                         task();
+                     }
+                     catch (...)
+                     {
+                         std::lock_guard<std::mutex> lock(errorMutex_);
+                         if (!error_)
+                         {
+                             error_ = std::current_exception();
+                         }
+                         failed_.store(true);
+                     }
+                     // The group may be gone once the count drops, so only the pool is touched after
+                     if (pending_.fetch_sub(1) == 1)
+                     {
+                         pool.notifyAll();
+                     } },
+                 node);
+}
+
+void TaskGroup::wait()
+{
+    pool_.helpUntil([this]()
+                    { return pending_.load() == 0; });
+
+    std::lock_guard<std::mutex> lock(errorMutex_);
+    if (error_)
+    {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,114 @@
+// File: ThreadPool.hpp
+#pragma once
+
+#include "Numa.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker pushes
+// and pops at the back of its deque (newest first, still warm in cache) and,
+// when it runs dry, steals the oldest task from the front of another's.
+//
+// A pool built over a NUMA topology pins its workers to their nodes' CPUs. Tasks
+// submitted for a node run only on that node's workers; other tasks are stolen
+// within a node first and across nodes last.
+class ThreadPool
+{
+public:
+    static constexpr size_t kAnyNode = static_cast<size_t>(-1);
+
+    // threads == 0 sizes the pool to the hardware
+    explicit ThreadPool(size_t threads = 0);
+
+    // Workers spread evenly over the topology's nodes; threads == 0 gives each node
+    // one worker per CPU
+    ThreadPool(const NumaTopology &topology, size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // NUMA nodes the workers are spread over; 1 without a topology
+    size_t nodes() const { return nodeWorkers_.size(); }
+
+    // Queue a task, for any worker or for one on the given node; tasks must not
+    // throw (TaskGroup wraps them)
+    void submit(std::function<void()> task, size_t node = kAnyNode);
+
+    // Run queued tasks on the calling thread until done() holds
+    void helpUntil(const std::function<bool()> &done);
+
+    // Wake threads blocked in helpUntil() to re-check their condition
+    void notifyAll();
+
+    // Process-wide pool shared by merges that do not ask for their own
+    static ThreadPool &shared();
+
+    // NUMA node of the calling pool worker; kAnyNode on other threads
+    static size_t currentNode();
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::deque<std::function<void()>> pinned; // Only for workers of the same node
+        size_t node = 0;
+    };
+
+    void start(size_t threads);
+    void run(size_t index);
+    bool take(size_t index, std::function<void()> &task);
+    bool hasWork(size_t index) const;
+
+    NumaTopology topology_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::vector<size_t>> nodeWorkers_; // Worker indices per node
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> queued_;                   // Tasks any worker may take
+    std::unique_ptr<std::atomic<size_t>[]> pinnedQueued_; // Pinned tasks per node
+    std::atomic<size_t> nextWorker_; // Round-robin target for submissions from outside
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+// Tasks submitted together and awaited together; the first failure is rethrown by wait()
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool &pool) : pool_(pool), pending_(0) {}
+
+    // Waits for outstanding tasks, so their captures never dangle
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    // Queue a task, optionally for one NUMA node; safe to call from inside another
+    // task of the group
+    void run(std::function<void()> task, size_t node = ThreadPool::kAnyNode);
+
+    // Block until every task has finished, working on queued tasks meanwhile
+    void wait();
+
+    // Whether a task of the group has failed
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    ThreadPool &pool_;
+    std::atomic<size_t> pending_;
+    std::atomic<bool> failed_{false};
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,148 @@
+// File: TickGenerator.cpp
+#include "TickGenerator.hpp"
+#include "MarketDataEntry.hpp"
+#include "TextFormat.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+    // Independent, reproducible stream per file
+    uint64_t fileSeed(uint64_t seed, size_t file)
+    {
+        uint64_t x = seed + 0x9E3779B97F4A7C15ull * (file + 1);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // One symbol file; returns the bytes written
+    uint64_t writeFile(const std::string &path, size_t file, uint64_t rows, const TickGeneratorOptions &options)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            throw std::runtime_error("Failed to open output file: " + path);
+        }
+
+        std::mt19937_64 rng(fileSeed(options.seed, file));
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::exponential_distribution<double> gap(1.0 / static_cast<double>(std::max<int64_t>(options.meanGapNanos, 1)));
+        std::uniform_int_distribution<int64_t> burstGap(1000, 50000); // 1-50 us
+        std::uniform_int_distribution<int> tick(-2, 2);
+        std::uniform_int_distribution<int> lots(1, 20);
+        std::uniform_int_distribution<int> pick(0, 2);
+
+        const int64_t priceUnit = 1000000; // One cent at kPriceDigits = 8
+        int64_t timestamp = options.startNanos +
+                            static_cast<int64_t>(unit(rng) * static_cast<double>(options.skewNanos));
+        int64_t price = (1000 + static_cast<int64_t>(unit(rng) * 49000)) * priceUnit; // $10-$500
+        const std::string_view exchanges[] = {"NYSE", "NYSE_ARCA", "NASDAQ"};
+
+        std::string buffer = "Timestamp, Price, Size, Exchange, Type\n";
+        buffer.reserve(1 << 20);
+        uint64_t bytes = 0;
+        char field[TextFormat::kMaxFieldLength];
+        for (uint64_t row = 0; row < rows; ++row)
+        {
+            bool burst = row > 0 && unit(rng) < options.burstiness;
+            timestamp += burst ? burstGap(rng) : static_cast<int64_t>(gap(rng)) + 1;
+            price = std::max(price + tick(rng) * priceUnit, priceUnit);
+
+            buffer.append(field, TextFormat::formatTimestamp(timestamp, field));
+            buffer += ", ";
+            buffer.append(field, TextFormat::formatFixed(price, MarketDataEntry::kPriceDigits, field));
+            buffer += ", ";
+            buffer.append(field, TextFormat::formatInt(lots(rng) * 100, field));
+            buffer += ", ";
+            buffer += exchanges[pick(rng)];
+            buffer += ", ";
+            buffer += sideName(static_cast<Side>(pick(rng)));
+            buffer += '\n';
+
+            if (buffer.size() >= (1 << 20) - 128)
+            {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                bytes += buffer.size();
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        bytes += buffer.size();
+
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write output file: " + path);
+        }
+        return bytes;
+    }
+}
+
+std::vector<uint64_t> TickGenerator::rowsPerFile(const TickGeneratorOptions &options)
+{
+    std::vector<uint64_t> rows(options.files, 0);
+    if (options.files == 0)
+    {
+        return rows;
+    }
+
+    // Rank r gets weight 1 / r^zipf; ranks are dealt to files in a seeded order
+    std::vector<double> weights(options.files);
+    for (size_t rank = 0; rank < options.files; ++rank)
+    {
+        weights[rank] = 1.0 / std::pow(static_cast<double>(rank + 1), options.zipf);
+    }
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+    std::vector<size_t> order(options.files);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(options.seed));
+
+    uint64_t assigned = 0;
+    for (size_t rank = 0; rank < options.files; ++rank)
+    {
+        rows[order[rank]] = static_cast<uint64_t>(static_cast<double>(options.rows) * weights[rank] / total);
+        assigned += rows[order[rank]];
+    }
+    // Rounding leftovers go to the largest file
+    rows[order[0]] += options.rows - std::min(assigned, options.rows);
+    return rows;
+}
+
+GeneratedData TickGenerator::generate(const std::string &directory, const TickGeneratorOptions &options)
+{
+    if (!std::filesystem::is_directory(directory))
+    {
+        throw std::runtime_error("Directory does not exist: " + directory);
+    }
+
+    const std::vector<uint64_t> rows = rowsPerFile(options);
+    GeneratedData data;
+    std::vector<uint64_t> bytes(options.files, 0);
+    for (size_t file = 0; file < options.files; ++file)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "S%05zu.txt", file);
+        data.files.push_back(std::filesystem::path(directory).append(name).generic_string());
+        data.rows += rows[file];
+    }
+
+    ThreadPool pool(options.threads);
+    TaskGroup group(pool);
+    for (size_t file = 0; file < options.files; ++file)
+    {
+        group.run([&, file]()
+                  { bytes[file] = writeFile(data.files[file], file, rows[file], options); });
+    }
+    group.wait();
+
+    data.bytes = std::accumulate(bytes.begin(), bytes.end(), uint64_t(0));
+    return data;
+}
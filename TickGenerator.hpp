@@ -0,0 +1,39 @@
+// File: TickGenerator.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Seeded synthetic market data in the input file format. The same options and
+// seed always produce byte-identical files, whatever the thread count.
+struct TickGeneratorOptions
+{
+    size_t files = 100;                      // Symbol files to write
+    uint64_t rows = 1000000;                 // Rows across all files
+    double zipf = 1.0;                       // Exponent of the rows-per-symbol distribution; 0 gives equal files
+    double burstiness = 0.5;                 // Probability that a tick follows the previous one within microseconds
+    int64_t meanGapNanos = 10000000;         // Mean gap between ticks outside bursts
+    int64_t skewNanos = 1000000000;          // Largest offset between the clocks of two files
+    int64_t startNanos = 1614936600000000000; // 2021-03-05 09:30:00 UTC
+    uint64_t seed = 42;
+    size_t threads = 0;                      // Files generated concurrently; 0 sizes to the hardware
+};
+
+struct GeneratedData
+{
+    std::vector<std::string> files; // Sorted paths
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+};
+
+class TickGenerator
+{
+public:
+    // Write the files (S00000.txt, S00001.txt, ...) into an existing directory
+    static GeneratedData generate(const std::string &directory, const TickGeneratorOptions &options);
+
+    // Rows each file receives: Zipf weights over a seeded shuffle of the files
+    static std::vector<uint64_t> rowsPerFile(const TickGeneratorOptions &options);
+};
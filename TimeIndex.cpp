@@ -0,0 +1,239 @@
+// File: TimeIndex.cpp
+#include "TimeIndex.hpp"
+#include "InputSource.hpp"
+#include "LineParser.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace
+{
+    struct SidecarHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t stride;
+        uint64_t fileSize;
+        int64_t modified;
+        uint64_t rows;
+        int64_t first;
+        int64_t last;
+        uint32_t usable;
+        uint32_t reserved;
+        uint64_t sampleCount;
+    };
+
+    constexpr char kMagic[8] = {'M', 'D', 'F', 'T', 'I', 'X', '0', '1'};
+    constexpr uint32_t kVersion = 1;
+
+    // Size and modification time identify the version of the input an index describes
+    bool fileStamp(const std::string &filename, uint64_t &size, int64_t &modified)
+    {
+        std::error_code error;
+        size = std::filesystem::file_size(filename, error);
+        if (error)
+        {
+            return false;
+        }
+        auto time = std::filesystem::last_write_time(filename, error);
+        if (error)
+        {
+            return false;
+        }
+        modified = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+}
+
+TimeIndex::TimeIndex()
+    : stride_(kDefaultStride), fileSize_(0), modified_(0), usable_(true), rows_(0), first_(0), last_(0)
+{
+}
+
+std::string TimeIndex::sidecarPath(const std::string &filename)
+{
+    std::filesystem::path path(filename);
+    return (path.parent_path() / ".mdf-index" / path.filename()).generic_string() + ".idx";
+}
+
+TimeIndex TimeIndex::forFile(const std::string &filename, uint32_t stride)
+{
+    const std::string sidecar = sidecarPath(filename);
+    TimeIndex index;
+    if (index.load(sidecar, filename, stride))
+    {
+        return index;
+    }
+
+    index = build(filename, stride);
+    try
+    {
+        index.save(sidecar);
+    }
+    catch (const std::exception &)
+    {
+        // Not cached; the index is still good for this merge
+    }
+    return index;
+}
+
+TimeIndex TimeIndex::build(const std::string &filename, uint32_t stride)
+{
+    TimeIndex index;
+    index.stride_ = std::max<uint32_t>(stride, 1);
+    if (!fileStamp(filename, index.fileSize_, index.modified_))
+    {
+        throw std::runtime_error("Failed to stat file: " + filename);
+    }
+
+    std::unique_ptr<InputSource> source = InputSource::open(filename, InputMode::Stream);
+    uint64_t offset = 0; // Of the first byte of source->view()
+    bool header = true;
+    for (;;)
+    {
+        std::string_view bytes = source->view();
+        const char *delimiters[4];
+        size_t delimiterCount;
+        const char *newline = LineParser::scanLine(bytes.data(), bytes.data() + bytes.size(),
+                                                   delimiters, 4, delimiterCount);
+        if (!newline && source->fill())
+        {
+            continue;
+        }
+        if (!newline && bytes.empty())
+        {
+            break;
+        }
+        const char *lineEnd = newline ? newline : bytes.data() + bytes.size();
+        const size_t length = static_cast<size_t>(lineEnd - bytes.data()) + (newline ? 1 : 0);
+
+        if (!header)
+        {
+            // Mirrors FileReader: a short line ends the file's data
+            if (delimiterCount < 4)
+            {
+                break;
+            }
+            int64_t timestamp = 0;
+            std::string_view field = LineParser::trim(std::string_view(bytes.data(), delimiters[0] - bytes.data()));
+            if (!LineParser::parseTimestamp(field, timestamp) || (index.rows_ > 0 && timestamp < index.last_))
+            {
+                index.usable_ = false;
+                break;
+            }
+            if (index.rows_ % index.stride_ == 0)
+            {
+                index.samples_.push_back({timestamp, offset});
+            }
+            if (index.rows_ == 0)
+            {
+                index.first_ = timestamp;
+            }
+            index.last_ = timestamp;
+            ++index.rows_;
+        }
+        header = false;
+        source->consume(length);
+        offset += length;
+    }
+    return index;
+}
+
+bool TimeIndex::load(const std::string &sidecar, const std::string &filename, uint32_t stride)
+{
+    std::ifstream in(sidecar, std::ios::binary);
+    SidecarHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.stride != std::max<uint32_t>(stride, 1))
+    {
+        return false;
+    }
+
+    uint64_t size = 0;
+    int64_t modified = 0;
+    if (!fileStamp(filename, size, modified) || size != header.fileSize || modified != header.modified)
+    {
+        return false;
+    }
+
+    std::vector<Sample> samples(header.sampleCount);
+    if (!in.read(reinterpret_cast<char *>(samples.data()),
+                 static_cast<std::streamsize>(samples.size() * sizeof(Sample))))
+    {
+        return false;
+    }
+
+    stride_ = header.stride;
+    fileSize_ = header.fileSize;
+    modified_ = header.modified;
+    usable_ = header.usable != 0;
+    rows_ = header.rows;
+    first_ = header.first;
+    last_ = header.last;
+    samples_ = std::move(samples);
+    return true;
+}
+
+void TimeIndex::save(const std::string &sidecar) const
+{
+    std::filesystem::create_directories(std::filesystem::path(sidecar).parent_path());
+
+    SidecarHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.stride = stride_;
+    header.fileSize = fileSize_;
+    header.modified = modified_;
+    header.rows = rows_;
+    header.first = first_;
+    header.last = last_;
+    header.usable = usable_ ? 1 : 0;
+    header.sampleCount = samples_.size();
+
+    // Concurrent merges over the same inputs each write their own file; the last rename wins
+    const std::string temporary = sidecar + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(samples_.data()),
+                  static_cast<std::streamsize>(samples_.size() * sizeof(Sample)));
+        if (!out)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            throw std::runtime_error("Failed to write index file: " + sidecar);
+        }
+    }
+    std::filesystem::rename(temporary, sidecar);
+}
+
+bool TimeIndex::overlaps(const TimeRange &range) const
+{
+    if (!usable_)
+    {
+        return true;
+    }
+    return rows_ > 0 && last_ >= range.from && first_ < range.to;
+}
+
+uint64_t TimeIndex::seek(int64_t timestamp) const
+{
+    if (!usable_)
+    {
+        return 0;
+    }
+
+    // Rows equal to timestamp may precede the first sample at it, so start at the
+    // last sample strictly before it
+    auto it = std::lower_bound(samples_.begin(), samples_.end(), timestamp,
+                               [](const Sample &sample, int64_t value)
+                               { return sample.timestamp < value; });
+    return it == samples_.begin() ? 0 : std::prev(it)->offset;
+}
@@ -0,0 +1,79 @@
+// File: TimeIndex.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Half-open window [from, to) of nanosecond timestamps; the default covers everything
+struct TimeRange
+{
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+
+    bool bounded() const
+    {
+        return from != std::numeric_limits<int64_t>::min() || to != std::numeric_limits<int64_t>::max();
+    }
+};
+
+// Sparse timestamp -> byte offset map of one time-ordered input file: every stride-th
+// row's timestamp and line offset, plus the file's first and last timestamps. It is
+// kept in a sidecar file (see sidecarPath) and rebuilt when the input changes.
+class TimeIndex
+{
+public:
+    static constexpr uint32_t kDefaultStride = 4096;
+
+    struct Sample
+    {
+        int64_t timestamp;
+        uint64_t offset; // Of the row's line from the start of the file
+    };
+
+    TimeIndex();
+
+    // Sidecar of the file: "<dir>/.mdf-index/<name>.idx", out of the way of listFiles
+    static std::string sidecarPath(const std::string &filename);
+
+    // Load the file's sidecar if it is current and uses this stride; otherwise build the
+    // index and try to save it (a read-only input directory just means no sidecar)
+    static TimeIndex forFile(const std::string &filename, uint32_t stride = kDefaultStride);
+
+    // Scan the file and sample every stride-th row
+    static TimeIndex build(const std::string &filename, uint32_t stride = kDefaultStride);
+
+    // Read a sidecar; false if it is missing, corrupt or stale for the input file
+    bool load(const std::string &sidecar, const std::string &filename, uint32_t stride);
+
+    // Write the sidecar atomically (temporary file, then rename); throws on failure
+    void save(const std::string &sidecar) const;
+
+    // False when the file is out of order or has a row that does not parse; such a
+    // file must be read in full so it fails (or merges) exactly as without the index
+    bool usable() const { return usable_; }
+
+    uint64_t rows() const { return rows_; }
+    int64_t first() const { return first_; }
+    int64_t last() const { return last_; }
+    const std::vector<Sample> &samples() const { return samples_; }
+
+    // Whether any row can fall in the range
+    bool overlaps(const TimeRange &range) const;
+
+    // Offset to start reading at so that no row at or after timestamp is missed;
+    // 0 means from the beginning, header included
+    uint64_t seek(int64_t timestamp) const;
+
+private:
+    uint32_t stride_;
+    uint64_t fileSize_;
+    int64_t modified_; // Input's last write time, in its clock's ticks
+    bool usable_;
+    uint64_t rows_;
+    int64_t first_;
+    int64_t last_;
+    std::vector<Sample> samples_;
+};
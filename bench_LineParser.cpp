@@ -0,0 +1,127 @@
+// File: bench_LineParser.cpp
+// Microbenchmark: istringstream/getline parsing versus LineParser (scalar, SSE2, AVX2)
+#include "LineParser.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Synthetic rows mixing the "," and ", " spacing seen in the sample files
+    std::string makeRows(size_t rows)
+    {
+        std::ostringstream out;
+        const char *exchanges[] = {"NYSE", "NYSE_ARCA", "NASDAQ"};
+        const char *types[] = {"Bid", "Ask", "TRADE"};
+        for (size_t i = 0; i < rows; ++i)
+        {
+            const char *sep = (i % 2 == 0) ? "," : ", ";
+            size_t millis = i % 60000;
+            out << "2021-03-05 10:" << std::setw(2) << std::setfill('0') << millis / 1000 / 60
+                << ":" << std::setw(2) << millis / 1000 % 60 << "." << std::setw(3) << millis % 1000
+                << sep << (100 + i % 900) << "." << std::setw(2) << i % 100
+                << sep << (100 + i % 9900)
+                << sep << exchanges[i % 3]
+                << sep << types[i % 3] << "\n";
+        }
+        return out.str();
+    }
+
+    void report(const std::string &name, size_t rows, size_t bytes, double seconds, double checksum)
+    {
+        std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+                  << " rows/s=" << std::setw(14) << std::setprecision(0) << rows / seconds
+                  << " GB/s=" << std::setw(7) << std::setprecision(3) << bytes / seconds / 1e9
+                  << " checksum=" << std::setprecision(2) << checksum << "\n";
+    }
+
+    double benchBaseline(const std::string &data, size_t &rows)
+    {
+        std::istringstream in(data);
+        std::string line;
+        double checksum = 0;
+        rows = 0;
+        while (std::getline(in, line))
+        {
+            std::istringstream iss(line);
+            std::string timestamp, priceStr, sizeStr, exchange, type;
+            if (std::getline(iss, timestamp, ',') &&
+                std::getline(iss, priceStr, ',') &&
+                std::getline(iss, sizeStr, ',') &&
+                std::getline(iss, exchange, ',') &&
+                std::getline(iss, type))
+            {
+                checksum += std::stod(priceStr) + std::stoi(sizeStr);
+                ++rows;
+            }
+        }
+        return checksum;
+    }
+
+    double benchParser(const std::string &data, size_t &rows)
+    {
+        const char *p = data.data();
+        const char *end = p + data.size();
+        const char *delimiters[4];
+        size_t delimiterCount = 0;
+        double checksum = 0;
+        rows = 0;
+        while (p < end)
+        {
+            const char *newline = LineParser::scanLine(p, end, delimiters, 4, delimiterCount);
+            const char *lineEnd = newline ? newline : end;
+            if (delimiterCount >= 4)
+            {
+                double price = 0;
+                int64_t size = 0;
+                LineParser::parsePrice(LineParser::trim(std::string_view(delimiters[0] + 1, delimiters[1] - delimiters[0] - 1)), price);
+                LineParser::parseInt(LineParser::trim(std::string_view(delimiters[1] + 1, delimiters[2] - delimiters[1] - 1)), size);
+                checksum += price + static_cast<double>(size);
+                ++rows;
+            }
+            p = lineEnd + 1;
+        }
+        return checksum;
+    }
+
+    template <typename Fn>
+    void run(const std::string &name, const std::string &data, int iterations, Fn &&fn)
+    {
+        size_t rows = 0;
+        double checksum = fn(data, rows); // Warm-up
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            checksum = fn(data, rows);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        report(name, rows * iterations, data.size() * iterations, elapsed.count(), checksum);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t rows = (argc >= 2) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int iterations = (argc >= 3) ? std::atoi(argv[2]) : 5;
+
+    std::string data = makeRows(rows);
+    std::cout << "Parsing " << rows << " rows (" << data.size() / (1024.0 * 1024.0) << " MiB) x "
+              << iterations << " iterations\n";
+
+    run("istringstream", data, iterations, benchBaseline);
+    for (auto isa : {LineParser::Isa::Scalar, LineParser::Isa::SSE2, LineParser::Isa::AVX2})
+    {
+        LineParser::forceIsa(isa);
+        if (LineParser::activeIsa() != isa)
+        {
+            std::cout << std::left << std::setw(12) << LineParser::isaName(isa) << " unsupported on this CPU\n";
+            continue;
+        }
+        run(LineParser::isaName(isa), data, iterations, benchParser);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// File: bench_LoserTree.cpp
+// Benchmark: the former std::priority_queue merge versus LoserTree, k = 2..10,000
+#include "LoserTree.hpp"
+#include "MarketDataEntry.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Key = MarketDataEntry::Key;
+
+    // Sorted key streams where a source tends to keep winning for a while (bursts)
+    std::vector<std::vector<Key>> makeSources(size_t k, size_t rows, double burstiness, uint32_t seed)
+    {
+        std::vector<std::vector<Key>> sources(k);
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        std::uniform_int_distribution<size_t> pick(0, k - 1);
+        size_t source = 0;
+        for (size_t t = 0; t < rows; ++t)
+        {
+            if (coin(rng) >= burstiness)
+            {
+                source = pick(rng);
+            }
+            sources[source].push_back((static_cast<Key>(t) << 64) | source);
+        }
+        return sources;
+    }
+
+    struct Cursor
+    {
+        const std::vector<Key> *keys;
+        size_t position;
+        Key current() const { return (*keys)[position]; }
+    };
+
+    // Shape of the old processBatch loop: heap of cursors, compare through pointers
+    uint64_t mergePriorityQueue(const std::vector<std::vector<Key>> &sources)
+    {
+        std::vector<Cursor> cursors;
+        for (const auto &keys : sources)
+        {
+            cursors.push_back({&keys, 0});
+        }
+        auto compare = [](const Cursor *a, const Cursor *b)
+        { return a->current() > b->current(); };
+        std::priority_queue<Cursor *, std::vector<Cursor *>, decltype(compare)> pq(compare);
+        for (auto &cursor : cursors)
+        {
+            if (!cursor.keys->empty())
+            {
+                pq.push(&cursor);
+            }
+        }
+
+        uint64_t checksum = 0;
+        while (!pq.empty())
+        {
+            Cursor *cursor = pq.top();
+            pq.pop();
+            checksum = checksum * 31 + static_cast<uint64_t>(cursor->current() >> 64);
+            if (++cursor->position < cursor->keys->size())
+            {
+                pq.push(cursor);
+            }
+        }
+        return checksum;
+    }
+
+    uint64_t mergeLoserTree(const std::vector<std::vector<Key>> &sources, bool drainRuns)
+    {
+        std::vector<size_t> positions(sources.size(), 0);
+        LoserTree<Key> tree(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            if (!sources[i].empty())
+            {
+                tree.set(i, sources[i][0]);
+            }
+        }
+        tree.build();
+
+        uint64_t checksum = 0;
+        size_t lastWinner = sources.size();
+        while (!tree.empty())
+        {
+            size_t winner = tree.winner();
+            const auto &keys = sources[winner];
+            size_t &position = positions[winner];
+            checksum = checksum * 31 + static_cast<uint64_t>(keys[position] >> 64);
+            bool more = ++position < keys.size();
+
+            if (drainRuns && more && winner == lastWinner)
+            {
+                size_t runnerUp = 0;
+                bool contested = tree.runnerUp(runnerUp);
+                while (more && (!contested || tree.beats(keys[position], runnerUp)))
+                {
+                    checksum = checksum * 31 + static_cast<uint64_t>(keys[position] >> 64);
+                    more = ++position < keys.size();
+                }
+            }
+
+            if (more)
+            {
+                tree.replaceWinner(keys[position]);
+                lastWinner = winner;
+            }
+            else
+            {
+                tree.removeWinner();
+                lastWinner = sources.size();
+            }
+        }
+        return checksum;
+    }
+
+    template <typename Fn>
+    double nanosPerRow(size_t rows, uint64_t &checksum, Fn &&fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        checksum = fn();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / rows;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t rows = (argc >= 2) ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+    double burstiness = (argc >= 3) ? std::atof(argv[2]) : 0.5;
+
+    std::cout << "Merging " << rows << " keys, burstiness " << burstiness << " (ns/row)\n";
+    std::cout << std::setw(8) << "k" << std::setw(16) << "priority_queue" << std::setw(12) << "loser_tree"
+              << std::setw(14) << "+drain_runs" << std::setw(10) << "speedup" << "\n";
+
+    for (size_t k : {2, 4, 16, 64, 256, 1024, 4096, 10000})
+    {
+        auto sources = makeSources(k, rows, burstiness, 42);
+        uint64_t expected = 0, checksum = 0;
+        double pq = nanosPerRow(rows, expected, [&]()
+                                { return mergePriorityQueue(sources); });
+        double tree = nanosPerRow(rows, checksum, [&]()
+                                  { return mergeLoserTree(sources, false); });
+        bool ok = checksum == expected;
+        double drained = nanosPerRow(rows, checksum, [&]()
+                                     { return mergeLoserTree(sources, true); });
+        ok = ok && checksum == expected;
+
+        std::cout << std::setw(8) << k << std::fixed << std::setprecision(2)
+                  << std::setw(16) << pq << std::setw(12) << tree << std::setw(14) << drained
+                  << std::setw(9) << pq / drained << "x" << (ok ? "" : "  ORDER MISMATCH") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,457 @@
+// File: bench_Merge.cpp
+// Benchmark harness: parse, merge and write stages alone and end to end over
+// seeded synthetic data, reported as JSON for comparison across versions
+#include "FileMerger.hpp"
+#include "LoserTree.hpp"
+#include "OutputWriter.hpp"
+#include "TextFormat.hpp"
+#include "TickGenerator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Rows are timed in chunks; per-row latency is the chunk time over its rows
+    constexpr size_t kChunkRows = 4096;
+
+    struct StageResult
+    {
+        std::string name;
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+        double seconds = 0;
+        std::vector<double> nanosPerRow; // One sample per chunk
+        long peakRssKb = 0;
+    };
+
+    // Times consecutive chunks of rows
+    class ChunkTimer
+    {
+    public:
+        explicit ChunkTimer(StageResult &result) : result_(result), start_(Clock::now()), chunkStart_(start_) {}
+
+        void row()
+        {
+            if (++inChunk_ == kChunkRows)
+            {
+                close();
+            }
+        }
+
+        void finish()
+        {
+            close();
+            result_.seconds = std::chrono::duration<double>(Clock::now() - start_).count();
+        }
+
+    private:
+        void close()
+        {
+            auto now = Clock::now();
+            if (inChunk_ > 0)
+            {
+                result_.nanosPerRow.push_back(std::chrono::duration<double, std::nano>(now - chunkStart_).count() / inChunk_);
+                result_.rows += inChunk_;
+            }
+            inChunk_ = 0;
+            chunkStart_ = now;
+        }
+
+        StageResult &result_;
+        Clock::time_point start_;
+        Clock::time_point chunkStart_;
+        size_t inChunk_ = 0;
+    };
+
+    // Restart peak RSS tracking (Linux 4.0+); harmless where unsupported
+    void resetPeakRss()
+    {
+        std::ofstream clear("/proc/self/clear_refs");
+        clear << "5";
+    }
+
+    long peakRssKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.rfind("VmHWM:", 0) == 0)
+            {
+                return std::stol(line.substr(6));
+            }
+        }
+        rusage usage{};
+        ::getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    double percentile(std::vector<double> samples, double p)
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+    std::string toJson(const StageResult &stage)
+    {
+        std::ostringstream out;
+        out << "\"" << stage.name << "\": {"
+            << "\"rows\": " << stage.rows
+            << ", \"bytes\": " << stage.bytes
+            << ", \"seconds\": " << stage.seconds
+            << ", \"rows_per_sec\": " << (stage.seconds > 0 ? stage.rows / stage.seconds : 0)
+            << ", \"mb_per_sec\": " << (stage.seconds > 0 ? stage.bytes / stage.seconds / 1e6 : 0);
+        if (stage.nanosPerRow.empty())
+        {
+            out << ", \"p50_ns_per_row\": null, \"p99_ns_per_row\": null";
+        }
+        else
+        {
+            out << ", \"p50_ns_per_row\": " << percentile(stage.nanosPerRow, 0.50)
+                << ", \"p99_ns_per_row\": " << percentile(stage.nanosPerRow, 0.99);
+        }
+        out << ", \"peak_rss_kb\": " << stage.peakRssKb << "}";
+        return out.str();
+    }
+
+    SymbolTable symbolsOf(const std::vector<std::string> &files)
+    {
+        std::vector<std::string> names;
+        for (const auto &file : files)
+        {
+            names.push_back(SymbolTable::symbolOf(file));
+        }
+        return SymbolTable(std::move(names));
+    }
+
+    // Parse every file to the end, one reader at a time
+    StageResult benchParse(const GeneratedData &data, const SymbolTable &symbols, InputMode mode)
+    {
+        StageResult result;
+        result.name = "parse";
+        result.bytes = data.bytes;
+        resetPeakRss();
+
+        int64_t checksum = 0;
+        ChunkTimer timer(result);
+        for (const auto &file : data.files)
+        {
+            FileMerger::FileReader reader(symbols.id(SymbolTable::symbolOf(file)), file, mode);
+            while (reader.hasMoreData)
+            {
+                checksum += reader.currentEntry.price;
+                timer.row();
+                reader.readNextEntry();
+            }
+        }
+        timer.finish();
+        result.peakRssKb = peakRssKb();
+        volatile int64_t sink = checksum; // Keeps the loop from being optimized away
+        (void)sink;
+        return result;
+    }
+
+    // K-way merge of pre-parsed files held in memory
+    StageResult benchMerge(const GeneratedData &data, const SymbolTable &symbols,
+                           std::vector<MarketDataEntry> &merged)
+    {
+        std::vector<std::vector<MarketDataEntry>> sources;
+        for (const auto &file : data.files)
+        {
+            FileMerger::FileReader reader(symbols.id(SymbolTable::symbolOf(file)), file);
+            sources.emplace_back();
+            while (reader.hasMoreData)
+            {
+                sources.back().push_back(reader.currentEntry);
+                reader.readNextEntry();
+            }
+        }
+        merged.clear();
+        merged.reserve(data.rows);
+
+        StageResult result;
+        result.name = "merge";
+        result.bytes = data.rows * sizeof(MarketDataEntry);
+        resetPeakRss();
+
+        std::vector<size_t> positions(sources.size(), 0);
+        LoserTree<MarketDataEntry::Key> tree(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            if (!sources[i].empty())
+            {
+                tree.set(i, sources[i][0].key());
+            }
+        }
+        ChunkTimer timer(result);
+        tree.build();
+        while (!tree.empty())
+        {
+            size_t winner = tree.winner();
+            merged.push_back(sources[winner][positions[winner]]);
+            timer.row();
+            if (++positions[winner] < sources[winner].size())
+            {
+                tree.replaceWinner(sources[winner][positions[winner]].key());
+            }
+            else
+            {
+                tree.removeWinner();
+            }
+        }
+        timer.finish();
+        result.peakRssKb = peakRssKb();
+        return result;
+    }
+
+    // Format and write merged rows through the output writer
+    StageResult benchWrite(const std::vector<MarketDataEntry> &merged, const SymbolTable &symbols,
+                           const std::string &outputFile, bool directIo)
+    {
+        StageResult result;
+        result.name = "write";
+        resetPeakRss();
+
+        ChunkTimer timer(result);
+        OutputWriter output(outputFile, directIo);
+        for (const auto &entry : merged)
+        {
+            TextFormat::appendEntry(output.buffer(), entry, symbols);
+            output.commit();
+            timer.row();
+        }
+        output.close();
+        timer.finish();
+        result.bytes = std::filesystem::file_size(outputFile);
+        result.peakRssKb = peakRssKb();
+        return result;
+    }
+
+    StageResult benchEndToEnd(const GeneratedData &data, const std::string &outputFile,
+                              const FileMerger::MergeOptions &options)
+    {
+        StageResult result;
+        result.name = "end_to_end";
+        result.rows = data.rows;
+        result.bytes = data.bytes;
+        resetPeakRss();
+
+        auto start = Clock::now();
+        FileMerger::mergeFiles(data.files, outputFile, options);
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.peakRssKb = peakRssKb();
+        return result;
+    }
+
+    void printUsage(const char *program)
+    {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "Data (generated unless --data is given):\n"
+                  << "  --data DIR       Benchmark existing files instead of generating them\n"
+                  << "  --files N        Symbol files (default 200)\n"
+                  << "  --rows N         Rows across all files (default 2000000)\n"
+                  << "  --zipf S         Rows-per-symbol Zipf exponent (default 1.0)\n"
+                  << "  --burst P        Probability a tick follows within microseconds (default 0.5)\n"
+                  << "  --skew-ms N      Largest clock offset between files (default 1000)\n"
+                  << "  --seed N         Random seed (default 42)\n"
+                  << "Merge:\n"
+                  << "  --batch-size N   Files per leaf batch (default 16)\n"
+                  << "  --threads N      Worker threads (default: hardware concurrency)\n"
+                  << "  --mmap | --async-io   Input mode (default stream)\n"
+                  << "  --direct-io      O_DIRECT output\n"
+                  << "Report:\n"
+                  << "  --json FILE      Also write the JSON report to FILE\n"
+                  << "  --work-dir DIR   Scratch directory (default bench_data)\n"
+                  << "  --keep           Keep generated data and output\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        TickGeneratorOptions generator;
+        generator.files = 200;
+        generator.rows = 2000000;
+        FileMerger::MergeOptions options;
+        options.batchSize = 16;
+        std::string dataDirectory;
+        std::string workDirectory = "bench_data";
+        std::string jsonFile;
+        bool keep = false;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--data")
+            {
+                dataDirectory = value();
+            }
+            else if (arg == "--files")
+            {
+                generator.files = std::stoul(value());
+            }
+            else if (arg == "--rows")
+            {
+                generator.rows = std::stoull(value());
+            }
+            else if (arg == "--zipf")
+            {
+                generator.zipf = std::stod(value());
+            }
+            else if (arg == "--burst")
+            {
+                generator.burstiness = std::stod(value());
+            }
+            else if (arg == "--skew-ms")
+            {
+                generator.skewNanos = std::stoll(value()) * 1000000;
+            }
+            else if (arg == "--seed")
+            {
+                generator.seed = std::stoull(value());
+            }
+            else if (arg == "--batch-size")
+            {
+                options.batchSize = std::stoul(value());
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::stoul(value());
+            }
+            else if (arg == "--mmap")
+            {
+                options.inputMode = InputMode::Mmap;
+            }
+            else if (arg == "--async-io")
+            {
+                options.inputMode = InputMode::Async;
+            }
+            else if (arg == "--direct-io")
+            {
+                options.directOutput = true;
+            }
+            else if (arg == "--json")
+            {
+                jsonFile = value();
+            }
+            else if (arg == "--work-dir")
+            {
+                workDirectory = value();
+            }
+            else if (arg == "--keep")
+            {
+                keep = true;
+            }
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        std::filesystem::create_directories(workDirectory);
+        const std::string inputDirectory = dataDirectory.empty()
+                                               ? std::filesystem::path(workDirectory).append("input").generic_string()
+                                               : dataDirectory;
+        const std::string outputFile = std::filesystem::path(workDirectory).append("output.txt").generic_string();
+
+        GeneratedData data;
+        if (dataDirectory.empty())
+        {
+            std::filesystem::create_directories(inputDirectory);
+            std::cerr << "Generating " << generator.rows << " rows over " << generator.files << " files...\n";
+            data = TickGenerator::generate(inputDirectory, generator);
+        }
+        else
+        {
+            data.files = FileMerger::listFiles(dataDirectory);
+            for (const auto &file : data.files)
+            {
+                data.bytes += std::filesystem::file_size(file);
+            }
+        }
+        const SymbolTable symbols = symbolsOf(data.files);
+
+        std::vector<StageResult> stages;
+        std::cerr << "parse...\n";
+        stages.push_back(benchParse(data, symbols, options.inputMode));
+        if (data.rows == 0)
+        {
+            data.rows = stages.back().rows;
+        }
+        std::cerr << "merge...\n";
+        std::vector<MarketDataEntry> merged;
+        stages.push_back(benchMerge(data, symbols, merged));
+        std::cerr << "write...\n";
+        stages.push_back(benchWrite(merged, symbols, outputFile, options.directOutput));
+        merged = std::vector<MarketDataEntry>();
+        std::cerr << "end to end...\n";
+        stages.push_back(benchEndToEnd(data, outputFile, options));
+
+        std::ostringstream json;
+        json << "{\n  \"config\": {\"files\": " << data.files.size() << ", \"rows\": " << data.rows
+             << ", \"input_bytes\": " << data.bytes << ", \"zipf\": " << generator.zipf
+             << ", \"burstiness\": " << generator.burstiness << ", \"skew_ns\": " << generator.skewNanos
+             << ", \"seed\": " << generator.seed << ", \"generated\": " << (dataDirectory.empty() ? "true" : "false")
+             << ", \"batch_size\": " << options.batchSize << ", \"threads\": " << options.threads
+             << ", \"input_mode\": \""
+             << (options.inputMode == InputMode::Mmap ? "mmap" : options.inputMode == InputMode::Async ? "async" : "stream")
+             << "\", \"direct_io\": " << (options.directOutput ? "true" : "false") << "},\n  \"stages\": {";
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            json << (i ? ",\n    " : "\n    ") << toJson(stages[i]);
+        }
+        json << "\n  }\n}\n";
+
+        std::cout << json.str();
+        if (!jsonFile.empty())
+        {
+            std::ofstream out(jsonFile);
+            out << json.str();
+        }
+
+        if (!keep)
+        {
+            std::filesystem::remove(outputFile);
+            if (dataDirectory.empty())
+            {
+                std::filesystem::remove_all(inputDirectory);
+            }
+            std::error_code ec;
+            std::filesystem::remove(workDirectory, ec); // Only if now empty
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
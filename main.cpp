@@ -1,25 +1,684 @@
 // File: main.cpp
 #include "FileMerger.hpp"
+#include "Aggregation.hpp"
+#include "AsyncIo.hpp"
+#include "FeedMerger.hpp"
+#include "FileDiscovery.hpp"
+#include "LineParser.hpp"
+#include "LiveMerger.hpp"
+#include "Metrics.hpp"
+#include "Replay.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+static std::atomic<bool> g_stop{false};
+
+static void requestStop(int)
+{
+    g_stop.store(true);
+}
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <input_directory> <output_file> [batch_size] [options]\n"
+              << "Options:\n"
+              << "  --batching KIND    Deal input files into leaf batches by size (balanced bytes; default) or count\n"
+              << "  --fan-in N         Maximum runs combined by one merge-tree node (default 16)\n"
+              << "  --max-depth N      Intermediate merge levels before the final merge (default 1)\n"
+              << "  --spill-dir DIR    Spill intermediate runs to DIR instead of memory\n"
+              << "  --memory-budget BYTES Keep intermediate runs in memory up to BYTES and spill the rest\n"
+              << "  --max-open-files N Open at most N files at once, adding merge passes as needed\n"
+              << "  --mmap             Memory-map input files instead of streaming them\n"
+              << "  --map-budget BYTES Largest mapping per file before sliding windows (default 256 MiB)\n"
+              << "  --block-rows N     Rows parsed per reader refill (default 1024)\n"
+              << "  --async-io         Read input ahead of the parser with asynchronous I/O\n"
+              << "  --io-engine KIND   Async I/O engine: auto, uring or threads (default auto)\n"
+              << "  --direct-io        Write the output with O_DIRECT, bypassing the page cache\n"
+              << "  --format KIND      Output format: text or columnar (default text)\n"
+              << "  --feed KIND        Input layout: tick, quote or trade (default tick; see FeedSchema.hpp)\n"
+              << "  --from TIME        Only merge rows at or after TIME (\"YYYY-MM-DD HH:MM:SS[.fff]\", UTC)\n"
+              << "  --to TIME          Only merge rows before TIME\n"
+              << "  --symbols A,B,...  Only read these symbols' files\n"
+              << "  --index-stride N   Rows per sample of the per-file time index; 0 disables it (default 4096)\n"
+              << "  --include GLOB     Only take input files whose name matches GLOB (repeatable)\n"
+              << "  --manifest FILE    Only take the input files listed in FILE, relative to <input_directory>\n"
+              << "  --recursive        Also take input files from subdirectories\n"
+              << "  --prefetch BYTES   Start reading the first BYTES of each input file while the listing runs\n"
+              << "  --threads N        Worker threads (default: hardware concurrency)\n"
+              << "  --incremental      Only merge rows appended since the last --incremental run (checkpoint in <output>.checkpoint)\n"
+              << "  --aggregate LIST   Also compute bars:INTERVAL, vwap and/or top-of-book into <output>.<name>.csv\n"
+              << "  --numa             Pin workers to NUMA nodes and keep each node's runs local until the final merge\n"
+              << "  --numa-simulate N  Like --numa, over N simulated nodes carved out of the online CPUs\n"
+              << "  --shard I/N        Merge only shard I of N of the inputs (by symbol hash) into a partial output\n"
+              << "  --shard-manifest F Assign symbols to shards from F (\"SYMBOL SHARD\" lines); others go by hash\n"
+              << "  --merge-partials   Merge the partial outputs in <input_directory> into the final output\n"
+              << "  --replay SPEED     Pace the output at SPEED times its recorded rate (1, 10, 0.5, ...) or max\n"
+              << "  --replay-pacing P  busy (spin) or hybrid (sleep, then spin; default)\n"
+              << "  --replay-shm NAME  Also publish replayed rows to shared-memory ring NAME for --replay-consume\n"
+              << "  --replay-capacity N Rows the ring holds (default 65536)\n"
+              << "  --replay-consume NAME [output_file] Read a replay's ring, optionally writing its rows\n"
+              << "  --live             Tail the input files and merge as rows arrive, until interrupted\n"
+              << "  --lateness-ms N    Live: release rows this far behind the newest one (default 1000)\n"
+              << "  --idle-ms N        Live: a symbol silent this long stops holding others back (default 1000)\n"
+              << "  --metrics KIND     Record per-stage metrics and print them as json or prometheus at exit\n"
+              << "  --metrics-out DEST Write metrics to a file every interval, or serve them on unix:PATH\n"
+              << "  --metrics-interval S Seconds between metrics file snapshots (default 1)\n";
+}
+
+// Consumer side of --replay-shm: read rows as they are published and report the
+// latency from publication to here
+static int consumeReplay(const std::string &ring, const std::string &outputFile)
+{
+    ShmRingReader reader(ring, ShmRing::kDefaultAttachTimeout);
+    std::unique_ptr<OutputSink> sink;
+    if (!outputFile.empty())
+    {
+        sink = OutputSink::open(outputFile, OutputFormat::Text);
+        sink->begin(reader.symbols());
+    }
+
+    std::vector<ShmRing::Slot> slots(1024);
+    std::vector<MarketDataEntry> entries(slots.size());
+    LatencyHistogram delivery;
+    uint64_t rows = 0;
+    unsigned idlePolls = 0;
+    for (;;)
+    {
+        const size_t count = reader.read(slots.data(), slots.size());
+        if (count == 0)
+        {
+            if (reader.finished())
+            {
+                break;
+            }
+            // Spin for the lowest latency, but give up the core now and then in case
+            // the producer shares it
+            if (++idlePolls % 1024 == 0)
+            {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        const int64_t now = ReplaySink::nowNanos();
+        for (size_t i = 0; i < count; ++i)
+        {
+            delivery.record(static_cast<uint64_t>(std::max<int64_t>(now - slots[i].publishedNanos, 0)));
+            entries[i] = slots[i].entry;
+        }
+        rows += count;
+        if (sink)
+        {
+            sink->write(entries.data(), count);
+        }
+    }
+    if (sink)
+    {
+        sink->finish();
+    }
+    std::cout << "Consumed " << rows << " rows; delivery latency " << delivery.summary() << "\n";
+    return 0;
+}
+
+template <typename Schema>
+static typename FeedMerger<Schema>::Options feedOptions(const FileMerger::MergeOptions &options)
+{
+    typename FeedMerger<Schema>::Options result;
+    result.batchSize = options.batchSize;
+    result.threads = options.threads;
+    result.inputMode = options.inputMode;
+    result.directOutput = options.directOutput;
+    return result;
+}
 
 int main(int argc, char *argv[])
 {
-    if (argc < 3)
+    std::vector<std::string> positional;
+    FileMerger::MergeOptions options;
+    LiveMerger::Options liveOptions;
+    bool live = false;
+    std::string feed = "tick";
+    std::vector<std::string> aggregations;
+    FileDiscovery::Options discovery;
+    FileMerger::Shard shard;
+    bool sharded = false;
+    bool mergePartials = false;
+    bool replay = false;
+    ReplayOptions replayOptions;
+    std::string replayRing;
+    size_t replayCapacity = ShmRing::kDefaultCapacity;
+    std::string consumeRing;
+    bool metrics = false;
+    MetricsFormat metricsFormat = MetricsFormat::Json;
+    std::string metricsOut;
+    double metricsInterval = 1.0;
+
+    try
     {
-        std::cerr << "Usage: " << argv[0] << " <input_directory> <output_file> [batch_size]\n";
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                {
+                    throw std::runtime_error("Missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--fan-in")
+            {
+                options.fanIn = std::stoul(value());
+            }
+            else if (arg == "--max-depth")
+            {
+                options.maxDepth = std::stoul(value());
+            }
+            else if (arg == "--spill-dir")
+            {
+                options.spillDirectory = value();
+            }
+            else if (arg == "--memory-budget")
+            {
+                options.memoryBudget = std::stoull(value());
+            }
+            else if (arg == "--max-open-files")
+            {
+                options.openFileBudget = std::stoul(value());
+            }
+            else if (arg == "--mmap")
+            {
+                options.inputMode = InputMode::Mmap;
+            }
+            else if (arg == "--map-budget")
+            {
+                options.mapBudget = std::stoull(value());
+            }
+            else if (arg == "--block-rows")
+            {
+                options.blockRows = std::stoul(value());
+            }
+            else if (arg == "--async-io")
+            {
+                options.inputMode = InputMode::Async;
+            }
+            else if (arg == "--include")
+            {
+                discovery.patterns.push_back(value());
+            }
+            else if (arg == "--manifest")
+            {
+                discovery.manifest = value();
+            }
+            else if (arg == "--recursive")
+            {
+                discovery.recursive = true;
+            }
+            else if (arg == "--prefetch")
+            {
+                discovery.prefetchBytes = std::stoull(value());
+            }
+            else if (arg == "--batching")
+            {
+                std::string kind = value();
+                if (kind == "size")
+                {
+                    options.batching = FileMerger::Batching::Size;
+                }
+                else if (kind == "count")
+                {
+                    options.batching = FileMerger::Batching::Count;
+                }
+                else
+                {
+                    throw std::runtime_error("Unknown batching " + kind);
+                }
+            }
+            else if (arg == "--threads")
+            {
+                options.threads = std::stoul(value());
+            }
+            else if (arg == "--incremental")
+            {
+                options.incremental = true;
+            }
+            else if (arg == "--numa")
+            {
+                options.numa = NumaTopology::detect();
+            }
+            else if (arg == "--numa-simulate")
+            {
+                options.numa = NumaTopology::simulated(std::stoul(value()));
+            }
+            else if (arg == "--shard")
+            {
+                std::string spec = value();
+                const size_t slash = spec.find('/');
+                if (slash == std::string::npos)
+                {
+                    throw std::runtime_error("--shard takes INDEX/COUNT, e.g. 0/4");
+                }
+                shard.index = std::stoul(spec.substr(0, slash));
+                shard.count = std::stoul(spec.substr(slash + 1));
+                sharded = true;
+            }
+            else if (arg == "--shard-manifest")
+            {
+                shard.manifest = value();
+            }
+            else if (arg == "--merge-partials")
+            {
+                mergePartials = true;
+            }
+            else if (arg == "--replay")
+            {
+                std::string speed = value();
+                replayOptions.speed = speed == "max" ? 0.0 : std::stod(speed);
+                if (!(replayOptions.speed > 0) && speed != "max")
+                {
+                    throw std::runtime_error("--replay takes a positive speed or max");
+                }
+                replay = true;
+            }
+            else if (arg == "--replay-pacing")
+            {
+                std::string pacing = value();
+                if (pacing == "busy")
+                {
+                    replayOptions.pacing = ReplayPacing::BusyPoll;
+                }
+                else if (pacing == "hybrid")
+                {
+                    replayOptions.pacing = ReplayPacing::Hybrid;
+                }
+                else
+                {
+                    throw std::runtime_error("Unknown replay pacing " + pacing);
+                }
+            }
+            else if (arg == "--replay-shm")
+            {
+                replayRing = value();
+            }
+            else if (arg == "--replay-capacity")
+            {
+                replayCapacity = std::stoul(value());
+            }
+            else if (arg == "--replay-consume")
+            {
+                consumeRing = value();
+            }
+            else if (arg == "--live")
+            {
+                live = true;
+            }
+            else if (arg == "--lateness-ms")
+            {
+                liveOptions.latenessNanos = std::stoll(value()) * 1000000;
+            }
+            else if (arg == "--idle-ms")
+            {
+                liveOptions.idleTimeout = std::chrono::milliseconds(std::stoll(value()));
+            }
+            else if (arg == "--direct-io")
+            {
+                options.directOutput = true;
+            }
+            else if (arg == "--format")
+            {
+                std::string format = value();
+                if (format == "text")
+                {
+                    options.outputFormat = OutputFormat::Text;
+                }
+                else if (format == "columnar")
+                {
+                    options.outputFormat = OutputFormat::Columnar;
+                }
+                else
+                {
+                    throw std::runtime_error("Unknown output format " + format);
+                }
+            }
+            else if (arg == "--feed")
+            {
+                feed = value();
+                if (feed != "tick" && feed != "quote" && feed != "trade")
+                {
+                    throw std::runtime_error("Unknown feed " + feed);
+                }
+            }
+            else if (arg == "--from" || arg == "--to")
+            {
+                std::string text = value();
+                int64_t nanos = 0;
+                if (!LineParser::parseTimestamp(text, nanos))
+                {
+                    throw std::runtime_error("Invalid " + arg + " time " + text);
+                }
+                (arg == "--from" ? options.range.from : options.range.to) = nanos;
+            }
+            else if (arg == "--symbols")
+            {
+                std::stringstream list(value());
+                std::string symbol;
+                while (std::getline(list, symbol, ','))
+                {
+                    if (!symbol.empty())
+                    {
+                        options.symbols.push_back(symbol);
+                    }
+                }
+            }
+            else if (arg == "--aggregate")
+            {
+                std::stringstream list(value());
+                std::string spec;
+                while (std::getline(list, spec, ','))
+                {
+                    if (!spec.empty())
+                    {
+                        aggregations.push_back(spec);
+                    }
+                }
+            }
+            else if (arg == "--index-stride")
+            {
+                options.indexStride = static_cast<uint32_t>(std::stoul(value()));
+            }
+            else if (arg == "--io-engine")
+            {
+                std::string kind = value();
+                if (kind == "auto")
+                {
+                    IoEngine::setPreferred(IoEngine::Kind::Auto);
+                }
+                else if (kind == "uring")
+                {
+                    IoEngine::setPreferred(IoEngine::Kind::IoUring);
+                }
+                else if (kind == "threads")
+                {
+                    IoEngine::setPreferred(IoEngine::Kind::ThreadPool);
+                }
+                else
+                {
+                    throw std::runtime_error("Unknown I/O engine " + kind);
+                }
+            }
+            else if (arg == "--metrics")
+            {
+                std::string kind = value();
+                if (kind == "json")
+                {
+                    metricsFormat = MetricsFormat::Json;
+                }
+                else if (kind == "prometheus")
+                {
+                    metricsFormat = MetricsFormat::Prometheus;
+                }
+                else
+                {
+                    throw std::runtime_error("Unknown metrics format " + kind);
+                }
+                metrics = true;
+            }
+            else if (arg == "--metrics-out")
+            {
+                metricsOut = value();
+                metrics = true;
+            }
+            else if (arg == "--metrics-interval")
+            {
+                metricsInterval = std::stod(value());
+                if (!(metricsInterval > 0))
+                {
+                    throw std::runtime_error("--metrics-interval must be positive");
+                }
+            }
+            else if (arg.rfind("--", 0) == 0)
+            {
+                throw std::runtime_error("Unknown option " + arg);
+            }
+            else
+            {
+                positional.push_back(arg);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!consumeRing.empty() && positional.size() <= 1)
+    {
+        try
+        {
+            return consumeReplay(consumeRing, positional.empty() ? std::string() : positional[0]);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (positional.size() < 2)
+    {
+        printUsage(argv[0]);
         return 1;
     }
 
-    std::string inputDir = argv[1];
-    std::string outputFile = argv[2];
-    size_t batchSize = (argc >= 4) ? std::stoul(argv[3]) : 500;
+    std::string inputDir = positional[0];
+    std::string outputFile = positional[1];
+
+    // Metrics go to their target if one was given, to stdout otherwise
+    std::unique_ptr<MetricsReporter> reporter;
+    auto reportMetrics = [&]()
+    {
+        if (reporter)
+        {
+            reporter->stop();
+        }
+        else if (metrics)
+        {
+            std::cout << Metrics::render(metricsFormat);
+        }
+    };
 
     try
     {
-        auto inputFiles = FileMerger::listFiles(inputDir);
-        FileMerger::mergeFiles(inputFiles, outputFile, batchSize);
+        if (metrics)
+        {
+            Metrics::enable(true);
+            Metrics::nameThread("main");
+            if (!metricsOut.empty())
+            {
+                reporter = std::make_unique<MetricsReporter>(
+                    metricsOut, metricsFormat,
+                    std::chrono::milliseconds(static_cast<int64_t>(metricsInterval * 1000)));
+            }
+        }
+        if (positional.size() >= 3)
+        {
+            options.batchSize = std::stoul(positional[2]);
+        }
+
+        if ((!replayRing.empty() || !consumeRing.empty()) && !replay)
+        {
+            throw std::runtime_error(consumeRing.empty() ? "--replay-shm needs --replay" : "--replay-consume takes at most an output file");
+        }
+        if (live)
+        {
+            if (!aggregations.empty() || replay)
+            {
+                throw std::runtime_error("Aggregations and replays are not available in live mode");
+            }
+            if (!discovery.patterns.empty() || !discovery.manifest.empty() || discovery.recursive)
+            {
+                throw std::runtime_error("Live mode tails every file of its directory; --include, --manifest and --recursive do not apply");
+            }
+            if (options.outputFormat != OutputFormat::Text)
+            {
+                throw std::runtime_error("Live mode writes text output only");
+            }
+            if (feed != "tick")
+            {
+                throw std::runtime_error("Live mode reads tick feeds only");
+            }
+            std::signal(SIGINT, requestStop);
+            std::signal(SIGTERM, requestStop);
+            LiveMerger merger(inputDir, outputFile, liveOptions);
+            merger.run(g_stop);
+            std::cout << "Live merge stopped: " << merger.emittedRows() << " rows written, "
+                      << merger.lateRows() << " late rows dropped.\n";
+            reportMetrics();
+            return 0;
+        }
+
+        if (!shard.manifest.empty() && !sharded)
+        {
+            throw std::runtime_error("--shard-manifest needs --shard");
+        }
+        if (sharded && mergePartials)
+        {
+            throw std::runtime_error("--shard and --merge-partials are separate steps");
+        }
+
+        // The listing keeps to the merge's thread limit and NUMA placement
+        std::unique_ptr<ThreadPool> listingPool;
+        if (!options.numa.empty())
+        {
+            listingPool = std::make_unique<ThreadPool>(options.numa, options.threads);
+        }
+        else if (options.threads > 0)
+        {
+            listingPool = std::make_unique<ThreadPool>(options.threads);
+        }
+        auto inputFiles = FileDiscovery::list(inputDir, discovery, listingPool ? *listingPool : ThreadPool::shared());
+        listingPool.reset();
+        if (feed != "tick")
+        {
+            if (options.outputFormat != OutputFormat::Text || options.range.bounded() || !options.symbols.empty() ||
+                !options.numa.empty() || options.incremental || !aggregations.empty() || sharded || mergePartials ||
+                replay)
+            {
+                throw std::runtime_error("Quote and trade feeds support plain text merges only");
+            }
+            if (feed == "quote")
+            {
+                FeedMerger<QuoteSchema>::mergeFiles(inputFiles, outputFile, feedOptions<QuoteSchema>(options));
+            }
+            else
+            {
+                FeedMerger<TradeSchema>::mergeFiles(inputFiles, outputFile, feedOptions<TradeSchema>(options));
+            }
+            std::cout << "Merge completed successfully.\n";
+            reportMetrics();
+            return 0;
+        }
+        if (options.incremental && !aggregations.empty())
+        {
+            throw std::runtime_error("--aggregate needs a full merge and cannot be combined with --incremental");
+        }
+        if ((sharded || mergePartials || replay) && options.incremental)
+        {
+            throw std::runtime_error("--incremental cannot be combined with --shard, --merge-partials or --replay");
+        }
+        if (replay && (sharded || mergePartials))
+        {
+            throw std::runtime_error("--replay paces a single merge, not --shard or --merge-partials");
+        }
+        if (mergePartials && (options.range.bounded() || !options.symbols.empty()))
+        {
+            throw std::runtime_error("Filters apply when the shards are merged, not to --merge-partials");
+        }
+        if (sharded && !aggregations.empty())
+        {
+            throw std::runtime_error("Aggregate over the final output: pass --aggregate to --merge-partials");
+        }
+        for (const auto &spec : aggregations)
+        {
+            options.aggregators.push_back(Aggregator::create(spec, outputFile));
+        }
+
+        FileMerger::MergeStats stats;
+        if (mergePartials)
+        {
+            // Symbol lists and checkpoints next to the partials are not partials themselves
+            std::vector<std::string> partials;
+            for (const auto &file : inputFiles)
+            {
+                const std::string extension = std::filesystem::path(file).extension().string();
+                if (extension != ".symbols" && extension != ".checkpoint")
+                {
+                    partials.push_back(file);
+                }
+            }
+            stats = FileMerger::mergePartials(partials, outputFile, options);
+            std::cout << "Merged " << partials.size() << " partials.\n";
+        }
+        else if (sharded)
+        {
+            stats = FileMerger::mergeShard(inputFiles, outputFile, shard, options);
+            std::cout << "Shard " << shard.index << "/" << shard.count << ": "
+                      << FileMerger::shardFiles(inputFiles, shard).size() << " of " << inputFiles.size() << " files.\n";
+        }
+        else if (replay)
+        {
+            std::unique_ptr<OutputSink> file = OutputSink::open(outputFile, options.outputFormat, options.directOutput);
+            ReplaySink replaySink(replayOptions, file.get());
+            if (!replayRing.empty())
+            {
+                replaySink.publishToRing(replayRing, replayCapacity);
+                std::cout << "Waiting for a consumer on " << ShmRing::segmentName(replayRing) << "...\n";
+            }
+            stats = FileMerger::mergeFiles(inputFiles, replaySink, options);
+            const ReplayStats &replayed = replaySink.stats();
+            std::cout << "Replayed " << replayed.rows << " rows in " << replayed.groups << " publications; jitter "
+                      << replayed.jitter.summary() << " (" << replayed.jitter.count() << "), lag "
+                      << replayed.lag.summary() << " (" << replayed.lag.count() << ")";
+            if (!replayRing.empty())
+            {
+                std::cout << ", ring full " << replayed.ringFullWaits << " times";
+            }
+            std::cout << "\n";
+        }
+        else
+        {
+            stats = FileMerger::mergeFiles(inputFiles, outputFile, options);
+        }
         std::cout << "Merge completed successfully.\n";
+        if (stats.spilledRuns > 0 || options.openFileBudget > 0)
+        {
+            std::cout << "Merge passes: " << stats.passes << ", runs spilled: " << stats.spilledRuns << " ("
+                      << stats.spillBytes << " bytes), peak files open: " << stats.peakOpenFiles << "\n";
+        }
+        if (options.incremental)
+        {
+            static const char *const kUpdates[] = {"full merge", "appended", "tail re-merged"};
+            std::cout << "Incremental update: " << kUpdates[static_cast<int>(stats.update)] << ", "
+                      << stats.deltaRows << " new rows, " << stats.rewrittenRows << " output rows merged again\n";
+        }
+        if (!options.numa.empty())
+        {
+            std::cout << "NUMA nodes: " << options.numa.size() << (options.numa.isSimulated() ? " (simulated)" : "")
+                      << ", cross-node merges below the final merge: " << stats.crossNodeMerges << "\n";
+        }
+        reportMetrics();
     }
     catch (const std::exception &e)
     {
@@ -28,4 +687,4 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
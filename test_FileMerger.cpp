@@ -1,4 +1,21 @@
 #include "FileMerger.hpp"
+#include "Aggregation.hpp"
+#include "AsyncIo.hpp"
+#include "Checkpoint.hpp"
+#include "FeedMerger.hpp"
+#include "FileDiscovery.hpp"
+#include "ColumnarFile.hpp"
+#include "Compression.hpp"
+#include "LineParser.hpp"
+#include "LiveMerger.hpp"
+#include "LoserTree.hpp"
+#include "Metrics.hpp"
+#include "OutputWriter.hpp"
+#include "Replay.hpp"
+#include "TextFormat.hpp"
+#include "ThreadPool.hpp"
+#include "TickGenerator.hpp"
+#include "TimeIndex.hpp"
 #include <fstream>
 #include <filesystem>
 #include <sstream>
@@ -7,6 +24,111 @@
 #include <algorithm>
 #include <iomanip>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <numeric>
+#include <limits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Counts calls into the global allocator, for the arena test. Every replaceable
+// form goes through the two helpers; keeping them out of line stops GCC from
+// pairing an inlined free() with a new-expression (-Wmismatched-new-delete).
+namespace
+{
+    std::atomic<size_t> g_allocations{0};
+
+    [[gnu::noinline]] void *countedAllocate(std::size_t size, std::size_t alignment)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        void *memory = nullptr;
+        if (alignment <= alignof(std::max_align_t))
+        {
+            memory = std::malloc(size ? size : 1);
+        }
+        else if (::posix_memalign(&memory, alignment, size ? size : 1) != 0)
+        {
+            memory = nullptr;
+        }
+        if (!memory)
+        {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    [[gnu::noinline]] void countedRelease(void *memory) noexcept
+    {
+        std::free(memory);
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAllocate(size, 0);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAllocate(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *memory) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+    countedRelease(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+    countedRelease(memory);
+}
 
 class FileMergerTest
 {
@@ -94,7 +216,7 @@ protected:
             std::cout << "  - " << file << "\n";
         }
 
-        assert(files.size() == 6);
+        assert(files.size() == 5);
         std::cout << "✓ File count check passed\n";
 
         // Use filesystem paths for proper path handling
@@ -130,17 +252,11 @@ protected:
         const std::string outputFile = std::filesystem::path("test_data").append("output.txt").generic_string();
 
         // Get input files
-        auto inputFiles = FileMerger::listFiles("test_data");
+        std::vector<std::string> inputFiles = {
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
         std::cout << "Processing " << inputFiles.size() << " input files.\n";
 
-        inputFiles.erase(
-            std::remove_if(
-                inputFiles.begin(),
-                inputFiles.end(),
-                [](const std::string &s)
-                { return s.find("output.txt") != std::string::npos; }),
-            inputFiles.end());
-
         // Merge files
         std::cout << "Merging files with batch size 1...\n";
         FileMerger::mergeFiles(inputFiles, outputFile, 1);
@@ -329,8 +445,10 @@ protected:
             for (int j = 0; j < ENTRIES_PER_FILE; ++j)
             {
                 // Create timestamps that overlap between files
-                std::string timestamp = "2021-03-05 10:00:00.";
-                timestamp += std::to_string(j * 10 + i); // Offset each file's timestamps
+                int millis = j * 10 + i; // Offset each file's timestamps
+                std::ostringstream timestamp;
+                timestamp << "2021-03-05 10:00:" << std::setw(2) << std::setfill('0') << millis / 1000
+                          << "." << std::setw(3) << std::setfill('0') << millis % 1000;
 
                 // Generate random price between 100 and 1000
                 double price = 100.0 + (rand() % 900) + (rand() % 100) / 100.0;
@@ -345,7 +463,7 @@ protected:
                 std::string type = (j % 3 == 0) ? "Bid" : (j % 3 == 1) ? "Ask"
                                                                        : "TRADE";
 
-                content << timestamp << "," << std::fixed << std::setprecision(2)
+                content << timestamp.str() << "," << std::fixed << std::setprecision(2)
                         << price << "," << size << "," << exchange << "," << type << "\n";
             }
 
@@ -374,7 +492,7 @@ protected:
                     inputFiles.end(),
                     [](const std::string &s)
                     {
-                        return s.find("large_output_") != std::string::npos;
+                        return s.find("_large.txt") == std::string::npos;
                     }),
                 inputFiles.end());
 
@@ -425,6 +543,2029 @@ protected:
         std::cout << "Large dataset test passed!\n";
     }
 
+    void testMergeTree()
+    {
+        std::cout << "\n=== Testing Merge Tree ===\n";
+        const std::string spillDir = std::filesystem::path("test_data").append("spill").generic_string();
+        std::filesystem::create_directory(spillDir);
+
+        std::vector<std::string> inputFiles = {
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string(),
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("EMPTY.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
+
+        std::vector<std::string> expectedEntries = {
+            "AAPL,2021-03-05 09:59:59.999,150.25,100,NYSE,Bid",
+            "AAPL,2021-03-05 10:00:00.001,150.26,200,NYSE,Ask",
+            "CSCO,2021-03-05 10:00:00.123,46.14,120,NYSE_ARCA,Ask",
+            "MSFT,2021-03-05 10:00:00.123,228.5,120,NYSE,Ask",
+            "CSCO,2021-03-05 10:00:00.130,46.13,120,NYSE,TRADE",
+            "MSFT,2021-03-05 10:00:00.133,228.5,120,NYSE,TRADE",
+            "AAPL,2021-03-05 10:00:00.500,150.27,300,NYSE,TRADE"};
+
+        // One file per batch, binary tree nodes, in memory and spilled, on the
+        // shared pool and on a single worker
+        for (size_t run = 0; run < 4; ++run)
+        {
+            FileMerger::MergeOptions options;
+            options.batchSize = 1;
+            options.fanIn = 2;
+            options.maxDepth = 4;
+            options.spillDirectory = run % 2 ? spillDir : std::string();
+            options.threads = run / 2;
+
+            const std::string outputFile = std::filesystem::path("test_data").append("tree_output.txt").generic_string();
+            FileMerger::mergeFiles(inputFiles, outputFile, options);
+
+            std::ifstream output(outputFile);
+            assert(output.is_open());
+            std::string line;
+            std::getline(output, line);
+            assert(line == "Symbol,Timestamp,Price,Size,Exchange,Type");
+            for (const auto &expected : expectedEntries)
+            {
+                std::getline(output, line);
+                if (line != expected)
+                {
+                    std::cerr << "Expected: " << expected << "\n";
+                    std::cerr << "Got:      " << line << "\n";
+                    assert(false);
+                }
+            }
+            assert(!std::getline(output, line));
+        }
+
+        // Spill files are removed once the merge completes
+        assert(std::filesystem::is_empty(spillDir));
+        std::filesystem::remove(spillDir);
+        std::cout << "✓ Merge tree test passed\n";
+    }
+
+    void testBatchScheduling()
+    {
+        std::cout << "\n=== Testing Batch Scheduling ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("batching").generic_string();
+        const std::string countOutput = std::filesystem::path("test_data").append("batching_count.txt").generic_string();
+        const std::string sizeOutput = std::filesystem::path("test_data").append("batching_size.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto rowsOf = [](int rows, int offset)
+        {
+            std::string text = "Timestamp,Price,Size,Exchange,Type\n";
+            for (int i = 0; i < rows; ++i)
+            {
+                char timestamp[32];
+                std::snprintf(timestamp, sizeof(timestamp), "2021-03-05 10:%02d:%02d.%03d", (i + offset) / 60000 % 60,
+                              (i + offset) / 1000 % 60, (i + offset) % 1000);
+                text += std::string(timestamp) + ",100.25,100,NYSE," + (i % 2 ? "Bid\n" : "TRADE\n");
+            }
+            return text;
+        };
+
+        // One heavy symbol, a few medium ones and a tail of light ones
+        std::vector<std::string> inputFiles;
+        std::vector<int> rows = {2000, 600, 600, 600};
+        rows.resize(16, 50);
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            inputFiles.push_back(directory + "/S" + std::to_string(10 + i) + ".txt");
+            std::ofstream(inputFiles.back()) << rowsOf(rows[i], static_cast<int>(i) * 7);
+        }
+        const std::string heavy = inputFiles[0];
+        const uint64_t largest = std::filesystem::file_size(heavy);
+
+        // A compressed file counts at its decoded size
+        if (Codec::available(Compression::Gzip))
+        {
+            const std::string text = rowsOf(600, 3);
+            std::string packed;
+            Codec::compress(Compression::Gzip, text, packed);
+            inputFiles.push_back(directory + "/GZ.txt.gz");
+            std::ofstream(inputFiles.back(), std::ios::binary) << packed;
+            const uint64_t estimate = Codec::estimatedSize(inputFiles.back());
+            assert(packed.size() < text.size() / 2);
+            assert(estimate > text.size() * 99 / 100 && estimate < text.size() * 101 / 100);
+        }
+        std::sort(inputFiles.begin(), inputFiles.end());
+
+        // By size: a few batches per worker, each file in exactly one, loads within one file of each other
+        FileMerger::MergeOptions options;
+        ThreadPool twoWorkers(2);
+        ThreadPool oneWorker(1);
+        std::vector<FileMerger::Batch> batches = FileMerger::planBatches(inputFiles, options, twoWorkers);
+        assert(batches.size() == 8);
+        std::vector<std::string> dealt;
+        uint64_t lightest = UINT64_MAX;
+        uint64_t heaviest = 0;
+        for (const auto &batch : batches)
+        {
+            assert(!batch.files.empty() && std::is_sorted(batch.files.begin(), batch.files.end()));
+            dealt.insert(dealt.end(), batch.files.begin(), batch.files.end());
+            lightest = std::min(lightest, batch.bytes);
+            heaviest = std::max(heaviest, batch.bytes);
+            if (std::find(batch.files.begin(), batch.files.end(), heavy) != batch.files.end())
+            {
+                assert(batch.files.size() == 1 && batch.bytes == largest);
+            }
+        }
+        std::sort(dealt.begin(), dealt.end());
+        assert(dealt == inputFiles);
+        assert(heaviest - lightest <= largest);
+
+        // batchSize still caps the files per batch
+        options.batchSize = 2;
+        batches = FileMerger::planBatches(inputFiles, options, oneWorker);
+        assert(batches.size() == (inputFiles.size() + 1) / 2);
+        for (const auto &batch : batches)
+        {
+            assert(batch.files.size() <= 2);
+        }
+
+        // By count: consecutive slices, as before
+        options.batching = FileMerger::Batching::Count;
+        options.batchSize = 5;
+        batches = FileMerger::planBatches(inputFiles, options, twoWorkers);
+        assert(batches.size() == (inputFiles.size() + 4) / 5);
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            assert(batches[i].files.front() == inputFiles[i * 5] && batches[i].bytes == 0);
+        }
+
+        // Either way the output is the same
+        options.threads = 3;
+        FileMerger::mergeFiles(inputFiles, countOutput, options);
+        options.batching = FileMerger::Batching::Size;
+        FileMerger::mergeFiles(inputFiles, sizeOutput, options);
+        std::ifstream countIn(countOutput);
+        std::ifstream sizeIn(sizeOutput);
+        std::stringstream countText;
+        std::stringstream sizeText;
+        countText << countIn.rdbuf();
+        sizeText << sizeIn.rdbuf();
+        assert(!countText.str().empty() && countText.str() == sizeText.str());
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(countOutput);
+        std::filesystem::remove(sizeOutput);
+        std::cout << "✓ Batch scheduling test passed\n";
+    }
+
+    void testExternalMerge()
+    {
+        std::cout << "\n=== Testing External Merge Budgets ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("external").generic_string();
+        const std::string spillDir = std::filesystem::path("test_data").append("external_spill").generic_string();
+        const std::string reference = std::filesystem::path("test_data").append("external_reference.txt").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("external_output.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        std::filesystem::create_directory(spillDir);
+
+        auto readAll = [](const std::string &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        };
+
+        TickGeneratorOptions generator;
+        generator.files = 100;
+        generator.rows = 40000;
+        generator.seed = 11;
+        GeneratedData data = TickGenerator::generate(directory, generator);
+        FileMerger::MergeStats plain = FileMerger::mergeFiles(data.files, reference, FileMerger::MergeOptions());
+        assert(plain.passes == 2 && plain.spilledRuns == 0);
+        const std::string expected = readAll(reference);
+
+        // Six files at once: batches of four plus a spill file while the output stays open,
+        // so 25 batch runs need two levels of four-way merges before the final merge
+        FileMerger::MergeOptions options;
+        options.openFileBudget = 6;
+        options.memoryBudget = 256 * 1024;
+        options.spillDirectory = spillDir;
+        options.threads = 4;
+        FileMerger::MergeStats stats = FileMerger::mergeFiles(data.files, outputFile, options);
+        std::cout << "Passes: " << stats.passes << ", spilled runs: " << stats.spilledRuns
+                  << ", spill bytes: " << stats.spillBytes << ", peak files: " << stats.peakOpenFiles << "\n";
+        assert(readAll(outputFile) == expected);
+        assert(stats.passes >= 4);
+        assert(stats.spilledRuns > 0 && stats.spillBytes >= sizeof(MarketDataEntry) * generator.rows);
+        assert(stats.peakOpenFiles >= 2 && stats.peakOpenFiles <= 5);
+        assert(std::filesystem::is_empty(spillDir));
+
+        // A file budget alone keeps runs in memory and only adds passes
+        options.memoryBudget = 0;
+        options.spillDirectory.clear();
+        stats = FileMerger::mergeFiles(data.files, outputFile, options);
+        assert(readAll(outputFile) == expected);
+        assert(stats.spilledRuns == 0 && stats.passes >= 4);
+
+        // A memory budget alone spills to the system temp directory
+        options = FileMerger::MergeOptions();
+        options.batchSize = 8;
+        options.memoryBudget = 128 * 1024;
+        stats = FileMerger::mergeFiles(data.files, outputFile, options);
+        assert(readAll(outputFile) == expected);
+        assert(stats.spilledRuns > 0 && stats.passes == 2);
+
+        bool threw = false;
+        try
+        {
+            options.openFileBudget = 3;
+            FileMerger::mergeFiles(data.files, outputFile, options);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(spillDir);
+        std::filesystem::remove(reference);
+        std::filesystem::remove(outputFile);
+        std::cout << "✓ External merge test passed\n";
+    }
+
+    void testIncrementalMerge()
+    {
+        std::cout << "\n=== Testing Incremental Merge ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("incremental").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("incremental_output.txt").generic_string();
+        const std::string expectedFile = std::filesystem::path("test_data").append("incremental_expected.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto path = [&](const std::string &name)
+        { return std::filesystem::path(directory).append(name).generic_string(); };
+        auto append = [](const std::string &file, const std::string &rows)
+        {
+            std::ofstream out(file, std::ios::app);
+            out << rows;
+        };
+        auto readAll = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::stringstream content;
+            content << in.rdbuf();
+            return content.str();
+        };
+
+        // Every update leaves the output as a merge from scratch would
+        FileMerger::MergeOptions options;
+        options.incremental = true;
+        auto update = [&]()
+        {
+            FileMerger::MergeStats stats = FileMerger::mergeFiles(FileMerger::listFiles(directory), outputFile, options);
+            FileMerger::mergeFiles(FileMerger::listFiles(directory), expectedFile, FileMerger::MergeOptions());
+            assert(readAll(outputFile) == readAll(expectedFile));
+            return stats;
+        };
+
+        createTestFile(path("AAPL.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.100,150.25,100,NYSE,Bid\n"
+                       "2021-03-05 10:00:00.300,150.26,200,NYSE,Ask\n");
+        createTestFile(path("MSFT.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.200,228.5,120,NYSE,Ask\n");
+        FileMerger::MergeStats stats = update();
+        assert(stats.update == FileMerger::IncrementalUpdate::Full);
+        assert(std::filesystem::exists(Checkpoint::pathFor(outputFile)));
+
+        // Rows after the output's last one are appended
+        append(path("AAPL.txt"), "2021-03-05 10:00:00.400,150.27,300,NYSE,TRADE\n");
+        append(path("MSFT.txt"), "2021-03-05 10:00:00.500,228.6,100,NYSE,Bid\n");
+        stats = update();
+        assert(stats.update == FileMerger::IncrementalUpdate::Append && stats.deltaRows == 2 && stats.rewrittenRows == 0);
+
+        // A late row and a new symbol's file re-merge the output from the earliest new row
+        append(path("AAPL.txt"), "2021-03-05 10:00:00.450,150.28,50,NYSE,Ask\n");
+        createTestFile(path("CSCO.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.350,46.14,120,NYSE_ARCA,Ask\n"
+                       "2021-03-05 10:00:00.600,46.13,120,NYSE,TRADE\n");
+        stats = update();
+        assert(stats.update == FileMerger::IncrementalUpdate::Tail && stats.deltaRows == 3 && stats.rewrittenRows == 2);
+
+        // A late row tying with one already written comes after it, as in the input file
+        append(path("AAPL.txt"), "2021-03-05 10:00:00.450,150.99,75,NYSE,Bid\n");
+        stats = update();
+        assert(stats.update == FileMerger::IncrementalUpdate::Tail && stats.deltaRows == 1);
+
+        // Nothing new: nothing to do
+        stats = update();
+        assert(stats.update == FileMerger::IncrementalUpdate::Append && stats.deltaRows == 0);
+
+        // A rewritten input or an edited output cannot be resumed
+        createTestFile(path("MSFT.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.250,228.4,120,NYSE,Ask\n"
+                       "2021-03-05 10:00:00.550,228.7,100,NYSE,Bid\n");
+        assert(update().update == FileMerger::IncrementalUpdate::Full);
+        append(outputFile, "MSFT,2021-03-05 10:00:01.000,1,1,NYSE,Bid\n");
+        assert(update().update == FileMerger::IncrementalUpdate::Full);
+
+        // Checkpoints survive a round trip
+        Checkpoint checkpoint;
+        assert(checkpoint.load(Checkpoint::pathFor(outputFile)));
+        assert(checkpoint.hasLastRow && checkpoint.lastSymbol == "CSCO" && checkpoint.inputs.size() == 3);
+        assert(checkpoint.outputSize == std::filesystem::file_size(outputFile));
+        assert(checkpoint.byPath().at(path("AAPL.txt"))->offset == std::filesystem::file_size(path("AAPL.txt")));
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(outputFile);
+        std::filesystem::remove(expectedFile);
+        std::filesystem::remove(Checkpoint::pathFor(outputFile));
+        std::cout << "✓ Incremental merge test passed\n";
+    }
+
+    void testAggregations()
+    {
+        std::cout << "\n=== Testing Aggregations ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("aggregate").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("aggregate_output.txt").generic_string();
+        const std::string plainFile = std::filesystem::path("test_data").append("aggregate_plain.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto path = [&](const std::string &name)
+        { return std::filesystem::path(directory).append(name).generic_string(); };
+        auto readLines = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(in, line))
+            {
+                lines.push_back(line);
+            }
+            return lines;
+        };
+
+        createTestFile(path("AAPL.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.100,150.00,100,NYSE,Bid\n"
+                       "2021-03-05 10:00:00.200,150.10,200,NASDAQ,Bid\n"
+                       "2021-03-05 10:00:00.300,150.30,100,NYSE,Ask\n"
+                       "2021-03-05 10:00:00.400,150.20,100,NYSE,TRADE\n"
+                       "2021-03-05 10:00:00.900,150.40,300,NYSE,TRADE\n"
+                       "2021-03-05 10:00:01.100,150.10,100,NASDAQ,TRADE\n"
+                       "2021-03-05 10:00:01.200,150.10,0,NASDAQ,Bid\n");
+        createTestFile(path("MSFT.txt"),
+                       "Timestamp,Price,Size,Exchange,Type\n"
+                       "2021-03-05 10:00:00.500,228.50,100,NYSE,TRADE\n"
+                       "2021-03-05 10:00:00.600,228.50,100,NYSE,Bid\n"
+                       "2021-03-05 10:00:00.700,228.50,50,NASDAQ,Bid\n"
+                       "2021-03-05 10:00:02.500,229.00,200,NYSE,TRADE\n");
+
+        FileMerger::MergeOptions options;
+        for (const char *spec : {"bars:1s", "vwap", "top-of-book"})
+        {
+            options.aggregators.push_back(Aggregator::create(spec, outputFile));
+        }
+        FileMerger::mergeFiles(FileMerger::listFiles(directory), outputFile, options);
+        FileMerger::mergeFiles(FileMerger::listFiles(directory), plainFile, FileMerger::MergeOptions());
+        assert(readLines(outputFile) == readLines(plainFile));
+
+        // Bars close as the merge passes them, in symbol order within an interval
+        const std::vector<std::string> bars = {
+            "Symbol,BarStart,Open,High,Low,Close,Volume,VWAP,Trades",
+            "AAPL,2021-03-05 10:00:00.000,150.2,150.4,150.2,150.4,400,150.35,2",
+            "MSFT,2021-03-05 10:00:00.000,228.5,228.5,228.5,228.5,100,228.5,1",
+            "AAPL,2021-03-05 10:00:01.000,150.1,150.1,150.1,150.1,100,150.1,1",
+            "MSFT,2021-03-05 10:00:02.000,229,229,229,229,200,229,1"};
+        assert(readLines(outputFile + ".bars-1s.csv") == bars);
+
+        const std::vector<std::string> vwap = {
+            "Symbol,Trades,Volume,VWAP,FirstTrade,LastTrade",
+            "AAPL,3,500,150.3,2021-03-05 10:00:00.400,2021-03-05 10:00:01.100",
+            "MSFT,2,300,228.83333333,2021-03-05 10:00:00.500,2021-03-05 10:00:02.500"};
+        assert(readLines(outputFile + ".vwap.csv") == vwap);
+
+        // Sizes at the best price add up across exchanges; a size of 0 withdraws a quote
+        const std::vector<std::string> topOfBook = {
+            "Symbol,Timestamp,BidPrice,BidSize,AskPrice,AskSize",
+            "AAPL,2021-03-05 10:00:00.100,150,100,,",
+            "AAPL,2021-03-05 10:00:00.200,150.1,200,,",
+            "AAPL,2021-03-05 10:00:00.300,150.1,200,150.3,100",
+            "MSFT,2021-03-05 10:00:00.600,228.5,100,,",
+            "MSFT,2021-03-05 10:00:00.700,228.5,150,,",
+            "AAPL,2021-03-05 10:00:01.200,150,100,150.3,100"};
+        assert(readLines(outputFile + ".top-of-book.csv") == topOfBook);
+
+        assert(Aggregator::parseInterval("500ms") == 500000000);
+        assert(Aggregator::parseInterval("5m") == 300000000000ll);
+        for (const char *spec : {"bars:1d", "bars:0s", "bars:", "median"})
+        {
+            bool threw = false;
+            try
+            {
+                Aggregator::create(spec, outputFile);
+            }
+            catch (const std::runtime_error &)
+            {
+                threw = true;
+            }
+            assert(threw);
+        }
+
+        std::filesystem::remove_all(directory);
+        for (const std::string &file : {outputFile, plainFile, outputFile + ".bars-1s.csv", outputFile + ".vwap.csv",
+                                        outputFile + ".top-of-book.csv"})
+        {
+            std::filesystem::remove(file);
+        }
+        std::cout << "✓ Aggregation test passed\n";
+    }
+
+    void testShardedMerge()
+    {
+        std::cout << "\n=== Testing Sharded Merge ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("shards").generic_string();
+        const std::string partials = std::filesystem::path("test_data").append("partials").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("sharded_output.txt").generic_string();
+        const std::string expectedFile = std::filesystem::path("test_data").append("sharded_expected.txt").generic_string();
+        const std::string manifest = std::filesystem::path("test_data").append("shards.manifest").generic_string();
+        std::filesystem::create_directory(directory);
+        std::filesystem::create_directory(partials);
+        auto readAll = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::stringstream content;
+            content << in.rdbuf();
+            return content.str();
+        };
+
+        // Symbols interleave in time, so every partial contributes throughout
+        const std::vector<std::string> symbols = {"AAPL", "CSCO", "IBM", "INTC", "MSFT", "ORCL"};
+        for (size_t s = 0; s < symbols.size(); ++s)
+        {
+            std::string rows = "Timestamp,Price,Size,Exchange,Type\n";
+            for (int i = 0; i < 20; ++i)
+            {
+                rows += "2021-03-05 10:00:00." + std::to_string(100 + i * 10 + static_cast<int>(s % 3)) + "," +
+                        std::to_string(100 + s) + "." + std::to_string(i) + ",100,NYSE," + (i % 2 ? "Bid\n" : "TRADE\n");
+            }
+            createTestFile(std::filesystem::path(directory).append(symbols[s] + ".txt").generic_string(), rows);
+        }
+        const std::vector<std::string> inputFiles = FileMerger::listFiles(directory);
+        FileMerger::mergeFiles(inputFiles, expectedFile, FileMerger::MergeOptions());
+
+        // Every file lands in exactly one shard, the same one on every call
+        constexpr size_t kShards = 3;
+        std::vector<std::string> assigned;
+        for (size_t index = 0; index < kShards; ++index)
+        {
+            FileMerger::Shard shard;
+            shard.index = index;
+            shard.count = kShards;
+            std::vector<std::string> files = FileMerger::shardFiles(inputFiles, shard);
+            assert(files == FileMerger::shardFiles(inputFiles, shard));
+            assigned.insert(assigned.end(), files.begin(), files.end());
+            FileMerger::mergeShard(inputFiles, std::filesystem::path(partials).append("part" + std::to_string(index) + ".txt").generic_string(),
+                                   shard, FileMerger::MergeOptions());
+        }
+        std::sort(assigned.begin(), assigned.end());
+        assert(assigned == inputFiles);
+
+        // The hashed split is a contract between hosts, so pin it
+        const std::vector<std::pair<std::string, std::vector<size_t>>> pinned = {
+            {"AAPL", {2, 3}}, {"CSCO", {2, 0}}, {"IBM", {0, 3}}, {"INTC", {1, 0}}, {"MSFT", {1, 3}}, {"ORCL", {2, 2}}};
+        for (const auto &[symbol, indexes] : pinned)
+        {
+            const std::string file = std::filesystem::path(directory).append(symbol + ".txt").generic_string();
+            for (size_t count = 3; count <= 4; ++count)
+            {
+                FileMerger::Shard shard;
+                shard.index = indexes[count - 3];
+                shard.count = count;
+                assert(FileMerger::shardFiles({file}, shard) == std::vector<std::string>{file});
+            }
+        }
+
+        std::vector<std::string> partialFiles;
+        for (size_t index = 0; index < kShards; ++index)
+        {
+            partialFiles.push_back(std::filesystem::path(partials).append("part" + std::to_string(index) + ".txt").generic_string());
+        }
+        FileMerger::mergePartials(partialFiles, outputFile, FileMerger::MergeOptions());
+        assert(readAll(outputFile) == readAll(expectedFile));
+
+        // Without their symbol lists the partials are scanned for symbols
+        for (const auto &partial : partialFiles)
+        {
+            std::filesystem::remove(FileMerger::symbolsPathFor(partial));
+        }
+        FileMerger::mergePartials(partialFiles, outputFile, FileMerger::MergeOptions());
+        assert(readAll(outputFile) == readAll(expectedFile));
+
+        // A manifest places symbols explicitly; a shard left without files gets an empty partial
+        createTestFile(manifest, "# symbol shard\nAAPL 1\nCSCO 1\nIBM 1\nINTC 1\nMSFT 1\nORCL 1\n");
+        for (size_t index = 0; index < 2; ++index)
+        {
+            FileMerger::Shard shard;
+            shard.index = index;
+            shard.count = 2;
+            shard.manifest = manifest;
+            assert(FileMerger::shardFiles(inputFiles, shard).size() == (index == 1 ? inputFiles.size() : 0));
+            FileMerger::mergeShard(inputFiles, partialFiles[index], shard, FileMerger::MergeOptions());
+        }
+        assert(readAll(partialFiles[0]) == "Symbol,Timestamp,Price,Size,Exchange,Type\n");
+        FileMerger::mergePartials({partialFiles[0], partialFiles[1]}, outputFile, FileMerger::MergeOptions());
+        assert(readAll(outputFile) == readAll(expectedFile));
+
+        bool threw = false;
+        try
+        {
+            FileMerger::Shard shard;
+            shard.index = 2;
+            shard.count = 2;
+            FileMerger::shardFiles(inputFiles, shard);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove_all(partials);
+        std::filesystem::remove(outputFile);
+        std::filesystem::remove(expectedFile);
+        std::filesystem::remove(manifest);
+        std::cout << "✓ Sharded merge test passed\n";
+    }
+
+    void testReplay()
+    {
+        std::cout << "\n=== Testing Replay ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("replay").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("replay_output.txt").generic_string();
+        const std::string expectedFile = std::filesystem::path("test_data").append("replay_expected.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto readAll = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::stringstream content;
+            content << in.rdbuf();
+            return content.str();
+        };
+
+        // 60 rows over 120ms, with two symbols sharing every fourth timestamp
+        for (const std::string symbol : {"AAPL", "MSFT"})
+        {
+            std::string rows = "Timestamp,Price,Size,Exchange,Type\n";
+            for (int i = 0; i < 30; ++i)
+            {
+                const int millis = i * 4 + (symbol == "MSFT" && i % 4 != 0 ? 2 : 0);
+                char time[16];
+                std::snprintf(time, sizeof(time), "%03d", millis);
+                rows += std::string("2021-03-05 10:00:00.") + time + ",100." + std::to_string(i) + ",10,NYSE,TRADE\n";
+            }
+            createTestFile(std::filesystem::path(directory).append(symbol + ".txt").generic_string(), rows);
+        }
+        const std::vector<std::string> inputFiles = FileMerger::listFiles(directory);
+        FileMerger::mergeFiles(inputFiles, expectedFile, FileMerger::MergeOptions());
+
+        // As fast as possible: callbacks get every row, grouped by timestamp, and the
+        // inner sink writes the usual output
+        {
+            ReplayOptions options;
+            options.speed = 0;
+            std::unique_ptr<OutputSink> file = OutputSink::open(outputFile, OutputFormat::Text);
+            ReplaySink replay(options, file.get());
+            size_t rows = 0;
+            bool grouped = true;
+            replay.subscribe([&](const MarketDataEntry *entries, size_t count)
+                             {
+                                 rows += count;
+                                 for (size_t i = 1; i < count; ++i)
+                                 {
+                                     grouped = grouped && entries[i].timestamp == entries[0].timestamp;
+                                 } });
+            FileMerger::mergeFiles(inputFiles, replay, FileMerger::MergeOptions());
+            assert(rows == 60 && grouped);
+            assert(replay.stats().rows == 60 && replay.stats().groups == 52);
+            assert(replay.stats().jitter.count() == 0 && replay.stats().lag.count() == 0);
+            assert(readAll(outputFile) == readAll(expectedFile));
+        }
+
+        // A timestamp with more rows than one sink write still goes out as one group
+        {
+            const std::string burst = std::filesystem::path("test_data").append("replay_burst").generic_string();
+            std::filesystem::create_directory(burst);
+            for (const std::string symbol : {"AAPL", "CSCO", "MSFT"})
+            {
+                std::string rows = "Timestamp,Price,Size,Exchange,Type\n";
+                for (int i = 0; i < 500; ++i)
+                {
+                    rows += "2021-03-05 10:00:00.000,100." + std::to_string(i) + ",10,NYSE,TRADE\n";
+                }
+                rows += "2021-03-05 10:00:00.001,101.0,10,NYSE,TRADE\n";
+                createTestFile(std::filesystem::path(burst).append(symbol + ".txt").generic_string(), rows);
+            }
+            ReplayOptions options;
+            options.speed = 0;
+            ReplaySink replay(options);
+            std::vector<size_t> groups;
+            replay.subscribe([&](const MarketDataEntry *, size_t count)
+                             { groups.push_back(count); });
+            FileMerger::mergeFiles(FileMerger::listFiles(burst), replay, FileMerger::MergeOptions());
+            assert((groups == std::vector<size_t>{1500, 3}));
+            assert(replay.stats().rows == 1503 && replay.stats().groups == 2);
+            std::filesystem::remove_all(burst);
+        }
+
+        // Paced at 4x, the 116ms between the first and last row take 29ms
+        {
+            ReplayOptions options;
+            options.speed = 4;
+            options.pacing = ReplayPacing::BusyPoll;
+            ReplaySink replay(options);
+            std::vector<int64_t> published;
+            replay.subscribe([&](const MarketDataEntry *, size_t)
+                             { published.push_back(ReplaySink::nowNanos()); });
+            FileMerger::mergeFiles(inputFiles, replay, FileMerger::MergeOptions());
+            assert(published.size() == 52);
+            assert(published.back() - published.front() >= 29000000);
+            assert(replay.stats().jitter.count() + replay.stats().lag.count() == 52);
+        }
+
+        // A consumer on the shared-memory ring sees the rows, in order, with the symbols
+        {
+            const std::string ring = "mdf-test-" + std::to_string(::getpid());
+            ReplayOptions options;
+            options.speed = 0;
+            ReplaySink replay(options);
+            replay.publishToRing(ring, 16); // Smaller than the merge, so the producer waits for room
+            std::vector<std::string> consumed;
+            std::thread consumer([&]()
+                                 {
+                                     ShmRingReader reader(ring, std::chrono::seconds(10));
+                                     ShmRing::Slot slots[8];
+                                     while (!reader.finished())
+                                     {
+                                         const size_t count = reader.read(slots, 8);
+                                         for (size_t i = 0; i < count; ++i)
+                                         {
+                                             std::string row;
+                                             TextFormat::appendEntry(row, slots[i].entry, reader.symbols());
+                                             consumed.push_back(row);
+                                         }
+                                         if (count == 0)
+                                         {
+                                             std::this_thread::yield();
+                                         }
+                                     } });
+            FileMerger::mergeFiles(inputFiles, replay, FileMerger::MergeOptions());
+            consumer.join();
+            std::string rows = "Symbol,Timestamp,Price,Size,Exchange,Type\n";
+            for (const auto &row : consumed)
+            {
+                rows += row;
+            }
+            assert(rows == readAll(expectedFile));
+            assert(replay.stats().ringFullWaits > 0);
+        }
+
+        // A producer gives up on a consumer that never attaches, and on one that
+        // detaches or dies while the ring is full
+        {
+            const std::string ring = "mdf-test-" + std::to_string(::getpid());
+            const SymbolTable symbols(std::vector<std::string>{"AAPL"});
+            const std::vector<MarketDataEntry> entries(8, MarketDataEntry{});
+            auto overflowThrows = [&](ShmRing &producer)
+            {
+                try
+                {
+                    producer.push(entries.data(), entries.size(), 0);
+                }
+                catch (const std::runtime_error &)
+                {
+                    return true;
+                }
+                return false;
+            };
+            {
+                ShmRing producer(ring, 4, symbols);
+                bool threw = false;
+                try
+                {
+                    producer.waitForConsumer(std::chrono::milliseconds(10));
+                }
+                catch (const std::runtime_error &)
+                {
+                    threw = true;
+                }
+                assert(threw);
+                {
+                    ShmRingReader reader(ring, std::chrono::seconds(10));
+                }
+                producer.waitForConsumer(std::chrono::milliseconds(10));
+                assert(overflowThrows(producer));
+            }
+            {
+                ShmRing producer(ring, 4, symbols);
+                const pid_t child = ::fork();
+                if (child == 0)
+                {
+                    // Exit without detaching, as a crash would
+                    ShmRingReader reader(ring, std::chrono::seconds(10));
+                    ::_exit(0);
+                }
+                producer.waitForConsumer(std::chrono::seconds(10));
+                int status = 0;
+                ::waitpid(child, &status, 0);
+                assert(overflowThrows(producer));
+            }
+        }
+
+        LatencyHistogram histogram;
+        for (uint64_t nanos = 1; nanos <= 1000; ++nanos)
+        {
+            histogram.record(nanos);
+        }
+        assert(histogram.count() == 1000 && histogram.max() == 1000);
+        assert(histogram.quantile(0.5) >= 480 && histogram.quantile(0.5) <= 500);
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(outputFile);
+        std::filesystem::remove(expectedFile);
+        std::cout << "✓ Replay test passed\n";
+    }
+
+    void testFileDiscovery()
+    {
+        std::cout << "\n=== Testing File Discovery ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("discovery").generic_string();
+        const std::string manifest = std::filesystem::path("test_data").append("discovery.manifest").generic_string();
+        std::filesystem::create_directories(directory + "/nested/deeper");
+        std::filesystem::create_directories(directory + "/skipped");
+        for (const std::string name : {"AAPL.txt", "MSFT.txt.gz", "notes.md", "nested/IBM.txt", "nested/deeper/ORCL.txt",
+                                       "skipped/INTC.txt"})
+        {
+            createTestFile(directory + "/" + name, "Timestamp,Price,Size,Exchange,Type\n");
+        }
+        std::filesystem::create_symlink("AAPL.txt", directory + "/LINK.txt");
+        std::filesystem::create_directory_symlink("nested", directory + "/loop");
+
+        // Without options it lists what a directory_iterator would, symlinked files included
+        const std::vector<std::string> plain = FileDiscovery::list(directory);
+        std::vector<std::string> expected;
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.is_regular_file())
+            {
+                expected.push_back(entry.path().generic_string());
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        assert(plain == expected);
+        assert(plain.size() == 4);
+        assert(FileMerger::listFiles(directory + "/") == plain);
+
+        // Recursive, filtered by glob, on a pool of its own; symlinked directories are not followed
+        FileDiscovery::Options options;
+        options.recursive = true;
+        options.patterns = {"*.txt", "*.txt.gz"};
+        options.prefetchBytes = 4096;
+        ThreadPool pool(2);
+        const std::vector<std::string> found = FileDiscovery::list(directory, options, pool);
+        const std::vector<std::string> recursive = {directory + "/AAPL.txt", directory + "/LINK.txt",
+                                                    directory + "/MSFT.txt.gz", directory + "/nested/IBM.txt",
+                                                    directory + "/nested/deeper/ORCL.txt", directory + "/skipped/INTC.txt"};
+        assert(found == recursive);
+
+        // A manifest picks files by relative path
+        createTestFile(manifest, "# morning session\nAAPL.txt\n./nested/deeper/ORCL.txt\n\nmissing/GONE.txt\n");
+        options.patterns.clear();
+        options.manifest = manifest;
+        const std::vector<std::string> listed = FileDiscovery::list(directory, options, pool);
+        assert((listed == std::vector<std::string>{directory + "/AAPL.txt", directory + "/nested/deeper/ORCL.txt"}));
+
+        bool threw = false;
+        try
+        {
+            FileDiscovery::list(directory + "/absent");
+        }
+        catch (const std::exception &)
+        {
+            threw = true;
+        }
+        assert(threw);
+
+        // Hidden entries are skipped, time-index sidecars left by a range-filtered merge among them
+        const std::string ranged = directory + "/ranged";
+        std::filesystem::create_directory(ranged);
+        const std::string rows = "Timestamp,Price,Size,Exchange,Type\n"
+                                 "2021-03-05 10:00:00.100,150.25,100,NYSE,Bid\n"
+                                 "2021-03-05 10:00:00.300,150.26,200,NYSE,Ask\n";
+        createTestFile(ranged + "/AAPL.txt", rows);
+        createTestFile(ranged + "/CSCO.txt", rows);
+        createTestFile(ranged + "/.notes.txt", rows);
+        FileMerger::MergeOptions merge;
+        const bool parsed = LineParser::parseTimestamp("2021-03-05 10:00:00.200", merge.range.from);
+        assert(parsed);
+        FileMerger::mergeFiles(FileDiscovery::list(ranged), directory + "/ranged_output.txt", merge);
+        assert(std::filesystem::exists(TimeIndex::sidecarPath(ranged + "/AAPL.txt")));
+        FileDiscovery::Options hidden;
+        hidden.recursive = true;
+        for (int run = 0; run < 2; ++run)
+        {
+            assert((FileDiscovery::list(ranged, hidden, pool) == std::vector<std::string>{ranged + "/AAPL.txt", ranged + "/CSCO.txt"}));
+            FileMerger::mergeFiles(FileDiscovery::list(ranged, hidden, pool), directory + "/ranged_output.txt", merge);
+        }
+        assert(!std::filesystem::exists(ranged + "/.mdf-index/.mdf-index"));
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(manifest);
+        std::cout << "✓ File discovery test passed\n";
+    }
+
+    void testFeedSchemas()
+    {
+        std::cout << "\n=== Testing Feed Schemas ===\n";
+        static_assert(SchemaTraits<QuoteSchema>::kFields == 6, "Quote schema has six columns");
+        static_assert(SchemaTraits<TradeSchema>::name(4) == "Conditions", "Column names come from the table");
+
+        const std::string directory = std::filesystem::path("test_data").append("feeds").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("feed_output.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto path = [&](const std::string &name)
+        { return std::filesystem::path(directory).append(name).generic_string(); };
+        auto readLines = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(in, line))
+            {
+                lines.push_back(line);
+            }
+            return lines;
+        };
+
+        createTestFile(path("MSFT.q"),
+                       "Timestamp,BidPrice,BidSize,AskPrice,AskSize,Exchange\n"
+                       "2021-03-05 10:00:00.100,228.49,300,228.51,200,NASDAQ\n"
+                       "2021-03-05 10:00:00.200,228.50,100,228.52,400,NYSE\n");
+        createTestFile(path("CSCO.q"),
+                       "Timestamp,BidPrice,BidSize,AskPrice,AskSize,Exchange\n"
+                       "2021-03-05 10:00:00.100, 46.13 ,500,46.14,500,NYSE_ARCA\n"
+                       "2021-03-05 10:00:00.150,46.12,100,46.15,100,NASDAQ\n");
+        FeedMerger<QuoteSchema>::Options options;
+        options.batchSize = 1;
+        FeedMerger<QuoteSchema>::mergeFiles({path("CSCO.q"), path("MSFT.q")}, outputFile, options);
+        std::vector<std::string> expected = {
+            "Symbol,Timestamp,BidPrice,BidSize,AskPrice,AskSize,Exchange",
+            "CSCO,2021-03-05 10:00:00.100,46.13,500,46.14,500,NYSE_ARCA",
+            "MSFT,2021-03-05 10:00:00.100,228.49,300,228.51,200,NASDAQ",
+            "CSCO,2021-03-05 10:00:00.150,46.12,100,46.15,100,NASDAQ",
+            "MSFT,2021-03-05 10:00:00.200,228.5,100,228.52,400,NYSE"};
+        assert(readLines(outputFile) == expected);
+
+        createTestFile(path("AAPL.t"),
+                       "Timestamp,Price,Size,Exchange,Conditions\n"
+                       "2021-03-05 10:00:00.300,150.25,100,NYSE,@FTI\n"
+                       "2021-03-05 10:00:00.400,150.26,20,NASDAQ,\n");
+        createTestFile(path("IBM.t"),
+                       "Timestamp,Price,Size,Exchange,Conditions\n"
+                       "2021-03-05 10:00:00.350,120.1,10,NYSE,O\n");
+        FeedMerger<TradeSchema>::mergeFiles({path("AAPL.t"), path("IBM.t")}, outputFile, FeedMerger<TradeSchema>::Options());
+        expected = {
+            "Symbol,Timestamp,Price,Size,Exchange,Conditions",
+            "AAPL,2021-03-05 10:00:00.300,150.25,100,NYSE,@FTI",
+            "IBM,2021-03-05 10:00:00.350,120.1,10,NYSE,O",
+            "AAPL,2021-03-05 10:00:00.400,150.26,20,NASDAQ,"};
+        assert(readLines(outputFile) == expected);
+
+        // The tick schema reproduces the hand-written tick reader
+        std::vector<std::string> tickFiles = {
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string(),
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("EMPTY.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
+        const std::string tickOutput = std::filesystem::path("test_data").append("tick_output.txt").generic_string();
+        FileMerger::mergeFiles(tickFiles, tickOutput, 2);
+        FeedMerger<TickSchema>::mergeFiles(tickFiles, outputFile, FeedMerger<TickSchema>::Options());
+        assert(readLines(outputFile) == readLines(tickOutput));
+
+        // Wrong layout, bad values and oversized codes are rejected
+        auto fails = [&](auto merge)
+        {
+            try
+            {
+                merge();
+            }
+            catch (const std::runtime_error &)
+            {
+                return true;
+            }
+            return false;
+        };
+        assert(fails([&]()
+                     { FeedMerger<QuoteSchema>::mergeFiles({path("AAPL.t")}, outputFile, options); }));
+        createTestFile(path("BAD.t"), "Timestamp,Price,Size,Exchange,Conditions\n"
+                                      "2021-03-05 10:00:00.300,150.25,5000000000,NYSE,@\n");
+        assert(fails([&]()
+                     { FeedMerger<TradeSchema>::mergeFiles({path("BAD.t")}, outputFile, FeedMerger<TradeSchema>::Options()); }));
+        createTestFile(path("LONG.t"), "Timestamp,Price,Size,Exchange,Conditions\n"
+                                       "2021-03-05 10:00:00.300,150.25,5,NYSE,ABCDE\n");
+        assert(fails([&]()
+                     { FeedMerger<TradeSchema>::mergeFiles({path("LONG.t")}, outputFile, FeedMerger<TradeSchema>::Options()); }));
+
+        std::filesystem::remove_all(directory);
+        std::filesystem::remove(outputFile);
+        std::filesystem::remove(tickOutput);
+        std::cout << "✓ Feed schema test passed\n";
+    }
+
+    void testThreadPool()
+    {
+        std::cout << "\n=== Testing Thread Pool ===\n";
+        ThreadPool pool(3);
+
+        // Tasks spawning tasks, as merge-tree nodes do once their inputs are done
+        std::atomic<int> count{0};
+        TaskGroup group(pool);
+        std::function<void(int)> spawn = [&](int depth)
+        {
+            count.fetch_add(1);
+            if (depth < 6)
+            {
+                group.run([&, depth]() { spawn(depth + 1); });
+                group.run([&, depth]() { spawn(depth + 1); });
+            }
+        };
+        group.run([&]() { spawn(0); });
+        group.wait();
+        assert(count.load() == 127);
+
+        // The first failure surfaces from wait(); the other tasks still finish
+        TaskGroup failing(pool);
+        count = 0;
+        for (int i = 0; i < 20; ++i)
+        {
+            failing.run([&, i]()
+                        {
+                            if (i == 7)
+                            {
+                                throw std::runtime_error("task 7");
+                            }
+                            count.fetch_add(1); });
+        }
+        bool caught = false;
+        try
+        {
+            failing.wait();
+        }
+        catch (const std::runtime_error &e)
+        {
+            caught = std::string(e.what()) == "task 7";
+        }
+        assert(caught && failing.failed() && count.load() == 19);
+
+        std::cout << "✓ Thread pool test passed\n";
+    }
+
+    void testNumaPlacement()
+    {
+        std::cout << "\n=== Testing NUMA Placement ===\n";
+        assert((NumaTopology::parseCpuList("0-2,5,7-8\n") == std::vector<int>{0, 1, 2, 5, 7, 8}));
+        assert(NumaTopology::parseCpuList("").empty());
+        assert(!NumaTopology::detect().empty());
+
+        const NumaTopology topology = NumaTopology::simulated(3);
+        assert(topology.size() == 3 && topology.isSimulated());
+        for (size_t node = 0; node < topology.size(); ++node)
+        {
+            assert(!topology.node(node).cpus.empty());
+        }
+
+        // Pinned tasks, and the tasks they pin elsewhere, run on their own node's workers
+        ThreadPool pool(NumaTopology::simulated(2), 3);
+        assert(pool.nodes() == 2 && pool.size() == 3);
+        assert(ThreadPool::currentNode() == ThreadPool::kAnyNode);
+        std::atomic<int> misplaced{0};
+        std::atomic<int> count{0};
+        TaskGroup group(pool);
+        for (size_t i = 0; i < 40; ++i)
+        {
+            const size_t node = i % 2;
+            group.run([&, node]()
+                      {
+                          misplaced += ThreadPool::currentNode() != node;
+                          group.run([&, node]()
+                                    {
+                                        misplaced += ThreadPool::currentNode() != 1 - node;
+                                        ++count; },
+                                    1 - node);
+                          ++count; },
+                      node);
+        }
+        group.run([&]() { ++count; });
+        group.wait();
+        assert(misplaced.load() == 0 && count.load() == 81);
+
+        // Runs of one node are merged on that node; the output is unchanged
+        std::vector<std::string> inputFiles = {
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string(),
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("EMPTY.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
+        auto readAll = [](const std::string &file)
+        {
+            std::ifstream in(file);
+            std::stringstream content;
+            content << in.rdbuf();
+            return content.str();
+        };
+        const std::string expectedFile = std::filesystem::path("test_data").append("numa_expected.txt").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("numa_output.txt").generic_string();
+        FileMerger::MergeOptions options;
+        options.batchSize = 1;
+        options.fanIn = 2;
+        options.maxDepth = 4;
+        FileMerger::mergeFiles(inputFiles, expectedFile, options);
+
+        options.numa = NumaTopology::simulated(2);
+        FileMerger::MergeStats stats = FileMerger::mergeFiles(inputFiles, outputFile, options);
+        assert(readAll(outputFile) == readAll(expectedFile));
+        assert(stats.passes == 3 && stats.crossNodeMerges == 0);
+
+        // With a run per node, the tree has to mix nodes below the final merge
+        options.numa = NumaTopology::simulated(4);
+        stats = FileMerger::mergeFiles(inputFiles, outputFile, options);
+        assert(readAll(outputFile) == readAll(expectedFile));
+        assert(stats.crossNodeMerges == 2);
+
+        std::filesystem::remove(expectedFile);
+        std::filesystem::remove(outputFile);
+        std::cout << "✓ NUMA placement test passed\n";
+    }
+
+    void testLineParser()
+    {
+        std::cout << "\n=== Testing Line Parser ===\n";
+        const std::string data =
+            "2021-03-05 10:00:00.140, 46.15, 100, NASDAQ, Bid \r\n"
+            "2021-03-05 10:00:00.150,46.16,-5,NYSE,TRADE,extra,fields,to,cross,a,simd,block\n"
+            "tail,without,newline";
+
+        for (auto isa : {LineParser::Isa::Scalar, LineParser::Isa::SSE2, LineParser::Isa::AVX2})
+        {
+            LineParser::forceIsa(isa);
+            const char *p = data.data();
+            const char *end = p + data.size();
+            const char *delimiters[16];
+            size_t count = 0;
+
+            const char *newline = LineParser::scanLine(p, end, delimiters, 16, count);
+            assert(newline && *newline == '\n' && count == 4);
+            std::string_view fields[5];
+            assert(LineParser::splitFields(p, newline, fields, 5) == 5);
+            assert(fields[0] == "2021-03-05 10:00:00.140" && fields[3] == "NASDAQ" && fields[4] == "Bid");
+
+            p = newline + 1;
+            newline = LineParser::scanLine(p, end, delimiters, 16, count);
+            assert(newline && count == 11);
+
+            p = newline + 1;
+            assert(LineParser::scanLine(p, end, delimiters, 16, count) == nullptr && count == 2);
+        }
+
+        double price = 0;
+        int64_t size = 0;
+        assert(LineParser::parsePrice("46.14", price) && price == 46.14);
+        assert(LineParser::parsePrice("-0.5", price) && price == -0.5);
+        assert(LineParser::parseInt("+120", size) && size == 120);
+        assert(!LineParser::parsePrice("invalid_price", price));
+        assert(!LineParser::parseInt("12x", size));
+        assert(!LineParser::parseInt("+-5", size));
+        assert(!LineParser::parsePrice("+-0.5", price));
+        assert(!LineParser::parseInt("+", size));
+        assert(LineParser::parseInt("-5", size) && size == -5);
+        std::cout << "✓ Line parser test passed\n";
+    }
+
+    void testMappedInput()
+    {
+        std::cout << "\n=== Testing Memory-Mapped Input ===\n";
+
+        // Enough rows to span many pages, plus a line longer than the mapping window
+        std::ostringstream content;
+        content << "Timestamp, Price, Size, Exchange, Type\n";
+        for (int i = 0; i < 3000; ++i)
+        {
+            content << "2021-03-05 11:00:" << std::setw(2) << std::setfill('0') << i / 1000 << "."
+                    << std::setw(3) << i % 1000 << ", " << 10 + i % 7 << ".25, " << i << ", "
+                    << (i == 1500 ? std::string(10000, 'X') : std::string("NYSE")) << ", TRADE\n";
+        }
+        const std::string inputFile = std::filesystem::path("test_data").append("IBM.txt").generic_string();
+        createTestFile(inputFile, content.str());
+
+        std::vector<std::string> inputFiles = {
+            inputFile,
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string()};
+        const std::string streamOutput = std::filesystem::path("test_data").append("stream_output.txt").generic_string();
+        const std::string mappedOutput = std::filesystem::path("test_data").append("mapped_output.txt").generic_string();
+
+        FileMerger::mergeFiles(inputFiles, streamOutput, 1);
+
+        FileMerger::MergeOptions options;
+        options.batchSize = 1;
+        options.inputMode = InputMode::Mmap;
+        options.mapBudget = 4096; // Forces sliding windows
+        FileMerger::mergeFiles(inputFiles, mappedOutput, options);
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+        std::string expected = slurp(streamOutput);
+        assert(std::count(expected.begin(), expected.end(), '\n') == 3000 + 3 + 1);
+        assert(slurp(mappedOutput) == expected);
+
+        std::filesystem::remove(inputFile);
+        std::cout << "✓ Memory-mapped input test passed\n";
+    }
+
+    void testAsyncInput()
+    {
+        std::cout << "\n=== Testing Asynchronous Input ===\n";
+
+        // Lines straddle the small read buffers, one of them longer than a buffer
+        std::ostringstream content;
+        content << "Timestamp, Price, Size, Exchange, Type\n";
+        for (int i = 0; i < 3000; ++i)
+        {
+            content << "2021-03-05 11:00:" << std::setw(2) << std::setfill('0') << i / 1000 << "."
+                    << std::setw(3) << i % 1000 << ", " << 10 + i % 7 << ".25, " << i << ", "
+                    << (i == 1500 ? std::string(10000, 'X') : std::string("NYSE")) << ", TRADE\n";
+        }
+        const std::string inputFile = std::filesystem::path("test_data").append("IBM.txt").generic_string();
+        createTestFile(inputFile, content.str());
+
+        std::vector<std::string> inputFiles = {
+            inputFile,
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string()};
+        const std::string streamOutput = std::filesystem::path("test_data").append("stream_output.txt").generic_string();
+        const std::string asyncOutput = std::filesystem::path("test_data").append("async_output.txt").generic_string();
+        FileMerger::mergeFiles(inputFiles, streamOutput, 1);
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+
+        ThreadPoolEngine pool(2);
+        std::vector<IoEngine *> engines = {&pool};
+        if (IoUringEngine::available())
+        {
+            engines.push_back(&IoEngine::forThisThread());
+        }
+        for (IoEngine *engine : engines)
+        {
+            for (size_t inFlight : {1, 2, 4})
+            {
+                AsyncSource source(inputFile, *engine, 4096, inFlight);
+                std::string bytes;
+                do
+                {
+                    std::string_view view = source.view();
+                    bytes.append(view.data(), view.size());
+                    source.consume(view.size() / 2); // Leave a tail to carry over
+                    bytes.resize(bytes.size() - (view.size() - view.size() / 2));
+                } while (source.fill());
+                bytes.append(source.view().data(), source.view().size());
+                assert(bytes == content.str());
+            }
+            std::cout << "  " << engine->name() << " reads match\n";
+        }
+
+        // A submitted io_uring read is under way before anyone waits for it
+        if (IoUringEngine::available())
+        {
+            IoUringEngine engine(8);
+            const int fd = ::open(inputFile.c_str(), O_RDONLY);
+            assert(fd >= 0);
+            std::vector<char> buffer(4096);
+            ReadRequest request;
+            request.fd = fd;
+            request.buffer = buffer.data();
+            request.length = buffer.size();
+            engine.submit(request);
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (!request.done.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                engine.poll();
+            }
+            assert(request.done.load(std::memory_order_acquire));
+            assert(request.result == static_cast<int64_t>(std::min<size_t>(buffer.size(), content.str().size())));
+            assert(std::string(buffer.data(), static_cast<size_t>(request.result)) == content.str().substr(0, buffer.size()));
+            ::close(fd);
+        }
+
+        for (auto kind : {IoEngine::Kind::ThreadPool, IoEngine::Kind::Auto})
+        {
+            IoEngine::setPreferred(kind);
+            FileMerger::MergeOptions options;
+            options.batchSize = 1;
+            options.inputMode = InputMode::Async;
+            FileMerger::mergeFiles(inputFiles, asyncOutput, options);
+            assert(slurp(asyncOutput) == slurp(streamOutput));
+        }
+        IoEngine::setPreferred(IoEngine::Kind::Auto);
+
+        std::filesystem::remove(inputFile);
+        std::cout << "✓ Asynchronous input test passed\n";
+    }
+
+    void testOutputWriter()
+    {
+        std::cout << "\n=== Testing Output Writer ===\n";
+        const std::string outputFile = std::filesystem::path("test_data").append("writer_output.txt").generic_string();
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+
+        // Tiny buffers force many swaps; direct mode also exercises the unaligned tail
+        for (bool direct : {false, true})
+        {
+            std::string expected;
+            {
+                OutputWriter writer(outputFile, direct, 100, 2);
+                for (int i = 0; i < 20000; ++i)
+                {
+                    std::string row = "row " + std::to_string(i) + "\n";
+                    expected += row;
+                    writer.buffer() += row;
+                    writer.commit();
+                }
+                writer.close();
+                std::cout << "  " << (writer.direct() ? "O_DIRECT" : "buffered") << " writes\n";
+            }
+            assert(slurp(outputFile) == expected);
+        }
+
+        // Merges produce identical output either way
+        std::vector<std::string> inputFiles = {
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
+        const std::string directOutput = std::filesystem::path("test_data").append("direct_output.txt").generic_string();
+        FileMerger::mergeFiles(inputFiles, outputFile, 1);
+        FileMerger::MergeOptions options;
+        options.directOutput = true;
+        FileMerger::mergeFiles(inputFiles, directOutput, options);
+        assert(slurp(directOutput) == slurp(outputFile));
+
+        std::cout << "✓ Output writer test passed\n";
+    }
+
+    void testColumnarOutput()
+    {
+        std::cout << "\n=== Testing Columnar Output ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("columnar").generic_string();
+        const std::string textOutput = std::filesystem::path("test_data").append("columnar_output.txt").generic_string();
+        const std::string columnarOutput = std::filesystem::path("test_data").append("columnar_output.bin").generic_string();
+        std::filesystem::create_directory(directory);
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+
+        TickGeneratorOptions generator;
+        generator.files = 5;
+        generator.rows = 10000;
+        generator.seed = 11;
+        GeneratedData data = TickGenerator::generate(directory, generator);
+
+        FileMerger::MergeOptions options;
+        options.batchSize = 2;
+        FileMerger::mergeFiles(data.files, textOutput, options);
+
+        // A small block size gives the index many blocks and a partial last one
+        {
+            ColumnarSink sink(columnarOutput, false, 300);
+            FileMerger::mergeFiles(data.files, sink, options);
+        }
+        ColumnarReader reader(columnarOutput);
+        assert(reader.rows() == generator.rows);
+        assert(reader.blockCount() == (generator.rows + 299) / 300);
+        assert(reader.block(reader.blockCount() - 1).rows == generator.rows % 300);
+
+        // Rows decode back to the text output
+        SymbolTable symbols(reader.symbols());
+        std::string decoded = "Symbol,Timestamp,Price,Size,Exchange,Type\n";
+        std::vector<int64_t> timestamps;
+        for (uint64_t row = 0; row < reader.rows(); ++row)
+        {
+            MarketDataEntry entry = reader.entry(row);
+            TextFormat::appendEntry(decoded, entry, symbols);
+            timestamps.push_back(entry.timestamp);
+        }
+        assert(decoded == slurp(textOutput));
+        for (size_t i = 0; i < reader.exchanges().size(); ++i)
+        {
+            assert(reader.exchanges()[i] == ExchangeTable::name(static_cast<uint8_t>(i)));
+        }
+
+        // Index lookups agree with a linear scan, including between and past rows
+        for (size_t i = 0; i < timestamps.size(); i += 97)
+        {
+            for (int64_t probe : {timestamps[i], timestamps[i] + 1})
+            {
+                uint64_t expected = std::lower_bound(timestamps.begin(), timestamps.end(), probe) - timestamps.begin();
+                assert(reader.lowerBound(probe) == expected);
+            }
+        }
+        assert(reader.lowerBound(timestamps.front() - 1) == 0);
+        assert(reader.lowerBound(timestamps.back() + 1) == reader.rows());
+        assert(reader.findBlock(timestamps.back() + 1) == reader.blockCount());
+
+        // The format option picks the sink
+        options.outputFormat = OutputFormat::Columnar;
+        FileMerger::mergeFiles(data.files, columnarOutput, options);
+        ColumnarReader defaults(columnarOutput);
+        assert(defaults.rows() == generator.rows && defaults.blockCount() == 3);
+
+        bool threw = false;
+        try
+        {
+            ColumnarReader notColumnar(textOutput);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+
+        std::filesystem::remove_all(directory);
+        std::cout << "✓ Columnar output test passed\n";
+    }
+
+    void testTimeRangeFilter()
+    {
+        std::cout << "\n=== Testing Time Range and Symbol Filters ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("ranged").generic_string();
+        const std::string fullOutput = std::filesystem::path("test_data").append("full_output.txt").generic_string();
+        const std::string rangeOutput = std::filesystem::path("test_data").append("range_output.txt").generic_string();
+        std::filesystem::create_directory(directory);
+
+        auto readLines = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(in, line))
+            {
+                lines.push_back(line);
+            }
+            return lines;
+        };
+        auto timestampOf = [](const std::string &line)
+        {
+            std::string_view fields[6];
+            LineParser::splitFields(line.data(), line.data() + line.size(), fields, 6);
+            int64_t nanos = 0;
+            assert(LineParser::parseTimestamp(fields[1], nanos));
+            return nanos;
+        };
+
+        TickGeneratorOptions generator;
+        generator.files = 6;
+        generator.rows = 30000;
+        generator.seed = 5;
+        GeneratedData data = TickGenerator::generate(directory, generator);
+        FileMerger::mergeFiles(data.files, fullOutput, 2);
+        std::vector<std::string> full = readLines(fullOutput);
+
+        // Window starts on an existing row so that equal timestamps straddle a sample
+        FileMerger::MergeOptions options;
+        options.batchSize = 2;
+        options.range.from = timestampOf(full[full.size() / 3]);
+        options.range.to = timestampOf(full[full.size() / 2]);
+        options.symbols = {"S00000", "S00002", "S00005", "NOPE"};
+        options.indexStride = 64;
+
+        std::vector<std::string> expected = {full[0]};
+        for (size_t i = 1; i < full.size(); ++i)
+        {
+            int64_t nanos = timestampOf(full[i]);
+            std::string symbol = full[i].substr(0, full[i].find(','));
+            if (nanos >= options.range.from && nanos < options.range.to &&
+                (symbol == "S00000" || symbol == "S00002" || symbol == "S00005"))
+            {
+                expected.push_back(full[i]);
+            }
+        }
+        assert(expected.size() > 1000);
+
+        // First run builds the sidecars, later ones load them; every input mode seeks
+        for (InputMode mode : {InputMode::Stream, InputMode::Mmap, InputMode::Async})
+        {
+            options.inputMode = mode;
+            FileMerger::mergeFiles(data.files, rangeOutput, options);
+            assert(readLines(rangeOutput) == expected);
+        }
+        assert(std::filesystem::exists(TimeIndex::sidecarPath(data.files[0])));
+        assert(!std::filesystem::exists(TimeIndex::sidecarPath(data.files[1])));
+        assert(FileMerger::listFiles(directory).size() == generator.files);
+
+        // Without indexes the readers still filter
+        options.inputMode = InputMode::Stream;
+        options.indexStride = 0;
+        FileMerger::mergeFiles(data.files, rangeOutput, options);
+        assert(readLines(rangeOutput) == expected);
+
+        // Index contents: samples every stride rows, and seeks land on line starts
+        TimeIndex index = TimeIndex::forFile(data.files[0], 64);
+        TimeIndex rebuilt = TimeIndex::build(data.files[0], 64);
+        assert(index.usable() && index.rows() == rebuilt.rows() && index.samples().size() == rebuilt.samples().size());
+        assert(index.samples().size() == (index.rows() + 63) / 64);
+        assert(index.seek(index.first()) == 0);
+        assert(!index.overlaps({index.last() + 1, std::numeric_limits<int64_t>::max()}));
+        {
+            std::ifstream in(data.files[0], std::ios::binary);
+            in.seekg(static_cast<std::streamoff>(index.samples()[3].offset));
+            std::string line;
+            std::getline(in, line);
+            int64_t nanos = 0;
+            assert(LineParser::parseTimestamp(line.substr(0, line.find(',')), nanos));
+            assert(nanos == index.samples()[3].timestamp);
+        }
+
+        // A changed file invalidates its sidecar
+        {
+            std::ofstream append(data.files[0], std::ios::app);
+            append << "2030-01-01 00:00:00.000,1,1,NYSE,TRADE\n";
+        }
+        assert(TimeIndex::forFile(data.files[0], 64).rows() == index.rows() + 1);
+
+        // Out-of-order input is never skipped or sought into
+        createTestFile(std::filesystem::path(directory).append("UNSORTED.txt").generic_string(),
+                       "Timestamp, Price, Size, Exchange, Type\n"
+                       "2021-03-05 10:00:00.200, 1, 1, NYSE, Ask\n"
+                       "2021-03-05 10:00:00.100, 1, 1, NYSE, Ask\n");
+        TimeIndex unsorted = TimeIndex::build(std::filesystem::path(directory).append("UNSORTED.txt").generic_string(), 1);
+        assert(!unsorted.usable() && unsorted.overlaps({0, 1}) && unsorted.seek(INT64_MAX) == 0);
+
+        // A window after all the data leaves only the header
+        options.symbols.clear();
+        options.indexStride = 64;
+        options.range = {INT64_MAX - 1, INT64_MAX};
+        FileMerger::mergeFiles(data.files, rangeOutput, options);
+        assert(readLines(rangeOutput).size() == 1);
+
+        bool threw = false;
+        try
+        {
+            options.symbols = {"NOPE"};
+            FileMerger::mergeFiles(data.files, rangeOutput, options);
+        }
+        catch (const std::runtime_error &)
+        {
+            threw = true;
+        }
+        assert(threw);
+
+        std::filesystem::remove_all(directory);
+        std::cout << "✓ Time range and symbol filter test passed\n";
+    }
+
+    void testCompressedIO()
+    {
+        std::cout << "\n=== Testing Compressed Input and Output ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("compressed").generic_string();
+        const std::string plainOutput = std::filesystem::path("test_data").append("plain_output.txt").generic_string();
+        const std::string output = std::filesystem::path("test_data").append("compressed_output.txt").generic_string();
+        std::filesystem::create_directory(directory);
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+        // Decoded contents through the same path the readers use
+        auto decode = [](const std::string &path)
+        {
+            std::unique_ptr<InputSource> source = InputSource::open(path, InputMode::Stream);
+            std::string text;
+            do
+            {
+                std::string_view bytes = source->view();
+                text.append(bytes.data(), bytes.size());
+                source->consume(bytes.size());
+            } while (source->fill());
+            return text;
+        };
+
+        assert(SymbolTable::symbolOf("archive/CSCO.txt.zst") == "CSCO");
+        assert(SymbolTable::symbolOf("archive/CSCO.txt.gz") == "CSCO");
+
+        TickGeneratorOptions generator;
+        generator.files = 4;
+        generator.rows = 40000;
+        generator.seed = 9;
+        GeneratedData data = TickGenerator::generate(directory, generator);
+        FileMerger::mergeFiles(data.files, plainOutput, 2);
+        const std::string expected = slurp(plainOutput);
+
+        for (Compression compression : {Compression::Gzip, Compression::Zstd})
+        {
+            if (!Codec::available(compression))
+            {
+                std::cout << "  " << Codec::name(compression) << " not compiled in, skipped\n";
+                continue;
+            }
+            const std::string extension = compression == Compression::Gzip ? ".gz" : ".zst";
+
+            // Inputs made of several independent members/frames, split mid-line
+            std::vector<std::string> compressed;
+            for (const auto &file : data.files)
+            {
+                const std::string text = slurp(file);
+                std::string packed;
+                const size_t third = text.size() / 3;
+                Codec::compress(compression, std::string_view(text).substr(0, third), packed);
+                Codec::compress(compression, std::string_view(text).substr(third, third), packed);
+                Codec::compress(compression, std::string_view(text).substr(2 * third), packed);
+                compressed.push_back(file + extension);
+                std::ofstream(compressed.back(), std::ios::binary) << packed;
+                assert(decode(compressed.back()) == text);
+            }
+            for (InputMode mode : {InputMode::Stream, InputMode::Mmap, InputMode::Async})
+            {
+                FileMerger::MergeOptions options;
+                options.batchSize = 2;
+                options.inputMode = mode;
+                FileMerger::mergeFiles(compressed, output, options);
+                assert(slurp(output) == expected);
+            }
+
+            // Compressed output spans several blocks and decodes to the plain output
+            const std::string packedOutput = output + extension;
+            FileMerger::mergeFiles(compressed, packedOutput, 2);
+            assert(expected.size() > 2 * BlockCompressor::kBlockBytes);
+            assert(std::filesystem::file_size(packedOutput) < expected.size() / 2);
+            assert(decode(packedOutput) == expected);
+
+            // A truncated file is an error, not a short merge
+            std::string truncated = slurp(compressed[0]);
+            std::ofstream(compressed[0], std::ios::binary) << truncated.substr(0, truncated.size() - 10);
+            bool threw = false;
+            try
+            {
+                FileMerger::mergeFiles(compressed, output, 2);
+            }
+            catch (const std::runtime_error &)
+            {
+                threw = true;
+            }
+            assert(threw);
+
+            for (const auto &file : compressed)
+            {
+                std::filesystem::remove(file);
+            }
+            std::cout << "  " << Codec::name(compression) << " round trip ok\n";
+        }
+
+        std::filesystem::remove_all(directory);
+        std::cout << "✓ Compressed input and output test passed\n";
+    }
+
+    void testTickGenerator()
+    {
+        std::cout << "\n=== Testing Tick Generator ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("generated").generic_string();
+        std::filesystem::create_directory(directory);
+
+        TickGeneratorOptions options;
+        options.files = 8;
+        options.rows = 20000;
+        options.zipf = 1.5;
+        options.seed = 7;
+
+        // Zipf split covers every row and is skewed toward a few symbols
+        std::vector<uint64_t> rows = TickGenerator::rowsPerFile(options);
+        assert(std::accumulate(rows.begin(), rows.end(), uint64_t(0)) == options.rows);
+        assert(*std::max_element(rows.begin(), rows.end()) > 10 * *std::min_element(rows.begin(), rows.end()));
+
+        auto slurp = [](const std::string &path)
+        {
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            return buffer.str();
+        };
+
+        // Same seed, same bytes, whatever the thread count
+        options.threads = 1;
+        GeneratedData first = TickGenerator::generate(directory, options);
+        std::vector<std::string> contents;
+        for (const auto &file : first.files)
+        {
+            contents.push_back(slurp(file));
+        }
+        options.threads = 4;
+        GeneratedData second = TickGenerator::generate(directory, options);
+        assert(second.files == first.files && second.bytes == first.bytes && second.rows == options.rows);
+        for (size_t i = 0; i < second.files.size(); ++i)
+        {
+            assert(slurp(second.files[i]) == contents[i]);
+        }
+
+        // Generated files are valid merge input
+        const std::string outputFile = std::filesystem::path("test_data").append("generated_output.txt").generic_string();
+        FileMerger::mergeFiles(first.files, outputFile, 3);
+        std::string output = slurp(outputFile);
+        assert(static_cast<uint64_t>(std::count(output.begin(), output.end(), '\n')) == options.rows + 1);
+
+        std::filesystem::remove_all(directory);
+        std::cout << "✓ Tick generator test passed\n";
+    }
+
+    void testLiveMerge()
+    {
+        std::cout << "\n=== Testing Live Merge ===\n";
+        const std::string directory = std::filesystem::path("test_data").append("live").generic_string();
+        const std::string outputFile = std::filesystem::path("test_data").append("live_output.txt").generic_string();
+        std::filesystem::create_directory(directory);
+        auto path = [&](const std::string &name)
+        { return std::filesystem::path(directory).append(name).generic_string(); };
+        auto append = [](const std::string &file, const std::string &text)
+        {
+            std::ofstream out(file, std::ios::app);
+            out << text;
+        };
+        auto row = [](const std::string &time)
+        { return "2021-03-05 10:00:" + time + ", 1.5, 100, NYSE, Bid\n"; };
+        const std::string header = "Timestamp, Price, Size, Exchange, Type\n";
+
+        LiveMerger::Options options;
+        options.latenessNanos = 60000000000; // Only the watermark releases rows here
+        options.idleTimeout = std::chrono::milliseconds(60000);
+        {
+            LiveMerger merger(directory, outputFile, options);
+            append(path("AAA.txt"), header + row("00.100") + row("00.300"));
+            append(path("BBB.txt"), header + row("00.200"));
+            assert(merger.poll() == 2); // AAA 00.300 waits until BBB passes it
+
+            append(path("BBB.txt"), row("00.400") + "2021-03-05 10:00:00.5");
+            assert(merger.poll() == 1);
+
+            // A symbol appearing behind the released rows is dropped as late
+            append(path("CCC.txt"), header + row("00.050"));
+            assert(merger.poll() == 0 && merger.lateRows() == 1);
+
+            // CCC now holds the watermark at 00.050; flushing releases the rest
+            append(path("BBB.txt"), "00, 1.5, 100, NYSE, Bid\n");
+            assert(merger.poll() == 0);
+            assert(merger.flush() == 2 && merger.emittedRows() == 5);
+        }
+        std::ifstream output(outputFile);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(output, line);)
+        {
+            lines.push_back(line);
+        }
+        std::vector<std::string> expected = {
+            "Symbol,Timestamp,Price,Size,Exchange,Type",
+            "AAA,2021-03-05 10:00:00.100,1.5,100,NYSE,Bid",
+            "BBB,2021-03-05 10:00:00.200,1.5,100,NYSE,Bid",
+            "AAA,2021-03-05 10:00:00.300,1.5,100,NYSE,Bid",
+            "BBB,2021-03-05 10:00:00.400,1.5,100,NYSE,Bid",
+            "BBB,2021-03-05 10:00:00.500,1.5,100,NYSE,Bid"};
+        assert(lines == expected);
+        std::filesystem::remove_all(directory);
+
+        // The lateness bound releases rows a silent symbol would otherwise hold back
+        std::filesystem::create_directory(directory);
+        options.latenessNanos = 100000000;
+        {
+            LiveMerger merger(directory, outputFile, options);
+            append(path("AAA.txt"), header + row("00.100") + row("01.000"));
+            append(path("BBB.txt"), header);
+            assert(merger.poll() == 1);
+            assert(merger.flush() == 1);
+        }
+        std::filesystem::remove_all(directory);
+
+        // Followed through inotify until stopped
+        std::filesystem::create_directory(directory);
+        options.idleTimeout = std::chrono::milliseconds(0);
+        {
+            LiveMerger merger(directory, outputFile, options);
+            std::atomic<bool> stop{false};
+            std::thread follower([&]()
+                                 { merger.run(stop); });
+            append(path("AAA.txt"), header + row("00.100"));
+            for (int i = 0; i < 500 && merger.emittedRows() == 0; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            assert(merger.emittedRows() == 1);
+            stop = true;
+            follower.join();
+        }
+        std::filesystem::remove_all(directory);
+        std::cout << "✓ Live merge test passed\n";
+    }
+
+    void testCompactEntry()
+    {
+        std::cout << "\n=== Testing Compact Entry ===\n";
+        char text[TextFormat::kMaxFieldLength];
+
+        // Timestamps round-trip at millisecond, microsecond and nanosecond precision
+        for (std::string timestamp : {"2021-03-05 10:00:00.123", "1969-12-31 23:59:59.999999", "2096-02-29 00:00:00.000000001"})
+        {
+            int64_t nanos = 0;
+            assert(LineParser::parseTimestamp(timestamp, nanos));
+            assert(std::string(text, TextFormat::formatTimestamp(nanos, text)) == timestamp);
+        }
+        int64_t nanos = 0;
+        assert(LineParser::parseTimestamp("1970-01-01 00:00:01.5", nanos) && nanos == 1500000000);
+        assert(!LineParser::parseTimestamp("2021-13-05 10:00:00.123", nanos));
+        assert(!LineParser::parseTimestamp("2400-01-01 00:00:00", nanos));
+
+        int64_t price = 0;
+        assert(LineParser::parseFixed("228.5", MarketDataEntry::kPriceDigits, price) && price == 22850000000);
+        assert(std::string(text, TextFormat::formatFixed(price, MarketDataEntry::kPriceDigits, text)) == "228.5");
+        assert(LineParser::parseFixed("-0.00000001", MarketDataEntry::kPriceDigits, price));
+        assert(std::string(text, TextFormat::formatFixed(price, MarketDataEntry::kPriceDigits, text)) == "-0.00000001");
+        assert(!LineParser::parseFixed("0.000000001", MarketDataEntry::kPriceDigits, price));
+
+        // Symbol ids order like names, so the packed key orders like (timestamp, symbol)
+        SymbolTable symbols({"MSFT", "AAPL", "CSCO", "AAPL"});
+        assert(symbols.size() == 3 && symbols.id("AAPL") < symbols.id("CSCO") && symbols.id("CSCO") < symbols.id("MSFT"));
+        MarketDataEntry a{}, b{};
+        a.timestamp = b.timestamp = 1000;
+        a.symbolId = symbols.id("AAPL");
+        b.symbolId = symbols.id("MSFT");
+        assert(a < b && b > a);
+        a.timestamp = -5;
+        b.timestamp = 5;
+        a.symbolId = symbols.id("MSFT");
+        assert(a < b);
+
+        assert(ExchangeTable::intern("NYSE") == ExchangeTable::intern("NYSE"));
+        assert(ExchangeTable::name(ExchangeTable::intern("BATS")) == "BATS");
+        std::cout << "✓ Compact entry test passed\n";
+    }
+
+    void testLoserTree()
+    {
+        std::cout << "\n=== Testing Loser Tree ===\n";
+        for (size_t k : {1, 2, 3, 7, 64, 100})
+        {
+            // Sources with duplicate keys, some empty
+            std::vector<std::vector<int>> sources(k);
+            std::vector<std::pair<int, size_t>> expected;
+            for (size_t i = 0; i < k; ++i)
+            {
+                size_t count = (i * 7) % 5 == 0 ? 0 : (i * 13) % 50 + 1;
+                int key = static_cast<int>(i % 3);
+                for (size_t j = 0; j < count; ++j)
+                {
+                    key += static_cast<int>((i + j) % 4);
+                    sources[i].push_back(key);
+                    expected.push_back({key, i});
+                }
+            }
+            std::sort(expected.begin(), expected.end());
+
+            LoserTree<int> tree(k);
+            std::vector<size_t> positions(k, 0);
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (!sources[i].empty())
+                {
+                    tree.set(i, sources[i][0]);
+                }
+            }
+            tree.build();
+
+            std::vector<std::pair<int, size_t>> merged;
+            while (!tree.empty())
+            {
+                size_t winner = tree.winner();
+                merged.push_back({tree.winnerKey(), winner});
+                if (++positions[winner] < sources[winner].size())
+                {
+                    tree.replaceWinner(sources[winner][positions[winner]]);
+                }
+                else
+                {
+                    tree.removeWinner();
+                }
+            }
+            // Equal keys come out in source order
+            assert(merged == expected);
+        }
+        std::cout << "✓ Loser tree test passed\n";
+    }
+
+    void testArena()
+    {
+        std::cout << "\n=== Testing Arena ===\n";
+        Arena arena(4096);
+
+        // Alignment, rewinding and reuse of the same memory
+        Arena::Mark start = arena.mark();
+        char *first = static_cast<char *>(arena.allocate(3, 1));
+        void *aligned = arena.allocate(64, 64);
+        assert(reinterpret_cast<uintptr_t>(aligned) % 64 == 0);
+        {
+            Arena::Scope scope(arena);
+            arena.allocate(10000); // Larger than a chunk
+            assert(arena.reserved() > 10000);
+        }
+        const size_t reserved = arena.reserved();
+        arena.rewind(start);
+        assert(static_cast<char *>(arena.allocate(3, 1)) == first && arena.reserved() == reserved);
+
+        ArenaVector<int> numbers{ArenaAllocator<int>(&arena)};
+        for (int i = 0; i < 1000; ++i)
+        {
+            numbers.push_back(i);
+        }
+        assert(numbers[999] == 999 && arena.reserved() >= arena.used());
+
+        // Once the arena is warm, reading a file costs the same few global allocations
+        // (opening it) however many rows and blocks it has
+        auto writeRows = [this](const std::string &path, size_t rows)
+        {
+            std::string content = "Timestamp,Price,Size,Exchange,Type\n";
+            for (size_t i = 0; i < rows; ++i)
+            {
+                content += "2021-03-05 10:00:00." + std::to_string(100000 + i) + ",46.14,120,NYSE,Ask\n";
+            }
+            createTestFile(path, content);
+        };
+        const std::string small = std::filesystem::path("test_data").append("ARENA_SMALL.txt").generic_string();
+        const std::string large = std::filesystem::path("test_data").append("ARENA_LARGE.txt").generic_string();
+        writeRows(small, 100);
+        writeRows(large, 20000);
+
+        Arena &batchArena = Arena::forThisThread();
+        auto countAllocations = [&batchArena](const std::string &path)
+        {
+            Arena::Scope scope(batchArena);
+            const size_t before = g_allocations.load();
+            size_t rows = 0;
+            {
+                ArenaPtr<FileMerger::FileReader> reader = makeInArena<FileMerger::FileReader>(
+                    batchArena, 0, path, InputMode::Stream, FileMerger::kDefaultMapBudget, 256, TimeRange(), 0,
+                    &batchArena);
+                while (reader->hasMoreData)
+                {
+                    ++rows;
+                    reader->readNextEntry();
+                }
+            }
+            assert(rows > 0);
+            return g_allocations.load() - before;
+        };
+        countAllocations(large); // Warm up
+        const size_t smallCount = countAllocations(small);
+        const size_t largeCount = countAllocations(large);
+        std::cout << "  global allocations per file read: " << smallCount << " (100 rows), " << largeCount
+                  << " (20000 rows)\n";
+        assert(largeCount == smallCount);
+
+        std::filesystem::remove(small);
+        std::filesystem::remove(large);
+        std::cout << "✓ Arena test passed\n";
+    }
+
+    void testBlockReader()
+    {
+        std::cout << "\n=== Testing Block Reader ===\n";
+        const std::string inputFile = std::filesystem::path("test_data").append("AAPL.txt").generic_string();
+
+        // Blocks of every size yield the same rows
+        for (size_t blockRows : {1, 2, 3, 1024})
+        {
+            FileMerger::FileReader reader(0, inputFile, InputMode::Stream, FileMerger::kDefaultMapBudget, blockRows);
+            std::vector<int64_t> prices;
+            while (reader.hasMoreData)
+            {
+                prices.push_back(reader.currentEntry.price);
+                reader.readNextEntry();
+            }
+            assert((prices == std::vector<int64_t>{15025000000, 15026000000, 15027000000}));
+        }
+
+        // Column access straight from readBlock()
+        FileMerger::FileReader reader(0, inputFile, InputMode::Mmap, FileMerger::kDefaultMapBudget, 2);
+        assert(reader.block.count == 2 && reader.block.sizes[0] == 100 && reader.block.sides[1] == Side::Ask);
+        assert(reader.readBlock() && reader.block.count == 1 && reader.block.sides[0] == Side::Trade);
+        assert(!reader.readBlock());
+        std::cout << "✓ Block reader test passed\n";
+    }
+
+    void testMetrics()
+    {
+        std::cout << "\n=== Testing Metrics ===\n";
+
+        // Every value lands in a bucket whose floor is within 1/16 below it
+        for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull})
+        {
+            const size_t bucket = Metrics::bucketOf(value);
+            assert(bucket < Metrics::kBuckets);
+            assert(Metrics::bucketFloor(bucket) <= value);
+            assert(value - Metrics::bucketFloor(bucket) <= value / Metrics::kSubBuckets);
+            assert(bucket + 1 == Metrics::kBuckets || Metrics::bucketFloor(bucket + 1) > value);
+        }
+
+        // Nothing is recorded while metrics are off
+        Metrics::reset();
+        Metrics::add(Metrics::Counter::RowsParsed, 5);
+        assert(Metrics::total(Metrics::Counter::RowsParsed) == 0);
+
+        Metrics::enable(true);
+        const std::string outputFile = std::filesystem::path("test_data").append("metrics_output.txt").generic_string();
+        std::vector<std::string> inputFiles = {
+            std::filesystem::path("test_data").append("AAPL.txt").generic_string(),
+            std::filesystem::path("test_data").append("CSCO.txt").generic_string(),
+            std::filesystem::path("test_data").append("MSFT.txt").generic_string()};
+        FileMerger::MergeOptions options;
+        options.batchSize = 1;
+        FileMerger::mergeFiles(inputFiles, outputFile, options);
+        assert(Metrics::total(Metrics::Counter::RowsParsed) == 7);
+        assert(Metrics::total(Metrics::Counter::BytesRead) > 0);
+        assert(Metrics::total(Metrics::Counter::RowsMerged) >= 7);
+        assert(Metrics::total(Metrics::Counter::BatchesMerged) == 3);
+        assert(Metrics::count(Metrics::Histogram::BatchTime) == 3);
+        assert(Metrics::count(Metrics::Histogram::FinalMergeTime) == 1);
+
+        Metrics::record(Metrics::Histogram::BlockRows, 1000);
+        assert(Metrics::quantile(Metrics::Histogram::BlockRows, 1.0) >= 960);
+
+        const std::string json = Metrics::render(MetricsFormat::Json);
+        assert(json.find("\"rows_parsed\": 7") != std::string::npos);
+        assert(json.find("\"batch_seconds\"") != std::string::npos);
+        const std::string prometheus = Metrics::render(MetricsFormat::Prometheus);
+        assert(prometheus.find("mdf_rows_parsed_total 7\n") != std::string::npos);
+        assert(prometheus.find("mdf_batch_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+
+        // A file target holds the last snapshot after stop()
+        const std::string metricsFile = std::filesystem::path("test_data").append("metrics.json").generic_string();
+        {
+            MetricsReporter reporter(metricsFile, MetricsFormat::Json, std::chrono::milliseconds(10));
+            assert(!reporter.socket());
+            reporter.stop();
+        }
+        std::ifstream in(metricsFile);
+        std::stringstream content;
+        content << in.rdbuf();
+        assert(content.str().find("\"rows_parsed\": 7") != std::string::npos);
+
+        // A socket target serves a snapshot to each client
+        const std::string socketPath = (std::filesystem::temp_directory_path() /
+                                        ("mdf_metrics_" + std::to_string(::getpid()) + ".sock")).string();
+        {
+            MetricsReporter reporter("unix:" + socketPath, MetricsFormat::Prometheus, std::chrono::milliseconds(1000));
+            assert(reporter.socket());
+            int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath.c_str());
+            assert(::connect(client, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+            std::string received;
+            char buffer[4096];
+            ssize_t count;
+            while ((count = ::read(client, buffer, sizeof(buffer))) > 0)
+            {
+                received.append(buffer, static_cast<size_t>(count));
+            }
+            ::close(client);
+            assert(received.find("mdf_rows_parsed_total 7\n") != std::string::npos);
+        }
+        assert(!std::filesystem::exists(socketPath));
+
+        Metrics::enable(false);
+        Metrics::reset();
+        std::filesystem::remove(outputFile);
+        std::filesystem::remove(metricsFile);
+        std::cout << "✓ Metrics test passed\n";
+    }
+
 public:
     void runTests()
     {
@@ -438,6 +2579,31 @@ public:
             testDifferentTimestamps();
             testLargeBatchSize();
             testErrorHandling();
+            testMergeTree();
+            testBatchScheduling();
+            testExternalMerge();
+            testIncrementalMerge();
+            testAggregations();
+            testShardedMerge();
+            testReplay();
+            testFileDiscovery();
+            testFeedSchemas();
+            testThreadPool();
+            testNumaPlacement();
+            testLineParser();
+            testMappedInput();
+            testAsyncInput();
+            testOutputWriter();
+            testColumnarOutput();
+            testTimeRangeFilter();
+            testCompressedIO();
+            testLiveMerge();
+            testCompactEntry();
+            testLoserTree();
+            testBlockReader();
+            testArena();
+            testMetrics();
+            testTickGenerator();
             testLargeDataset();
             cleanup();
             std::cout << "\n=== All tests passed successfully! ===\n";